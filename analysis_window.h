@@ -0,0 +1,116 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+#ifndef ANALYSIS_WINDOW_H
+#define ANALYSIS_WINDOW_H
+
+#include <stdint.h>
+
+// Analysis windows in q1.15, generated at compile time for any FFT size: a constexpr AnalysisWindowQ15<N, W> is a
+// table in flash with no start-up cost. All are symmetric cosine sums, w(n) = sum (-1)^k a_k cos(2 pi k n / (N - 1)),
+// normalised to a peak of 1. The Hamming one matches AudioWindowHamming1024 of the Teensy audio library.
+
+typedef enum
+{
+    ANALYSIS_WINDOW_HANN,
+    ANALYSIS_WINDOW_HAMMING,
+    ANALYSIS_WINDOW_BLACKMAN_HARRIS, //4 terms, -92 dB side lobes
+    ANALYSIS_WINDOW_FLAT_TOP,        //amplitude accurate to 0.01 dB between bins, dips slightly below 0 at the edges
+    ANALYSIS_WINDOW_RECTANGULAR,     //no leakage only for frames holding whole periods of a periodic excitation
+} analysis_window_t;
+
+namespace analysis_window_detail
+{
+constexpr double PI = 3.14159265358979323846;
+
+// Taylor series after reduction to [-pi, pi], well below q1.15 resolution. std::cos is not constexpr.
+constexpr double cos_constexpr(double x)
+{
+    while(x > PI)
+    {
+        x -= 2.0 * PI;
+    }
+    while(x < -PI)
+    {
+        x += 2.0 * PI;
+    }
+
+    double term = 1.0;
+    double sum = 1.0;
+    for(int k = 1; k < 20; k++)
+    {
+        term *= -(x * x) / ((2.0 * k - 1.0) * (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double coefficient(analysis_window_t window, int k)
+{
+    // a0 to a4
+    return (window == ANALYSIS_WINDOW_HANN)              ? ((k == 0) ? 0.5 : (k == 1) ? 0.5 : 0.0)
+           : (window == ANALYSIS_WINDOW_HAMMING)         ? ((k == 0) ? 0.54 : (k == 1) ? 0.46 : 0.0)
+           : (window == ANALYSIS_WINDOW_RECTANGULAR)     ? ((k == 0) ? 1.0 : 0.0)
+           : (window == ANALYSIS_WINDOW_BLACKMAN_HARRIS) ? ((k == 0)   ? 0.35875
+                                                            : (k == 1) ? 0.48829
+                                                            : (k == 2) ? 0.14128
+                                                            : (k == 3) ? 0.01168
+                                                                       : 0.0)
+                                                         : ((k == 0)   ? 0.21557895
+                                                            : (k == 1) ? 0.41663158
+                                                            : (k == 2) ? 0.277263158
+                                                            : (k == 3) ? 0.083578947
+                                                                       : 0.006947368);
+}
+
+constexpr double value(analysis_window_t window, int n, int size)
+{
+    double sum = 0.0;
+    for(int k = 0; k < 5; k++)
+    {
+        const double a = coefficient(window, k);
+        sum += ((k % 2) ? -a : a) * cos_constexpr((2.0 * PI * k * n) / (size - 1));
+    }
+    return sum;
+}
+
+constexpr int16_t to_q15(double v)
+{
+    const double scaled = v * 32767.0;
+    const double rounded = (scaled >= 0.0) ? (scaled + 0.5) : (scaled - 0.5);
+    return (rounded >= 32767.0) ? 32767 : (rounded <= -32768.0) ? -32768 : (int16_t)rounded;
+}
+} // namespace analysis_window_detail
+
+template <int N, analysis_window_t W> struct AnalysisWindowQ15
+{
+    static_assert(N > 1, "window too short");
+
+    int16_t values[N];
+
+    constexpr AnalysisWindowQ15() : values()
+    {
+        for(int n = 0; n < N; n++)
+        {
+            values[n] = analysis_window_detail::to_q15(analysis_window_detail::value(W, n, N));
+        }
+    }
+
+    constexpr int16_t operator[](int n) const
+    {
+        return values[n];
+    }
+};
+
+#endif
@@ -16,17 +16,39 @@
 #include <Audio.h>
 #include <math.h>
 #include <stdint.h>
+#include <time.h>
 
-#include "src/CComplex/ccomplex.h"
-
+#include "analysis_window.h"
+#include "band_levels.h"
+#include "capture_stream.h"
+#include "dsp_kernels.h"
 #include "eeprom_data.h"
 #include "eeprom_internal_data.h"
 #include "io.h"
+#include "limit_mask.h"
 #include "pink_noise.h"
+#include "tf_export.h"
 
 #define DEBUG_ENABLED
 #include "debug.h"
 
+// Transform OEM/IEM channel pairs with a single complex FFT instead of two real FFTs
+#define FFT_PAIRED_CHANNELS
+
+// Default window of the analysed frames, generated for FFTSIZE at compile time, see analysis_window.h. Each test type
+// can select another one, see audio_set_test_window().
+#define ANALYSIS_WINDOW ANALYSIS_WINDOW_HAMMING
+
+// Time each stage of the capture and analysis chain, see audio_dump_profiling_stats(). Compiles to nothing when off.
+//#define AUDIO_PROFILING
+
+// Keep the mic audio blocks handed out by the audio library until the frames using them are analysed, instead of
+// copying them into our own capture buffers
+//#define AUDIO_ZERO_COPY_INGESTION
+
+// The analysis runs in float, unless kiss fft is built with FIXED_POINT=16 or FIXED_POINT=32 (project wide, as kiss fft
+// itself must see it). Then samples are windowed in integer, transformed with block scaling and accumulated in 64 bits.
+
 #include "audio.h"
 #include "src/kissfft/kiss_fftr.h"
 
@@ -34,19 +56,122 @@
 // From the audio framework
 #define SAMPLE_RATE ((int)AUDIO_SAMPLE_RATE_EXACT)
 
+#define AUDIO_MEMORY_BLOCKS 120
+#define AUDIO_BLOCK_PERIOD_US ((AUDIO_BLOCK_SAMPLES * 1000000UL) / SAMPLE_RATE)
+// Blocks are captured once two are queued, and the oldest one must go before a third one comes in
+#define CAPTURE_DEADLINE_US (2 * AUDIO_BLOCK_PERIOD_US)
+// Blocks in flight in the I2S objects, play queues and analyzers, on top of the ones we hold
+#define AUDIO_MEMORY_HEADROOM_BLOCKS 40
+
 #define DELAY_PLAYBACK_TO_MIC_SAMPLES 660
 #define PRETEST_DURATION_SEC 1
+
+// Playback to mic latency is measured at start-up by GCC-PHAT over a short noise burst, as the delay of each mic
+// relative to the reference delayed by DELAY_PLAYBACK_TO_MIC_SAMPLES (within +/- FFTSIZE / 2). The mean of the mic
+// delays then replaces DELAY_PLAYBACK_TO_MIC_SAMPLES, and priming only lasts that delay plus a frame instead of a full
+// second. When it fails at start-up, e.g. with nothing plugged in, the first test measures it.
+#define LATENCY_BURST_NB_FFT 16
+#define LATENCY_MIN_PEAK_RATIO 8.0f //correlation peak over mean absolute correlation
+// Mean delays out of range are false peaks. DELAY_PLAYBACK_TO_MIC_SAMPLES is the delay measured on the station, with
+// the capture dump of ManageQueueBuffers() on IEM_L. One block is allowed on either side, for the play and record
+// queues starting a block apart. Must stay within the history of pink_noise_get_delayed.
+#define LATENCY_MIN_DELAY_SAMPLES (DELAY_PLAYBACK_TO_MIC_SAMPLES - AUDIO_BLOCK_SAMPLES)
+#define LATENCY_MAX_DELAY_SAMPLES (DELAY_PLAYBACK_TO_MIC_SAMPLES + AUDIO_BLOCK_SAMPLES)
+#define PRIME_MARGIN_BLOCKS NB_BLOCKS_IN_FFTSIZE
 #define SINE_TONE_PLAYBACK_DURATION 5
 #define TEST1_DURATION_SEC 10
 #define TEST2A_DURATION_SEC 10
 #define TEST2B_DURATION_SEC 10
 #define TEST3_DURATION_SEC 5
-#define HWSERIAL_DELAY_MS 500
+// Combined runs share one excitation between tests, and last as long as the longest of them
+#define MAX_DURATION_SEC(a, b) (((a) > (b)) ? (a) : (b))
+#define TEST_SPK_DURATION_SEC MAX_DURATION_SEC(TEST1_DURATION_SEC, TEST2B_DURATION_SEC)
+#define TEST_CAL_DURATION_SEC MAX_DURATION_SEC(TEST2A_DURATION_SEC, TEST3_DURATION_SEC)
+#define TEST_CAL_VOLUME 0.55f //the calibrated 80 dB of test 3, which its limits are set at
+
+// Exponential sine sweep excitation, see audio_set_sweep_excitation(). Tests then run for a whole number of sweeps
+// instead of their duration, and each frame only accumulates the bins the sweep excites in it (the ones within
+// SWEEP_GATE_DB of its strongest reference bin), which keeps harmonic distortion out of the transfer functions.
+#define SWEEP_F1_HZ 20.0
+#define SWEEP_F2_HZ 20000.0
+#define SWEEP_DURATION_SEC 2
+#define SWEEP_TEST_NB_SWEEPS 2
+#define SWEEP_LENGTH_SAMPLES (SWEEP_DURATION_SEC * SAMPLE_RATE)
+#define SWEEP_AMPLITUDE 16384.0f
+#define SWEEP_GATE_DB 30.0f
+
+// Periodic excitation, see audio_set_multisine_excitation(). Its period is FFTSIZE, so frames are analysed with a
+// rectangular window, and converge after a handful of periods instead of CONVERGENCE_MIN_FRAMES.
+#define MULTISINE_AMPLITUDE 16384.0f //peak
+#define MULTISINE_CONVERGENCE_MIN_FRAMES 8
+
+// Transfer function value for bins that got no reference energy
+#define TF_NO_DATA_DB -200.0f
+#define HWSERIAL_DELAY_MS 500 //pacing of the per curve float upload, audio_export_headset_tf() sends one packet instead
+
+// Early termination: a test stops once every bin of the band of interest is known to within convergence_bound_db at
+// CONVERGENCE_Z standard errors (2.58 is 99%), and runs for its full duration otherwise. A bound of 0 disables it,
+// the default until it is validated on hardware. audio_set_convergence_bound_db(CONVERGENCE_BOUND_DB) enables it.
+#define CONVERGENCE_BOUND_DB 0.25f
+#define CONVERGENCE_Z 2.58f
+#define CONVERGENCE_MIN_FRAMES 20
+#define CONVERGENCE_BAND_LOW_HZ 100
+#define CONVERGENCE_BAND_HIGH_HZ 10000
+
+// Live TF snapshots over the console while a test runs, see audio_set_tf_snapshots(). Points are log spaced bins.
+#define TF_SNAPSHOT_NB_POINTS 32
+#define TF_SNAPSHOT_EMA_ALPHA 0.2f //weight of the newest frame in the exponential average
+
+// Limit masks, see audio_load_limit_masks(). A test stops as soon as a curve is out of its mask by more than
+// LIMIT_MASK_FAIL_Z standard errors at one bin. Strict, since a few hundred bins are tested at every check.
+#define LIMIT_MASK_FAIL_Z 4.0f
+#define LIMIT_MASK_CHECK_EVERY_NB_FRAMES 4
+
+// Live band levels of the mics, see audio_get_band_levels()
+#define BAND_LEVELS_TIME_CONSTANT_MS 125.0f //"fast" of sound level meters
+
+// Sparse analysis, see audio_set_sparse_frequencies(): Goertzel filters on a few bins instead of the full transforms
+#define SPARSE_MAX_BINS 64
 
 #define NB_BLOCKS_IN_FFTSIZE (FFTSIZE / AUDIO_BLOCK_SAMPLES)
 
+// Overlap between consecutive FFT frames (0, 50 or 75 percent). The sample buffers are used as a ring of
+// NB_BLOCKS_IN_FFTSIZE blocks and a new frame is analysed every FFT_HOP_BLOCKS blocks, which gives more averages per
+// second of test for the same FFTSIZE.
+#ifndef FFT_OVERLAP_PERCENT
+#define FFT_OVERLAP_PERCENT 0
+#endif
+#define FFT_HOP_BLOCKS ((NB_BLOCKS_IN_FFTSIZE * (100 - FFT_OVERLAP_PERCENT)) / 100)
+
+#if(FFT_OVERLAP_PERCENT != 0) && (FFT_OVERLAP_PERCENT != 50) && (FFT_OVERLAP_PERCENT != 75)
+#error "FFT_OVERLAP_PERCENT must be 0, 50 or 75"
+#endif
+
+// Capture and analysis are pipelined: capture writes into a ring of two frames worth of blocks, and each complete frame
+// is handed to the analysis as a frame set. Analysis runs one transform at a time in between capture blocks, so capture
+// can run up to a frame ahead and never waits for a whole frame to be transformed.
+#define CAPTURE_RING_BLOCKS (2 * NB_BLOCKS_IN_FFTSIZE)
+#define CAPTURE_RING_SIZE (CAPTURE_RING_BLOCKS * AUDIO_BLOCK_SAMPLES)
+#define NB_FRAME_SETS ((NB_BLOCKS_IN_FFTSIZE / FFT_HOP_BLOCKS) + 1)
+
+#if defined(AUDIO_ZERO_COPY_INGESTION) && \
+    ((4 * CAPTURE_RING_BLOCKS) + AUDIO_MEMORY_HEADROOM_BLOCKS > AUDIO_MEMORY_BLOCKS)
+#error "Capture ring does not fit in the audio memory pool"
+#endif
+
 #define KISS_FFT_OUT_SIZE ((FFTSIZE / 2) + 1)
 
+#define CONVERGENCE_BAND_FIRST_BIN ((CONVERGENCE_BAND_LOW_HZ * FFTSIZE) / SAMPLE_RATE)
+#define CONVERGENCE_BAND_LAST_BIN ((CONVERGENCE_BAND_HIGH_HZ * FFTSIZE) / SAMPLE_RATE)
+#define CONVERGENCE_BAND_NB_BINS (CONVERGENCE_BAND_LAST_BIN - CONVERGENCE_BAND_FIRST_BIN + 1)
+
+// Upper bound of the memory kiss_fftr_alloc needs for a FFTSIZE real plan: state + twiddles for the FFTSIZE/2 complex
+// sub-FFT, plus the FFTSIZE/2 super twiddles and temp buffer. The exact need is checked at init.
+#define FFT_ENGINE_MEM_SIZE (1024 + ((5 * FFTSIZE * sizeof(kiss_fft_cpx)) / 4))
+
+// Same for a FFTSIZE complex plan: state + FFTSIZE twiddles
+#define FFT_PAIR_ENGINE_MEM_SIZE (1024 + (FFTSIZE * sizeof(kiss_fft_cpx)))
+
 //Sine wave for debug
 static AudioSynthWaveformSine AudioSynthWaveformSine_1;
 
@@ -56,12 +181,221 @@ static AudioAnalyzeRMS AudioAnalyzeRMS_IEM_R;
 static AudioAnalyzeRMS AudioAnalyzeRMS_OEM_L;
 static AudioAnalyzeRMS AudioAnalyzeRMS_OEM_R;
 
+#ifdef AUDIO_ZERO_COPY_INGESTION
+#define AUDIO_RECORD_HOLD_QUEUE_SIZE 8
+
+// Same as AudioRecordQueue, except that blocks are taken out of the queue by the caller, who owns them until it
+// releases them, instead of being read in place and freed one at a time
+class AudioRecordHold : public AudioStream
+{
+  public:
+    AudioRecordHold(void) : AudioStream(1, inputQueueArray), head(0), tail(0), enabled(0)
+    {
+    }
+    void begin(void)
+    {
+        clear();
+        enabled = 1;
+    }
+    void end(void)
+    {
+        enabled = 0;
+    }
+    int available(void);
+    void clear(void);
+    audio_block_t *take(void);
+    static void releaseBlock(audio_block_t *block)
+    {
+        release(block);
+    }
+    virtual void update(void);
+
+  private:
+    audio_block_t *inputQueueArray[1];
+    audio_block_t *volatile queue[AUDIO_RECORD_HOLD_QUEUE_SIZE];
+    volatile uint8_t head, tail, enabled;
+};
+
+int AudioRecordHold::available(void)
+{
+    uint32_t h = head;
+    uint32_t t = tail;
+
+    return (h >= t) ? (h - t) : (AUDIO_RECORD_HOLD_QUEUE_SIZE + h - t);
+}
+
+void AudioRecordHold::clear(void)
+{
+    uint32_t t = tail;
+
+    while(t != head)
+    {
+        if(++t >= AUDIO_RECORD_HOLD_QUEUE_SIZE)
+            t = 0;
+        release(queue[t]);
+    }
+    tail = t;
+}
+
+audio_block_t *AudioRecordHold::take(void)
+{
+    uint32_t t = tail;
+
+    if(t == head)
+        return NULL;
+    if(++t >= AUDIO_RECORD_HOLD_QUEUE_SIZE)
+        t = 0;
+    audio_block_t *block = queue[t];
+    tail = t;
+
+    return block;
+}
+
+void AudioRecordHold::update(void)
+{
+    audio_block_t *block = receiveReadOnly();
+    if(!block)
+        return;
+    if(!enabled)
+    {
+        release(block);
+        return;
+    }
+
+    uint32_t h = head + 1;
+    if(h >= AUDIO_RECORD_HOLD_QUEUE_SIZE)
+        h = 0;
+    if(h == tail)
+    {
+        release(block);
+    }
+    else
+    {
+        queue[h] = block;
+        head = h;
+    }
+}
+
+typedef AudioRecordHold capture_record_queue_t;
+#else
+typedef AudioRecordQueue capture_record_queue_t;
+#endif
+
+// Sink fed by the I2S input, so the audio update interrupt tells RunChain that a new block was queued. It is created
+// after the record queues, which puts it after them in the update list: by the time it runs they hold the block.
+#define AUDIO_BLOCK_NOTIFY_HISTORY 8 //power of 2, more blocks than the record queues ever hold
+
+class AudioBlockNotify : public AudioStream
+{
+  public:
+    AudioBlockNotify(void) : AudioStream(1, inputQueueArray), nb_blocks(0), block_us()
+    {
+    }
+    virtual void update(void);
+
+    volatile uint32_t nb_blocks;
+    volatile uint32_t block_us[AUDIO_BLOCK_NOTIFY_HISTORY]; //queue time of block n at n % AUDIO_BLOCK_NOTIFY_HISTORY
+
+  private:
+    audio_block_t *inputQueueArray[1];
+};
+
+void AudioBlockNotify::update(void)
+{
+    audio_block_t *block = receiveReadOnly();
+    if(!block)
+        return;
+    release(block);
+
+    block_us[nb_blocks % AUDIO_BLOCK_NOTIFY_HISTORY] = micros();
+    nb_blocks++;
+}
+
+// Fractional octave levels of the four mics, always running in the audio update. Inputs are in the curve order of
+// audio_get_headset_tf: OEM_L, OEM_R, IEM_L, IEM_R.
+class AudioAnalyzeBandLevels : public AudioStream
+{
+  public:
+    AudioAnalyzeBandLevels(void) : AudioStream(4, inputQueueArray), enabled(false)
+    {
+    }
+    void begin(void);
+    void end(void)
+    {
+        enabled = false;
+    }
+    bool read(float levels_db[4][BAND_LEVELS_NB_BANDS]);
+    const float *centres_hz(void) const
+    {
+        return design.centres_hz;
+    }
+    virtual void update(void);
+
+  private:
+    audio_block_t *inputQueueArray[4];
+    band_levels_design_t design;
+    band_levels_channel_t channels[4];
+    volatile bool enabled;
+};
+
+void AudioAnalyzeBandLevels::begin(void)
+{
+    enabled = false;
+    band_levels_design(&design, SAMPLE_RATE, AUDIO_BLOCK_SAMPLES, BAND_LEVELS_TIME_CONSTANT_MS);
+    for(int ch = 0; ch < 4; ch++)
+    {
+        band_levels_reset(&channels[ch]);
+    }
+    enabled = true;
+}
+
+// Copies the current levels, returns false until every channel had the time to settle
+bool AudioAnalyzeBandLevels::read(float levels_db[4][BAND_LEVELS_NB_BANDS])
+{
+    float mean_square[4][BAND_LEVELS_NB_BANDS];
+    bool settled = true;
+
+    AudioNoInterrupts(); //the audio update writes them
+    for(int ch = 0; ch < 4; ch++)
+    {
+        memcpy(mean_square[ch], channels[ch].mean_square, sizeof(mean_square[ch]));
+        settled = settled && (channels[ch].nb_blocks >= design.settle_blocks);
+    }
+    AudioInterrupts();
+
+    for(int ch = 0; ch < 4; ch++)
+    {
+        for(int band = 0; band < BAND_LEVELS_NB_BANDS; band++)
+        {
+            levels_db[ch][band] =
+                (mean_square[ch][band] > 0.0f) ? (10.0f * log10f(mean_square[ch][band])) : BAND_LEVELS_NO_DATA_DB;
+        }
+    }
+
+    return settled && enabled;
+}
+
+void AudioAnalyzeBandLevels::update(void)
+{
+    for(int ch = 0; ch < 4; ch++)
+    {
+        audio_block_t *block = receiveReadOnly(ch);
+        if(!block)
+            continue;
+        if(enabled)
+            band_levels_process(&design, &channels[ch], block->data);
+        release(block);
+    }
+}
+
 //Input buffers
-static AudioRecordQueue AudioRecordQueue_OEM_L; //in1_L //TODO: validate these comments
-static AudioRecordQueue AudioRecordQueue_IEM_L; //in1_R
-static AudioRecordQueue AudioRecordQueue_OEM_R; //in2_L
-static AudioRecordQueue AudioRecordQueue_IEM_R; //in2_R
+static capture_record_queue_t AudioRecordQueue_OEM_L; //in1_L //TODO: validate these comments
+static capture_record_queue_t AudioRecordQueue_IEM_L; //in1_R
+static capture_record_queue_t AudioRecordQueue_OEM_R; //in2_L
+static capture_record_queue_t AudioRecordQueue_IEM_R; //in2_R
 static AudioRecordQueue AudioRecordQueue_SINE;
+static AudioBlockNotify AudioBlockNotify_1;
+static AudioAnalyzeBandLevels AudioAnalyzeBandLevels_1;
 
 //Output buffers
 static AudioPlayQueue AudioPlayQueue_SPK_L; //in1_L //TODO: validate these comments
@@ -92,46 +426,444 @@ static AudioConnection patchCord11(AudioInputI2SQuad_1, 1, AudioAnalyzeRMS_IEM_R
 static AudioConnection patchCord12(AudioInputI2SQuad_1, 2, AudioAnalyzeRMS_OEM_L, 0);
 static AudioConnection patchCord13(AudioInputI2SQuad_1, 3, AudioAnalyzeRMS_IEM_L, 0);
 
+//Connecting the I2S inputs to the band levels, in curve order
+static AudioConnection patchCord16(AudioInputI2SQuad_1, 2, AudioAnalyzeBandLevels_1, 0);
+static AudioConnection patchCord17(AudioInputI2SQuad_1, 0, AudioAnalyzeBandLevels_1, 1);
+static AudioConnection patchCord18(AudioInputI2SQuad_1, 3, AudioAnalyzeBandLevels_1, 2);
+static AudioConnection patchCord19(AudioInputI2SQuad_1, 1, AudioAnalyzeBandLevels_1, 3);
+
+//Block ready notification
+static AudioConnection patchCord15(AudioInputI2SQuad_1, 0, AudioBlockNotify_1, 0);
+
 // Connect debug sine wave to appropirate buffers
 static AudioConnection patchCord14(AudioSynthWaveformSine_1, 0, AudioRecordQueue_SINE, 0);
 
 static AudioControlSGTL5000 AudioControlSGTL5000_1; //shield 1 is earpiece's loudspeakers
 static AudioControlSGTL5000 AudioControlSGTL5000_2; //shield 2 is Calib loudspeakers, y-splitter
 
-static int next_fft_block_number;
-static bool fft_data_available;
+static int next_capture_block_number;
+static int nb_blocks_captured;       //saturates at NB_BLOCKS_IN_FFTSIZE, once the ring holds a full frame
+static int nb_blocks_since_last_fft; //hop counter
+static uint32_t nb_blocks_in_run;    //since the frame sets were reset, a frame starts every FFT_HOP_BLOCKS of them
+
+// A frame set is a frame of all channels in the capture ring. Capture owns the ring blocks outside of the READY and
+// ANALYSING frame sets, analysis owns the blocks of those, and hands them back by making the frame set FREE.
+typedef enum
+{
+    FRAME_SET_FREE,
+    FRAME_SET_READY,
+    FRAME_SET_ANALYSING,
+} frame_set_state_t;
+
+typedef struct
+{
+    frame_set_state_t state;
+    int start_block;   //oldest ring block of the frame
+    int analysis_step; //next step to run, see analysis_step_t
+} frame_set_t;
+
+static frame_set_t frame_sets[NB_FRAME_SETS];
+static int frame_set_capture_index;  //next frame set handed to analysis
+static int frame_set_analysis_index; //oldest frame set not yet analysed
+
+#ifdef FIXED_POINT
+typedef uint64_t tf_accum_t;
+
+// Powers are brought below 2^TF_ACCUM_POWER_BITS, so the accumulators hold 2^(64 - TF_ACCUM_POWER_BITS) frames of full
+// scale bins. The longest test must fit, at the chosen overlap.
+#define TF_ACCUM_POWER_BITS 51
+#define MAX_TEST_DURATION_SEC MAX_DURATION_SEC(TEST_SPK_DURATION_SEC, TEST_CAL_DURATION_SEC)
+#define MAX_TEST_NB_FFT ((MAX_TEST_DURATION_SEC * SAMPLE_RATE) / (FFT_HOP_BLOCKS * AUDIO_BLOCK_SAMPLES))
+static_assert(MAX_TEST_NB_FFT <= (1LL << (64 - TF_ACCUM_POWER_BITS)), "the longest test overflows the accumulators");
+#else
+typedef float tf_accum_t;
+#endif
+
+// The large analysis buffers live in a static arena, overlaid where their lifetimes do not overlap:
+//   ARENA_PHASE_TEST     capture ring, FFT buffers and accumulators, while a test runs
+//   ARENA_PHASE_LATENCY  capture ring, FFT buffers and the latency cross spectra, over the accumulators
+//   ARENA_PHASE_RESULTS  accumulators and the TF cache, over the capture ring and FFT buffers
+// The buffers keep their names as references into the arena. Leaving a phase invalidates what the next one overlays.
+typedef enum
+{
+    ARENA_PHASE_TEST,
+    ARENA_PHASE_LATENCY,
+    ARENA_PHASE_RESULTS,
+} arena_phase_t;
+
+// Goertzel filter states of the sparse bins for one frame, see UpdateSparseBanks(). Channels in capture stream order.
+typedef enum
+{
+    SPARSE_OEM_L,
+    SPARSE_IEM_L,
+    SPARSE_OEM_R,
+    SPARSE_IEM_R,
+    SPARSE_NOISE,
+    SPARSE_NB_CHANNELS,
+} sparse_channel_t;
+
+typedef struct
+{
+    float s1[SPARSE_NB_CHANNELS][SPARSE_MAX_BINS];
+    float s2[SPARSE_NB_CHANNELS][SPARSE_MAX_BINS];
+    int peak[SPARSE_NB_CHANNELS]; //largest sample magnitude, for the block scaling shift in fixed point
+} sparse_bank_t;
+
+// One bank per frame in progress
+#define SPARSE_NB_BANKS (NB_BLOCKS_IN_FFTSIZE / FFT_HOP_BLOCKS)
+
+// Live while the chain runs. Aligned to 4 bytes in case they are accessed as uint32, as pink noise is doing.
+typedef struct
+{
+#ifndef AUDIO_ZERO_COPY_INGESTION
+    // Regular sample buffers to interact with RecordQueues and PlayQueues
+    int16_t bOEM_L[CAPTURE_RING_SIZE] __attribute__((aligned(4)));
+    int16_t bIEM_L[CAPTURE_RING_SIZE] __attribute__((aligned(4)));
+    int16_t bOEM_R[CAPTURE_RING_SIZE] __attribute__((aligned(4)));
+    int16_t bIEM_R[CAPTURE_RING_SIZE] __attribute__((aligned(4)));
+#endif
+    int16_t bNoise_delayed[CAPTURE_RING_SIZE] __attribute__((aligned(4)));
+
+#ifdef FFT_PAIRED_CHANNELS
+    kiss_fft_cpx fftPairIn[FFTSIZE];
+    kiss_fft_cpx fftPairOut[FFTSIZE];
+#endif
+    kiss_fft_scalar fftIn[FFTSIZE];
+    kiss_fft_cpx fftOEM_L[KISS_FFT_OUT_SIZE];
+    kiss_fft_cpx fftIEM_L[KISS_FFT_OUT_SIZE];
+    kiss_fft_cpx fftOEM_R[KISS_FFT_OUT_SIZE];
+    kiss_fft_cpx fftIEM_R[KISS_FFT_OUT_SIZE];
+    kiss_fft_cpx fftNoise_delayed[KISS_FFT_OUT_SIZE];
+
+    sparse_bank_t sparse_banks[SPARSE_NB_BANKS]; //frames being captured
+    sparse_bank_t sparse_frames[NB_FRAME_SETS];  //complete frames, by frame set
+} arena_chain_t;
+
+typedef struct
+{
+    tf_accum_t NoiseSquaredCumul[FFTSIZE / 2];
+    tf_accum_t MIEMLSquaredCumul[FFTSIZE / 2];
+    tf_accum_t MIEMRSquaredCumul[FFTSIZE / 2];
+    tf_accum_t MOEMLSquaredCumul[FFTSIZE / 2];
+    tf_accum_t MOEMRSquaredCumul[FFTSIZE / 2];
+    tf_accum_t Band2FIEMLSquaredCumul[FFTSIZE / 2];
+    tf_accum_t Band2FIEMRSquaredCumul[FFTSIZE / 2];
+    tf_accum_t Band2FOEMLSquaredCumul[FFTSIZE / 2];
+    tf_accum_t Band2FOEMRSquaredCumul[FFTSIZE / 2];
+} arena_accum_t;
+
+typedef struct
+{
+    float re[4][KISS_FFT_OUT_SIZE];
+    float im[4][KISS_FFT_OUT_SIZE];
+} arena_latency_t;
 
-//Align buffers to multiples of 4 bytes in case they are accessed as uint32, as pink noise is doing
+typedef union
+{
+    arena_chain_t chain;
+    float tf_cache[8][FFTSIZE / 2];
+} arena_chain_or_results_t;
 
-// Regular sample buffers to interact with RecordQueues and PlayQueues
-static int16_t bOEM_L[FFTSIZE] __attribute__((aligned(4)));
-static int16_t bIEM_L[FFTSIZE] __attribute__((aligned(4)));
-static int16_t bOEM_R[FFTSIZE] __attribute__((aligned(4)));
-static int16_t bIEM_R[FFTSIZE] __attribute__((aligned(4)));
-static int16_t bNoise[FFTSIZE]
-    __attribute__((aligned(4))); //technically we only need AUDIO_BLOCK_SAMPLES, but using FFTSIZE for coherence
-static int16_t bNoise_delayed[FFTSIZE] __attribute__((aligned(4)));
+typedef union
+{
+    arena_accum_t accum;
+    arena_latency_t latency;
+} arena_accum_or_latency_t;
+
+static arena_chain_or_results_t arena_chain_or_results __attribute__((aligned(8)));
+static arena_accum_or_latency_t arena_accum_or_latency __attribute__((aligned(8)));
+static arena_phase_t arena_phase = ARENA_PHASE_TEST;
+static bool audio_chain_running = false;
+
+// Fail the build rather than the link when a larger FFTSIZE does not fit, see audio_dump_memory_report()
+#define AUDIO_ARENA_BUDGET_BYTES (384 * 1024)
+static_assert((sizeof(arena_chain_or_results_t) + sizeof(arena_accum_or_latency_t)) <= AUDIO_ARENA_BUDGET_BYTES,
+              "analysis arena over budget for this FFTSIZE");
+
+#ifdef AUDIO_ZERO_COPY_INGESTION
+// Audio library blocks held in each capture ring slot, released when the slot is reused
+static audio_block_t *heldOEM_L[CAPTURE_RING_BLOCKS];
+static audio_block_t *heldIEM_L[CAPTURE_RING_BLOCKS];
+static audio_block_t *heldOEM_R[CAPTURE_RING_BLOCKS];
+static audio_block_t *heldIEM_R[CAPTURE_RING_BLOCKS];
+#else
+static int16_t (&bOEM_L)[CAPTURE_RING_SIZE] = arena_chain_or_results.chain.bOEM_L;
+static int16_t (&bIEM_L)[CAPTURE_RING_SIZE] = arena_chain_or_results.chain.bIEM_L;
+static int16_t (&bOEM_R)[CAPTURE_RING_SIZE] = arena_chain_or_results.chain.bOEM_R;
+static int16_t (&bIEM_R)[CAPTURE_RING_SIZE] = arena_chain_or_results.chain.bIEM_R;
+#endif
+static int16_t (&bNoise_delayed)[CAPTURE_RING_SIZE] = arena_chain_or_results.chain.bNoise_delayed;
+
+// The analysis reads the capture ring through these, one pointer to AUDIO_BLOCK_SAMPLES samples per ring slot
+static const int16_t *ringOEM_L[CAPTURE_RING_BLOCKS];
+static const int16_t *ringIEM_L[CAPTURE_RING_BLOCKS];
+static const int16_t *ringOEM_R[CAPTURE_RING_BLOCKS];
+static const int16_t *ringIEM_R[CAPTURE_RING_BLOCKS];
+static const int16_t *ringNoise_delayed[CAPTURE_RING_BLOCKS];
 static int16_t bSine[AUDIO_BLOCK_SAMPLES];
 
 
+// FFT plan built once at init and shared by all channels, so no heap allocation happens while a test runs
+typedef struct
+{
+    kiss_fftr_cfg cfg;
+    uint8_t mem[FFT_ENGINE_MEM_SIZE] __attribute__((aligned(8)));
+} fft_engine_t;
+
+static fft_engine_t fft_engine;
+static fft_engine_t fft_inverse_engine; //latency estimation only
+
+#ifdef FFT_PAIRED_CHANNELS
+// Complex plan used to transform two real channels at once, one in the real part and one in the imaginary part
+typedef struct
+{
+    kiss_fft_cfg cfg;
+    uint8_t mem[FFT_PAIR_ENGINE_MEM_SIZE] __attribute__((aligned(8)));
+} fft_pair_engine_t;
+
+static fft_pair_engine_t fft_pair_engine;
+
+static kiss_fft_cpx (&fftPairIn)[FFTSIZE] = arena_chain_or_results.chain.fftPairIn;
+static kiss_fft_cpx (&fftPairOut)[FFTSIZE] = arena_chain_or_results.chain.fftPairOut;
+#endif
+
 // buffers for kiss fft input (scalar)
-static kiss_fft_scalar fftIn[FFTSIZE];
+static kiss_fft_scalar (&fftIn)[FFTSIZE] = arena_chain_or_results.chain.fftIn;
+
+#ifndef FIXED_POINT
+// Analysis window in float, with the q1.15 to float scaling of the samples folded in. Built at init.
+static float fftWindow[FFTSIZE];
+#endif
+
+// Block scaling shift applied to the input of each transform and undone when accumulating. Always 0 in float.
+static int fftOEM_L_shift;
+static int fftIEM_L_shift;
+static int fftOEM_R_shift;
+static int fftIEM_R_shift;
+static int fftNoise_delayed_shift;
 
 // buffers for kiss fft output (complex)
-static kiss_fft_cpx fftOEM_L[KISS_FFT_OUT_SIZE];
-static kiss_fft_cpx fftIEM_L[KISS_FFT_OUT_SIZE];
-static kiss_fft_cpx fftOEM_R[KISS_FFT_OUT_SIZE];
-static kiss_fft_cpx fftIEM_R[KISS_FFT_OUT_SIZE];
-static kiss_fft_cpx fftNoise_delayed[KISS_FFT_OUT_SIZE];
+static kiss_fft_cpx (&fftOEM_L)[KISS_FFT_OUT_SIZE] = arena_chain_or_results.chain.fftOEM_L;
+static kiss_fft_cpx (&fftIEM_L)[KISS_FFT_OUT_SIZE] = arena_chain_or_results.chain.fftIEM_L;
+static kiss_fft_cpx (&fftOEM_R)[KISS_FFT_OUT_SIZE] = arena_chain_or_results.chain.fftOEM_R;
+static kiss_fft_cpx (&fftIEM_R)[KISS_FFT_OUT_SIZE] = arena_chain_or_results.chain.fftIEM_R;
+static kiss_fft_cpx (&fftNoise_delayed)[KISS_FFT_OUT_SIZE] = arena_chain_or_results.chain.fftNoise_delayed;
+static sparse_bank_t (&sparse_banks)[SPARSE_NB_BANKS] = arena_chain_or_results.chain.sparse_banks;
+static sparse_bank_t (&sparse_frames)[NB_FRAME_SETS] = arena_chain_or_results.chain.sparse_frames;
 
 //Noise played
-static float NoiseSquaredCumul[FFTSIZE / 2];
+static tf_accum_t (&NoiseSquaredCumul)[FFTSIZE / 2] = arena_accum_or_latency.accum.NoiseSquaredCumul;
 
 // Measured values
-static float MIEMLSquaredCumul[FFTSIZE / 2];
-static float MIEMRSquaredCumul[FFTSIZE / 2];
-static float MOEMLSquaredCumul[FFTSIZE / 2];
-static float MOEMRSquaredCumul[FFTSIZE / 2];
+static tf_accum_t (&MIEMLSquaredCumul)[FFTSIZE / 2] = arena_accum_or_latency.accum.MIEMLSquaredCumul;
+static tf_accum_t (&MIEMRSquaredCumul)[FFTSIZE / 2] = arena_accum_or_latency.accum.MIEMRSquaredCumul;
+static tf_accum_t (&MOEMLSquaredCumul)[FFTSIZE / 2] = arena_accum_or_latency.accum.MOEMLSquaredCumul;
+static tf_accum_t (&MOEMRSquaredCumul)[FFTSIZE / 2] = arena_accum_or_latency.accum.MOEMRSquaredCumul;
+
+// Mic power over bins 2k and 2k + 1 while the sweep excites bin k, see ComputeAccumulateSweepFFTs(). Sweep only.
+static tf_accum_t (&Band2FIEMLSquaredCumul)[FFTSIZE / 2] = arena_accum_or_latency.accum.Band2FIEMLSquaredCumul;
+static tf_accum_t (&Band2FIEMRSquaredCumul)[FFTSIZE / 2] = arena_accum_or_latency.accum.Band2FIEMRSquaredCumul;
+static tf_accum_t (&Band2FOEMLSquaredCumul)[FFTSIZE / 2] = arena_accum_or_latency.accum.Band2FOEMLSquaredCumul;
+static tf_accum_t (&Band2FOEMRSquaredCumul)[FFTSIZE / 2] = arena_accum_or_latency.accum.Band2FOEMRSquaredCumul;
+
+// Curves of audio_get_headset_tf, computed together the first time one is asked for after the accumulators changed
+static float (&tf_cache)[8][FFTSIZE / 2] = arena_chain_or_results.tf_cache;
+static bool tf_cache_valid = false;
+
+// Running per-bin mean and sum of squared deviations (Welford) of the per-frame transfer functions in dB, over the
+// convergence band. The spread of single-frame estimates overstates the one of the accumulated ratio. Overlapped
+// frames are correlated, so the standard errors only count the ones that do not overlap, see
+// ConvergenceNbIndependentFrames().
+typedef struct
+{
+    float mean[CONVERGENCE_BAND_NB_BINS];
+    float m2[CONVERGENCE_BAND_NB_BINS];
+} convergence_stats_t;
+
+static convergence_stats_t convergence_stats[4]; //indexed by curve id, as in audio_get_headset_tf
+static int convergence_nb_frames;
+static float convergence_bound_db = 0.0f;
+static int last_test_nb_frames;
+
+// Limits of one curve of a result over the convergence band, the tightest of its masks. The convergence stats give the
+// uncertainty, and as they overstate it, a result only fails early when it certainly fails.
+#define LIMIT_MAX_CHECKS 8 //curves of the results of tests 2A and 3
+
+typedef struct
+{
+    int result; //index in run_results
+    int curve;
+    float lower_db[CONVERGENCE_BAND_NB_BINS];
+    float upper_db[CONVERGENCE_BAND_NB_BINS];
+} limit_check_t;
+
+static limit_mask_set_t limit_masks;
+static limit_check_t limit_checks[LIMIT_MAX_CHECKS];
+static int limit_nb_checks;
+static bool limit_mask_failed_early; //all the tests of the run failed, and it stopped
+
+// Decimated TF curves sent every tf_snapshot_every_nb_frames frames, one console line per curve, between blocks
+typedef struct
+{
+    int every_nb_frames; //0 when off
+    bool exponential;    //exponential average of the frames instead of the cumulated test
+    int nb_points;
+    int bins[TF_SNAPSHOT_NB_POINTS];
+    float ema_xx[TF_SNAPSHOT_NB_POINTS];
+    float ema_yy[4][TF_SNAPSHOT_NB_POINTS];
+    int16_t centi_db[4][TF_SNAPSHOT_NB_POINTS];
+    int frame;         //frame the pending snapshot was taken at
+    int next_line;     //next line to send, -1 when nothing is pending. Line 0 gives the bins, then one per curve.
+    bool bins_sent;    //once per test
+    int nb_skipped;    //snapshots due while the previous one was still being sent
+} tf_snapshot_t;
+
+static tf_snapshot_t tf_snapshot = {0, false, 0, {0}, {0}, {{0}}, {{0}}, 0, -1, false, 0};
+
+// Set by audio_abort_test(), the running test stops after the current step and reports a failure
+static volatile bool test_abort_requested = false;
+
+// Called by RunChain when it has nothing to do until the next audio block, for other station work
+static void (*idle_callback)(void);
+static int nb_block_overruns; //blocks captured more than CAPTURE_DEADLINE_US after they were queued
+
+// Reference delay fed to pink_noise_get_delayed, and the last measured delay of each mic, in curve id order
+static int playback_to_mic_delay = DELAY_PLAYBACK_TO_MIC_SAMPLES;
+static int latency_mic_delays[4];
+static bool latency_measured = false;
+static bool latency_measurement_running = false;
+
+// Cross spectra of the reference with each mic, in curve id order, accumulated during the latency burst
+static float (&latency_cross_re)[4][KISS_FFT_OUT_SIZE] = arena_accum_or_latency.latency.re;
+static float (&latency_cross_im)[4][KISS_FFT_OUT_SIZE] = arena_accum_or_latency.latency.im;
+
+// Bins of the sparse analysis, with the Goertzel coefficient 2 cos(w) and sin(w) of each. None for the full analysis.
+static int sparse_bins[SPARSE_MAX_BINS];
+static float sparse_coeffs[SPARSE_MAX_BINS];
+static float sparse_sines[SPARSE_MAX_BINS];
+static int sparse_nb_bins = 0;
+
+static bool sweep_excitation = false;
+static int32_t excitation_next_sample; //index of the next sample played, the delayed reference lags it
+
+// One period of the multisine, and its spectrum as analysed, which is the same in every frame up to a phase
+static bool multisine_excitation = false;
+static bool multisine_generated = false;
+static int16_t multisine_period[FFTSIZE];
+static kiss_fft_cpx multisine_spectrum[KISS_FFT_OUT_SIZE];
+static int multisine_spectrum_shift;
+
+// Raw capture streaming over USB serial, see capture_stream.h
+#define NB_CAPTURE_STREAM_CHANNELS 5
+static bool capture_streaming_enabled = false;
+static uint8_t capture_stream_flags;
+
+// Ticks are CPU cycles on target, nanoseconds on host, for the profiling and the benchmarks
+#if defined(__arm__)
+#define PROFILE_TICKS_PER_US (F_CPU / 1000000)
+
+static inline uint32_t profile_ticks(void)
+{
+    return ARM_DWT_CYCCNT;
+}
+#else
+#define PROFILE_TICKS_PER_US 1000
+
+static inline uint32_t profile_ticks(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((ts.tv_sec * 1000000000ULL) + ts.tv_nsec);
+}
+#endif
+
+#ifdef AUDIO_PROFILING
+typedef enum
+{
+    PROFILE_STAGE_CAPTURE, //ManageQueueBuffers, pink noise included
+    PROFILE_STAGE_PINK_NOISE,
+    PROFILE_STAGE_PINK_NOISE_DELAYED,
+    PROFILE_STAGE_FFT, //one ComputeFFT or ComputeFFTPair
+    PROFILE_STAGE_ACCUMULATE,
+    PROFILE_STAGE_GET_TF,         //all curves, when the TF cache is filled
+    PROFILE_STAGE_SPARSE_FILTERS, //the Goertzel filters of the sparse analysis over one block, part of capture
+    NB_PROFILE_STAGES,
+} profile_stage_t;
+
+static const char *const profile_stage_names[NB_PROFILE_STAGES] = {
+    "capture", "pink_noise", "pink_noise_delayed", "fft", "accumulate", "get_tf", "sparse_filters",
+};
+
+// Buckets are an eighth of a block period wide, the last one takes everything from 15/8 of a period up
+#define PROFILE_HISTOGRAM_BUCKETS 16
+#define PROFILE_BUCKET_TICKS ((AUDIO_BLOCK_PERIOD_US * PROFILE_TICKS_PER_US) / 8)
+
+typedef struct
+{
+    uint32_t nb;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t histogram[PROFILE_HISTOGRAM_BUCKETS];
+} profile_stats_t;
+
+static profile_stats_t profile_stats[NB_PROFILE_STAGES];
+static int profile_queue_depth_max;
+static int profile_nb_arena_phase_changes; //each one clears or invalidates buffers of the arena
+
+static void ResetProfilingStats(void)
+{
+    memset(profile_stats, 0, sizeof(profile_stats));
+    for(int stage = 0; stage < NB_PROFILE_STAGES; stage++)
+    {
+        profile_stats[stage].min = UINT32_MAX;
+    }
+    profile_queue_depth_max = 0;
+    profile_nb_arena_phase_changes = 0;
+}
+
+static void ProfileRecord(profile_stage_t stage, uint32_t start_ticks)
+{
+    const uint32_t ticks = profile_ticks() - start_ticks;
+    profile_stats_t *stats = &profile_stats[stage];
+
+    stats->nb++;
+    stats->sum += ticks;
+    if(ticks < stats->min)
+    {
+        stats->min = ticks;
+    }
+    if(ticks > stats->max)
+    {
+        stats->max = ticks;
+    }
+
+    uint32_t bucket = ticks / PROFILE_BUCKET_TICKS;
+    if(bucket >= PROFILE_HISTOGRAM_BUCKETS)
+    {
+        bucket = PROFILE_HISTOGRAM_BUCKETS - 1;
+    }
+    stats->histogram[bucket]++;
+}
+
+static inline void ProfileQueueDepth(int depth)
+{
+    if(depth > profile_queue_depth_max)
+    {
+        profile_queue_depth_max = depth;
+    }
+}
+
+#define PROFILE_BEGIN(start) const uint32_t start = profile_ticks()
+#define PROFILE_END(stage, start) ProfileRecord(stage, start)
+#define PROFILE_QUEUE_DEPTH(depth) ProfileQueueDepth(depth)
+#define PROFILE_ARENA_PHASE_CHANGE() (profile_nb_arena_phase_changes++)
+#else
+#define PROFILE_BEGIN(start)
+#define PROFILE_END(stage, start)
+#define PROFILE_QUEUE_DEPTH(depth)
+#define PROFILE_ARENA_PHASE_CHANGE()
+#endif
 
 static bool audio_headset_connected = false;
 static bool audio_headset_eeprom_alive = false;
@@ -145,8 +877,28 @@ typedef enum
     TEST_TYPE_2B,
     TEST_TYPE_3,
     TEST_TYPE_SINE_DEBUG,
+    TEST_TYPE_SPK, //tests 0, 1 and 2B in one run
+    TEST_TYPE_CAL, //tests 2A and 3 in one run
+    NB_TEST_TYPES,
 } test_type_t;
 
+// Test the accumulators hold the results of, reported in the exported packets
+static test_type_t accumulated_test_type = TEST_TYPE_0;
+
+// Results the running test still has to decide, see PrepareResult(). A combined run decides the results of several
+// tests from the same curves, and one test failing early must not cut the others short.
+#define RUN_MAX_RESULTS 6 //tests 2A and 3
+
+typedef struct
+{
+    test_type_t test_type;
+    unsigned curve_mask; //curves the result is decided from
+    bool failed_early;
+} run_result_t;
+
+static run_result_t run_results[RUN_MAX_RESULTS];
+static int run_nb_results;
+
 static inline float amplitude2dB(float amplitude_value)
 {
     return 20.0f * log10f(amplitude_value);
@@ -167,6 +919,30 @@ static inline float dB2energy(float dB_value)
     return powf(10.0f, dB_value / 10.0f);
 }
 
+// log2 of a positive normal float, within 1e-5 of log2f (3e-5 dB once scaled to energy dB). The mantissa is brought to
+// [sqrt(2)/2, sqrt(2)) and log2(m) = 2 / ln(2) * atanh((m - 1) / (m + 1)) is summed to the t^7 term, with |t| < 0.172.
+static inline float fast_log2f(float x)
+{
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+
+    int exponent = (int)((bits >> 23) & 0xFF) - 127;
+    bits = (bits & 0x007FFFFFUL) | 0x3F800000UL; //mantissa in [1, 2)
+    float m;
+    memcpy(&m, &bits, sizeof(m));
+    if(m > 1.41421356f)
+    {
+        m *= 0.5f;
+        exponent++;
+    }
+
+    const float t = (m - 1.0f) / (m + 1.0f);
+    const float t2 = t * t;
+    const float series = t * (2.0f + t2 * ((2.0f / 3.0f) + t2 * ((2.0f / 5.0f) + t2 * (2.0f / 7.0f))));
+
+    return (float)exponent + (series * 1.44269504f);
+}
+
 static void beginAudioRecordQueues()
 {
     AudioRecordQueue_OEM_L.begin();
@@ -185,8 +961,44 @@ static void endAudioRecordQueues()
     AudioRecordQueue_SINE.end();
 }
 
+#ifdef AUDIO_ZERO_COPY_INGESTION
+static void ReleaseHeldBlock(audio_block_t *held[CAPTURE_RING_BLOCKS], const int16_t *ring[CAPTURE_RING_BLOCKS],
+                             int block)
+{
+    if(held[block] != NULL)
+    {
+        AudioRecordHold::releaseBlock(held[block]);
+        held[block] = NULL;
+    }
+    ring[block] = NULL;
+}
+#endif
+
+// Points the capture ring slots at their samples, and gives back any held audio block to the audio library
+static void ResetCaptureRing(void)
+{
+    for(int b = 0; b < CAPTURE_RING_BLOCKS; b++)
+    {
+#ifdef AUDIO_ZERO_COPY_INGESTION
+        ReleaseHeldBlock(heldOEM_L, ringOEM_L, b);
+        ReleaseHeldBlock(heldIEM_L, ringIEM_L, b);
+        ReleaseHeldBlock(heldOEM_R, ringOEM_R, b);
+        ReleaseHeldBlock(heldIEM_R, ringIEM_R, b);
+#else
+        ringOEM_L[b] = &bOEM_L[b * AUDIO_BLOCK_SAMPLES];
+        ringIEM_L[b] = &bIEM_L[b * AUDIO_BLOCK_SAMPLES];
+        ringOEM_R[b] = &bOEM_R[b * AUDIO_BLOCK_SAMPLES];
+        ringIEM_R[b] = &bIEM_R[b * AUDIO_BLOCK_SAMPLES];
+#endif
+        ringNoise_delayed[b] = &bNoise_delayed[b * AUDIO_BLOCK_SAMPLES];
+    }
+}
+
 static inline void enableAudioChain()
 {
+    PanicFalse(arena_phase != ARENA_PHASE_RESULTS); //ResetChain() first, the capture ring holds the TF cache
+    audio_chain_running = true;
+
     beginAudioRecordQueues();
     audio_enable_interrupts();
 }
@@ -195,7 +1007,34 @@ static inline void disableAudioChain()
 {
     endAudioRecordQueues();
     audio_disable_interrupts();
+    audio_chain_running = false;
+
+    ResetCaptureRing();
+    DEBUG("Audio memory high-water mark: %d/%d blocks\n", (int)AudioMemoryUsageMax(), AUDIO_MEMORY_BLOCKS);
+    if(nb_block_overruns > 0)
+    {
+        DEBUG("%d blocks captured past their deadline\n", nb_block_overruns);
+    }
+    if(capture_streaming_enabled)
+    {
+        DEBUG("Capture stream: %lu blocks sent, %lu dropped\n", (unsigned long)capture_stream_get_nb_sent(),
+              (unsigned long)capture_stream_get_nb_dropped());
+    }
+}
+
+#ifdef AUDIO_ZERO_COPY_INGESTION
+static void HoldRecordQueue(AudioRecordHold &rq, audio_block_t *held[CAPTURE_RING_BLOCKS],
+                            const int16_t *ring[CAPTURE_RING_BLOCKS], int block)
+{
+    audio_block_t *audio_block = rq.take();
+    PanicFalse(audio_block != NULL);
+
+    // The slot is not part of any pending frame set anymore, so its previous block can go back to the pool
+    ReleaseHeldBlock(held, ring, block);
+    held[block] = audio_block;
+    ring[block] = audio_block->data;
 }
+#endif
 
 static void ReadRecordQueue(AudioRecordQueue &rq, int16_t dest_buf[AUDIO_BLOCK_SAMPLES])
 {
@@ -213,61 +1052,363 @@ static void WritePlayQueue(AudioPlayQueue &pq, const int16_t source_buf[AUDIO_BL
     pq.playBuffer();
 }
 
-static void ManageQueueBuffers(test_type_t test_type, uint8_t channel)
+// Block of the repeated exponential sweep starting at sample first_sample, silence before sample 0. The phase has a
+// closed form in the sample index, so the delayed reference is exactly what was played, without keeping a history:
+//   phase(n) = 2 pi f1 L (exp(n / (fs L)) - 1), with L = T / ln(f2 / f1)
+// It is evaluated in double at the start of the block and of each sweep, and advanced in float in between.
+static void sweep_get(int16_t dest_buf[AUDIO_BLOCK_SAMPLES], int32_t first_sample)
 {
-    ReadRecordQueue(AudioRecordQueue_OEM_L, &bOEM_L[next_fft_block_number * AUDIO_BLOCK_SAMPLES]);
-    ReadRecordQueue(AudioRecordQueue_IEM_L, &bIEM_L[next_fft_block_number * AUDIO_BLOCK_SAMPLES]);
-    ReadRecordQueue(AudioRecordQueue_OEM_R, &bOEM_R[next_fft_block_number * AUDIO_BLOCK_SAMPLES]);
-    ReadRecordQueue(AudioRecordQueue_IEM_R, &bIEM_R[next_fft_block_number * AUDIO_BLOCK_SAMPLES]);
-    ReadRecordQueue(AudioRecordQueue_SINE, bSine);
+    PanicFalse(dest_buf != NULL);
 
-#if 0
-    // This code can be used to calculate the delay between noise samples generated and when they are available in the mic inputs
-    static int aa = 0;
-    if(aa < 10)
+    const double two_pi = 2.0 * M_PI;
+    const double sweep_l = SWEEP_DURATION_SEC / log(SWEEP_F2_HZ / SWEEP_F1_HZ);
+    const double ratio = exp(1.0 / (SAMPLE_RATE * sweep_l));
+
+    float phase = 0.0f;
+    float phase_inc = 0.0f;
+    for(int i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
     {
-        if(aa == 0)
-            console_write("a = [ ");
-        for(int i=0; i<AUDIO_BLOCK_SAMPLES; i++)
+        const int32_t n = first_sample + i;
+        if(n < 0)
         {
-            console_write("%d ", bIEM_L[next_fft_block_number*AUDIO_BLOCK_SAMPLES+i]);
+            dest_buf[i] = 0;
+            continue;
         }
-        if(aa == 9)
-            console_write("];\n");
-        aa++;
+
+        const int32_t k = n % SWEEP_LENGTH_SAMPLES;
+        if((k == 0) || (i == 0))
+        {
+            const double growth = exp(k / (SAMPLE_RATE * sweep_l));
+            phase = (float)fmod(two_pi * SWEEP_F1_HZ * sweep_l * (growth - 1.0), two_pi);
+            phase_inc = (float)(two_pi * SWEEP_F1_HZ * sweep_l * growth * (ratio - 1.0));
+        }
+
+        dest_buf[i] = (int16_t)(SWEEP_AMPLITUDE * sinf(phase));
+
+        phase += phase_inc;
+        if(phase >= (float)two_pi)
+        {
+            phase -= (float)two_pi;
+        }
+        phase_inc *= (float)ratio;
     }
-#endif
+}
 
-    pink_noise_get(&bNoise[next_fft_block_number * AUDIO_BLOCK_SAMPLES]);
-    pink_noise_get_delayed(&bNoise_delayed[next_fft_block_number * AUDIO_BLOCK_SAMPLES], DELAY_PLAYBACK_TO_MIC_SAMPLES);
+// Block of the repeated multisine period starting at sample first_sample, silence before sample 0
+static void multisine_get(int16_t dest_buf[AUDIO_BLOCK_SAMPLES], int32_t first_sample)
+{
+    PanicFalse(dest_buf != NULL);
+    PanicFalse(multisine_generated);
 
-    // Output noise to appropriate shield depending on test
-    // We play back the non-delayed noise, and analyze the delayed noise to get sync between REF and MIC FFTs
-    if((test_type == TEST_TYPE_0) || (test_type == TEST_TYPE_1) || (test_type == TEST_TYPE_2B))
+    for(int i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
     {
-        WritePlayQueue(AudioPlayQueue_SPK_L, &bNoise[next_fft_block_number * AUDIO_BLOCK_SAMPLES]);
-        WritePlayQueue(AudioPlayQueue_SPK_R, &bNoise[next_fft_block_number * AUDIO_BLOCK_SAMPLES]);
+        const int32_t n = first_sample + i;
+        dest_buf[i] = (n < 0) ? 0 : multisine_period[n % FFTSIZE];
     }
-    else if((test_type == TEST_TYPE_2A) || (test_type == TEST_TYPE_3))
+}
+
+// The excitation is generated straight into the first play queue buffer, then copied to the second one
+static void PlayNoise(AudioPlayQueue &pq_a, AudioPlayQueue &pq_b)
+{
+    int16_t *write_buf_a = pq_a.getBuffer();
+    int16_t *write_buf_b = pq_b.getBuffer();
+    PanicFalse(write_buf_a != NULL);
+    PanicFalse(write_buf_b != NULL);
+
+    PROFILE_BEGIN(pink_noise_start);
+    if(sweep_excitation)
     {
-        WritePlayQueue(AudioPlayQueue_CAL_L, &bNoise[next_fft_block_number * AUDIO_BLOCK_SAMPLES]);
-        WritePlayQueue(AudioPlayQueue_CAL_R, &bNoise[next_fft_block_number * AUDIO_BLOCK_SAMPLES]);
+        sweep_get(write_buf_a, excitation_next_sample);
     }
-    else if(test_type == TEST_TYPE_SINE_DEBUG)
+    else if(multisine_excitation)
     {
-        switch(channel)
-        {
-            case 0:
-                WritePlayQueue(AudioPlayQueue_SPK_L, bSine);
-                break;
-            case 1:
-                WritePlayQueue(AudioPlayQueue_SPK_R, bSine);
-                break;
-            case 2:
-                WritePlayQueue(AudioPlayQueue_CAL_L, bSine);
-                break;
-            case 3:
-                WritePlayQueue(AudioPlayQueue_CAL_R, bSine);
+        multisine_get(write_buf_a, excitation_next_sample);
+    }
+    else
+    {
+        pink_noise_get(write_buf_a);
+    }
+    PROFILE_END(PROFILE_STAGE_PINK_NOISE, pink_noise_start);
+    memcpy(write_buf_b, write_buf_a, AUDIO_BLOCK_SAMPLES * sizeof(int16_t));
+
+    pq_a.playBuffer();
+    pq_b.playBuffer();
+}
+
+static void ResetFrameSets(void)
+{
+    memset(frame_sets, 0, sizeof(frame_sets));
+    frame_set_capture_index = 0;
+    frame_set_analysis_index = 0;
+}
+
+// Frame sets published while the chain was primed hold samples from before the run that follows. Drops them, and makes
+// the first frame of that run wait for a full frame of new blocks.
+static void DiscardFrameSets(void)
+{
+    ResetFrameSets();
+    nb_blocks_captured = 0;
+    nb_blocks_since_last_fft = 0;
+    nb_blocks_in_run = 0;
+}
+
+// Capture must never write into a block still owned by the analysis
+static bool CaptureBlockIsFree(int block)
+{
+    for(int i = 0; i < NB_FRAME_SETS; i++)
+    {
+        const frame_set_t *fs = &frame_sets[i];
+        if((fs->state != FRAME_SET_FREE) &&
+           (((block - fs->start_block + CAPTURE_RING_BLOCKS) % CAPTURE_RING_BLOCKS) < NB_BLOCKS_IN_FFTSIZE))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void PublishFrameSet(int start_block)
+{
+    frame_set_t *fs = &frame_sets[frame_set_capture_index];
+
+    // All frame sets still pending means the analysis is more than a frame behind capture
+    PanicFalse(fs->state == FRAME_SET_FREE);
+
+    fs->start_block = start_block;
+    fs->analysis_step = 0;
+    fs->state = FRAME_SET_READY;
+
+    frame_set_capture_index = (frame_set_capture_index + 1) % NB_FRAME_SETS;
+}
+
+// Channels go out in the order of the capture files: OEM_L, IEM_L, OEM_R, IEM_R, delayed noise
+static void StreamCaptureBlock(test_type_t test_type, int block)
+{
+    const int16_t *const channels[NB_CAPTURE_STREAM_CHANNELS] = {ringOEM_L[block], ringIEM_L[block], ringOEM_R[block],
+                                                                 ringIEM_R[block], ringNoise_delayed[block]};
+
+    capture_stream_send_block((uint8_t)test_type, capture_stream_flags, channels, NB_CAPTURE_STREAM_CHANNELS,
+                              AUDIO_BLOCK_SAMPLES);
+}
+
+static_assert((FFTSIZE % AUDIO_BLOCK_SAMPLES) == 0, "frames are made of whole audio blocks");
+static_assert((FFTSIZE % 2) == 0, "kiss_fftr needs an even FFTSIZE");
+
+// Every window a test can select, in flash
+static constexpr AnalysisWindowQ15<FFTSIZE, ANALYSIS_WINDOW_HANN> hann_window = {};
+static constexpr AnalysisWindowQ15<FFTSIZE, ANALYSIS_WINDOW_HAMMING> hamming_window = {};
+static constexpr AnalysisWindowQ15<FFTSIZE, ANALYSIS_WINDOW_BLACKMAN_HARRIS> blackman_harris_window = {};
+static constexpr AnalysisWindowQ15<FFTSIZE, ANALYSIS_WINDOW_FLAT_TOP> flat_top_window = {};
+static constexpr AnalysisWindowQ15<FFTSIZE, ANALYSIS_WINDOW_RECTANGULAR> rectangular_window = {};
+
+static const int16_t *WindowTable(analysis_window_t window)
+{
+    switch(window)
+    {
+        case ANALYSIS_WINDOW_HANN:
+            return hann_window.values;
+        case ANALYSIS_WINDOW_HAMMING:
+            return hamming_window.values;
+        case ANALYSIS_WINDOW_BLACKMAN_HARRIS:
+            return blackman_harris_window.values;
+        case ANALYSIS_WINDOW_FLAT_TOP:
+            return flat_top_window.values;
+        case ANALYSIS_WINDOW_RECTANGULAR:
+            return rectangular_window.values;
+    }
+    PanicFalse(false);
+    return NULL;
+}
+
+// Window of each test type, see audio_set_test_window(), and the one of the running test
+static analysis_window_t test_windows[NB_TEST_TYPES];
+static analysis_window_t test_window = ANALYSIS_WINDOW;
+
+// The window of the running test, or rectangular_window with the multisine excitation
+static const int16_t *frame_window = WindowTable(ANALYSIS_WINDOW);
+
+// The sweep and the latency measurement need the full spectra
+static inline bool SparseAnalysisActive(void)
+{
+    return (sparse_nb_bins > 0) && !sweep_excitation && !latency_measurement_running;
+}
+
+// Runs the Goertzel filters of the sparse bins over a block. Each is a chain of dependent multiply-adds, so they go
+// four at a time to keep the FPU pipeline busy.
+static void GoertzelBlock(float s1[SPARSE_MAX_BINS], float s2[SPARSE_MAX_BINS], const float x[AUDIO_BLOCK_SAMPLES])
+{
+    int j = 0;
+    for(; (j + 4) <= sparse_nb_bins; j += 4)
+    {
+        const float *coeff = &sparse_coeffs[j];
+        float a1 = s1[j];
+        float a2 = s2[j];
+        float b1 = s1[j + 1];
+        float b2 = s2[j + 1];
+        float c1 = s1[j + 2];
+        float c2 = s2[j + 2];
+        float d1 = s1[j + 3];
+        float d2 = s2[j + 3];
+        for(int i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+        {
+            const float a0 = x[i] + (coeff[0] * a1) - a2;
+            const float b0 = x[i] + (coeff[1] * b1) - b2;
+            const float c0 = x[i] + (coeff[2] * c1) - c2;
+            const float d0 = x[i] + (coeff[3] * d1) - d2;
+            a2 = a1;
+            a1 = a0;
+            b2 = b1;
+            b1 = b0;
+            c2 = c1;
+            c1 = c0;
+            d2 = d1;
+            d1 = d0;
+        }
+        s1[j] = a1;
+        s2[j] = a2;
+        s1[j + 1] = b1;
+        s2[j + 1] = b2;
+        s1[j + 2] = c1;
+        s2[j + 2] = c2;
+        s1[j + 3] = d1;
+        s2[j + 3] = d2;
+    }
+
+    for(; j < sparse_nb_bins; j++)
+    {
+        const float coeff = sparse_coeffs[j];
+        float a1 = s1[j];
+        float a2 = s2[j];
+        for(int i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+        {
+            const float a0 = x[i] + (coeff * a1) - a2;
+            a2 = a1;
+            a1 = a0;
+        }
+        s1[j] = a1;
+        s2[j] = a2;
+    }
+}
+
+// Advances the Goertzel filters of every frame in progress with ring block `block`, block nb_blocks_in_run of the run.
+// Frame k is made of blocks k * FFT_HOP_BLOCKS to k * FFT_HOP_BLOCKS + NB_BLOCKS_IN_FFTSIZE - 1, and each sample is
+// weighted by the window at its position in the frame. So the filters run as the samples come in, and a complete
+// frame only costs the outputs of its filters, see ComputeSparseBins().
+static void UpdateSparseBanks(int block)
+{
+    PROFILE_BEGIN(filters_start);
+
+    const int16_t *const channels[SPARSE_NB_CHANNELS] = {ringOEM_L[block], ringIEM_L[block], ringOEM_R[block],
+                                                          ringIEM_R[block], ringNoise_delayed[block]};
+    // The reference spectrum of the multisine is known, see CopyMultisineSpectrum()
+    const int nb_channels = multisine_excitation ? SPARSE_NOISE : SPARSE_NB_CHANNELS;
+    const uint32_t first_frame = (nb_blocks_in_run < NB_BLOCKS_IN_FFTSIZE)
+                                     ? 0
+                                     : (((nb_blocks_in_run - NB_BLOCKS_IN_FFTSIZE) / FFT_HOP_BLOCKS) + 1);
+    const uint32_t last_frame = nb_blocks_in_run / FFT_HOP_BLOCKS;
+    float x[AUDIO_BLOCK_SAMPLES];
+
+    for(uint32_t frame = first_frame; frame <= last_frame; frame++)
+    {
+        sparse_bank_t *bank = &sparse_banks[frame % SPARSE_NB_BANKS];
+        const int offset = (int)(nb_blocks_in_run - (frame * FFT_HOP_BLOCKS)) * AUDIO_BLOCK_SAMPLES;
+        if(offset == 0)
+        {
+            memset(bank, 0, sizeof(*bank));
+        }
+
+        for(int c = 0; c < nb_channels; c++)
+        {
+            const int16_t *src = channels[c];
+#ifdef FIXED_POINT
+            // The unshifted q2.30 products, the block scaling shift is only known once the frame is complete
+            for(int i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+            {
+                x[i] = (float)(src[i] * frame_window[offset + i]);
+                if(abs(src[i]) > bank->peak[c])
+                {
+                    bank->peak[c] = abs(src[i]);
+                }
+            }
+#else
+            dsp_window_q15_to_float(x, src, &fftWindow[offset], AUDIO_BLOCK_SAMPLES);
+#endif
+
+            GoertzelBlock(bank->s1[c], bank->s2[c], x);
+        }
+    }
+
+    PROFILE_END(PROFILE_STAGE_SPARSE_FILTERS, filters_start);
+}
+
+// The frame the last block completed goes with the frame set about to be published, capture reuses its bank next
+static void SaveSparseFrame(int frame_set)
+{
+    const uint32_t frame = (nb_blocks_in_run - NB_BLOCKS_IN_FFTSIZE) / FFT_HOP_BLOCKS;
+    sparse_frames[frame_set] = sparse_banks[frame % SPARSE_NB_BANKS];
+}
+
+static void ManageQueueBuffers(test_type_t test_type, uint8_t channel)
+{
+    PanicFalse(CaptureBlockIsFree(next_capture_block_number));
+
+#ifdef AUDIO_ZERO_COPY_INGESTION
+    HoldRecordQueue(AudioRecordQueue_OEM_L, heldOEM_L, ringOEM_L, next_capture_block_number);
+    HoldRecordQueue(AudioRecordQueue_IEM_L, heldIEM_L, ringIEM_L, next_capture_block_number);
+    HoldRecordQueue(AudioRecordQueue_OEM_R, heldOEM_R, ringOEM_R, next_capture_block_number);
+    HoldRecordQueue(AudioRecordQueue_IEM_R, heldIEM_R, ringIEM_R, next_capture_block_number);
+#else
+    ReadRecordQueue(AudioRecordQueue_OEM_L, &bOEM_L[next_capture_block_number * AUDIO_BLOCK_SAMPLES]);
+    ReadRecordQueue(AudioRecordQueue_IEM_L, &bIEM_L[next_capture_block_number * AUDIO_BLOCK_SAMPLES]);
+    ReadRecordQueue(AudioRecordQueue_OEM_R, &bOEM_R[next_capture_block_number * AUDIO_BLOCK_SAMPLES]);
+    ReadRecordQueue(AudioRecordQueue_IEM_R, &bIEM_R[next_capture_block_number * AUDIO_BLOCK_SAMPLES]);
+#endif
+    ReadRecordQueue(AudioRecordQueue_SINE, bSine);
+
+#if 0
+    // This code can be used to calculate the delay between noise samples generated and when they are available in the mic inputs
+    static int aa = 0;
+    if(aa < 10)
+    {
+        if(aa == 0)
+            console_write("a = [ ");
+        for(int i=0; i<AUDIO_BLOCK_SAMPLES; i++)
+        {
+            console_write("%d ", ringIEM_L[next_capture_block_number][i]);
+        }
+        if(aa == 9)
+            console_write("];\n");
+        aa++;
+    }
+#endif
+
+    // Output noise to appropriate shield depending on test
+    // We play back the non-delayed noise, and analyze the delayed noise to get sync between REF and MIC FFTs
+    if((test_type == TEST_TYPE_0) || (test_type == TEST_TYPE_1) || (test_type == TEST_TYPE_2B) ||
+       (test_type == TEST_TYPE_SPK))
+    {
+        PlayNoise(AudioPlayQueue_SPK_L, AudioPlayQueue_SPK_R);
+    }
+    else if((test_type == TEST_TYPE_2A) || (test_type == TEST_TYPE_3) || (test_type == TEST_TYPE_CAL))
+    {
+        PlayNoise(AudioPlayQueue_CAL_L, AudioPlayQueue_CAL_R);
+    }
+    else if(test_type == TEST_TYPE_SINE_DEBUG)
+    {
+        switch(channel)
+        {
+            case 0:
+                WritePlayQueue(AudioPlayQueue_SPK_L, bSine);
+                break;
+            case 1:
+                WritePlayQueue(AudioPlayQueue_SPK_R, bSine);
+                break;
+            case 2:
+                WritePlayQueue(AudioPlayQueue_CAL_L, bSine);
+                break;
+            case 3:
+                WritePlayQueue(AudioPlayQueue_CAL_R, bSine);
                 break;
             default:
                 break;
@@ -278,120 +1419,1189 @@ static void ManageQueueBuffers(test_type_t test_type, uint8_t channel)
         Panic();
     }
 
-    next_fft_block_number = (next_fft_block_number + 1) % NB_BLOCKS_IN_FFTSIZE;
-    if(next_fft_block_number == 0) //only after wrap-around
+    PROFILE_BEGIN(pink_noise_delayed_start);
+    if(sweep_excitation)
+    {
+        sweep_get(&bNoise_delayed[next_capture_block_number * AUDIO_BLOCK_SAMPLES],
+                  excitation_next_sample - playback_to_mic_delay);
+        excitation_next_sample += AUDIO_BLOCK_SAMPLES;
+    }
+    else if(multisine_excitation)
+    {
+        multisine_get(&bNoise_delayed[next_capture_block_number * AUDIO_BLOCK_SAMPLES],
+                      excitation_next_sample - playback_to_mic_delay);
+        excitation_next_sample += AUDIO_BLOCK_SAMPLES;
+    }
+    else
+    {
+        pink_noise_get_delayed(&bNoise_delayed[next_capture_block_number * AUDIO_BLOCK_SAMPLES],
+                               playback_to_mic_delay);
+    }
+    PROFILE_END(PROFILE_STAGE_PINK_NOISE_DELAYED, pink_noise_delayed_start);
+
+    if(capture_streaming_enabled)
+    {
+        StreamCaptureBlock(test_type, next_capture_block_number);
+    }
+
+    if(SparseAnalysisActive())
+    {
+        UpdateSparseBanks(next_capture_block_number);
+    }
+
+    next_capture_block_number = (next_capture_block_number + 1) % CAPTURE_RING_BLOCKS;
+    if(nb_blocks_captured < NB_BLOCKS_IN_FFTSIZE)
+    {
+        nb_blocks_captured++;
+    }
+    nb_blocks_since_last_fft++;
+    nb_blocks_in_run++;
+
+    // Only once the ring holds a full frame, then every hop. The frame is made of the last NB_BLOCKS_IN_FFTSIZE blocks.
+    if((nb_blocks_captured == NB_BLOCKS_IN_FFTSIZE) && (nb_blocks_since_last_fft >= FFT_HOP_BLOCKS))
+    {
+        if(SparseAnalysisActive())
+        {
+            SaveSparseFrame(frame_set_capture_index);
+        }
+        PublishFrameSet((next_capture_block_number - NB_BLOCKS_IN_FFTSIZE + CAPTURE_RING_BLOCKS) % CAPTURE_RING_BLOCKS);
+        nb_blocks_since_last_fft = 0;
+    }
+}
+
+#ifdef FIXED_POINT
+// Left shift that brings a sample of magnitude max_abs close to full scale
+static int peak_scaling_shift(int max_abs)
+{
+    int shift = 0;
+    while((shift < 15) && ((max_abs << (shift + 1)) <= INT16_MAX))
+    {
+        shift++;
+    }
+
+    return shift;
+}
+
+// Left shift that brings the largest sample of the buffer close to full scale, so the fixed-point FFT, which scales
+// down at every stage, keeps as many significant bits as possible
+static int block_scaling_shift(const int16_t *const src_ring[CAPTURE_RING_BLOCKS], int start_block)
+{
+    PanicFalse(src_ring != NULL);
+    PanicFalse(start_block < CAPTURE_RING_BLOCKS);
+
+    int max_abs = 0;
+    for(int b = 0; b < NB_BLOCKS_IN_FFTSIZE; b++)
+    {
+        const int16_t *src_block = src_ring[(start_block + b) % CAPTURE_RING_BLOCKS];
+        for(int i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+        {
+            const int a = abs(src_block[i]);
+            if(a > max_abs)
+            {
+                max_abs = a;
+            }
+        }
+    }
+
+    return peak_scaling_shift(max_abs);
+}
+
+// q1.15 sample times q1.15 window is q2.30, brought to the kiss_fft_scalar format (q1.31 or q1.15)
+static inline kiss_fft_scalar window_sample_q(int16_t sample, int shift, int16_t window)
+{
+    const int32_t product = (sample * (1 << shift)) * window;
+#if(FIXED_POINT == 32)
+    return (kiss_fft_scalar)(product * 2);
+#else
+    return (kiss_fft_scalar)(product >> 15);
+#endif
+}
+
+// src_ring is the capture ring, the frame starts at block start_block and wraps around
+static void copy_window_to_kiss_fft_buffer_q(kiss_fft_scalar dest_buf[FFTSIZE],
+                                             const int16_t *const src_ring[CAPTURE_RING_BLOCKS], int start_block,
+                                             int shift, const int16_t window[FFTSIZE])
+{
+    PanicFalse(dest_buf != NULL);
+    PanicFalse(src_ring != NULL);
+    PanicFalse(start_block < CAPTURE_RING_BLOCKS);
+    PanicFalse(window != NULL);
+
+    for(int b = 0; b < NB_BLOCKS_IN_FFTSIZE; b++)
     {
-        fft_data_available = true;
+        const int16_t *src_block = src_ring[(start_block + b) % CAPTURE_RING_BLOCKS];
+        const int offset = b * AUDIO_BLOCK_SAMPLES;
+        for(int i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+        {
+            dest_buf[offset + i] = window_sample_q(src_block[i], shift, window[offset + i]);
+        }
     }
 }
 
+// Power of a bin brought back to the common (unshifted) scale of the accumulators
+static inline tf_accum_t fixed_point_power(const kiss_fft_cpx c, int shift)
+{
+    const uint64_t power = (uint64_t)((int64_t)c.r * c.r) + (uint64_t)((int64_t)c.i * c.i);
+#if(FIXED_POINT == 32)
+    // q1.31 powers are below 2^63
+    return power >> ((63 - TF_ACCUM_POWER_BITS) + 2 * shift);
+#else
+    // q1.15 powers are below 2^31, keep the bits left as precision
+    return (power << (TF_ACCUM_POWER_BITS - 31)) >> (2 * shift);
+#endif
+}
+#else
 // To map q1.15 to [-1, 1)
 const float Q_SCALING_FACTOR = 1.0f / 32768.0f;
 
-extern const int16_t AudioWindowHamming1024[];
-static void apply_window_to_fft_buffer(kiss_fft_scalar buf[FFTSIZE], const int16_t window[FFTSIZE])
+static void init_float_window(float dest[FFTSIZE], const int16_t window[FFTSIZE])
+{
+    for(int i = 0; i < FFTSIZE; i++)
+    {
+        dest[i] = (window[i] * Q_SCALING_FACTOR) * Q_SCALING_FACTOR;
+    }
+}
+
+// kiss_fft_scalar is a float in our configuration
+// src_ring is the capture ring, the frame starts at block start_block and wraps around
+static void copy_window_to_kiss_fft_buffer(kiss_fft_scalar dest_buf[FFTSIZE],
+                                           const int16_t *const src_ring[CAPTURE_RING_BLOCKS], int start_block)
+{
+    PanicFalse(dest_buf != NULL);
+    PanicFalse(src_ring != NULL);
+    PanicFalse(start_block < CAPTURE_RING_BLOCKS);
+
+    for(int b = 0; b < NB_BLOCKS_IN_FFTSIZE; b++)
+    {
+        const int offset = b * AUDIO_BLOCK_SAMPLES;
+        dsp_window_q15_to_float(&dest_buf[offset], src_ring[(start_block + b) % CAPTURE_RING_BLOCKS],
+                                &fftWindow[offset], AUDIO_BLOCK_SAMPLES);
+    }
+}
+#endif
+
+// Power of a bin, as a float on the scale of the accumulators
+static inline float cpx_power(const kiss_fft_cpx c, int shift)
+{
+#ifdef FIXED_POINT
+    return (float)fixed_point_power(c, shift);
+#else
+    (void)shift;
+    return c.r * c.r + c.i * c.i;
+#endif
+}
+
+static void FFTEngineInitialise(fft_engine_t *engine, int inverse_fft)
+{
+    PanicFalse(engine != NULL);
+
+    // Ask kiss fft how much memory the plan needs, then build it in place in the static storage
+    size_t mem_needed = 0;
+    kiss_fftr_alloc(FFTSIZE, inverse_fft, NULL, &mem_needed);
+    PanicFalse(mem_needed <= sizeof(engine->mem));
+
+    size_t mem_available = sizeof(engine->mem);
+    engine->cfg = kiss_fftr_alloc(FFTSIZE, inverse_fft, engine->mem, &mem_available);
+    PanicFalse(engine->cfg != NULL);
+}
+
+static void FFTEngineForward(const fft_engine_t *engine, const kiss_fft_scalar in_buf[FFTSIZE],
+                             kiss_fft_cpx out_buf[KISS_FFT_OUT_SIZE])
+{
+    PanicFalse(engine->cfg != NULL);
+
+    kiss_fftr(engine->cfg, in_buf, out_buf);
+}
+
+#ifdef FFT_PAIRED_CHANNELS
+static void FFTPairEngineInitialise(fft_pair_engine_t *engine)
 {
-    PanicFalse(buf != NULL);
+    PanicFalse(engine != NULL);
+
+    size_t mem_needed = 0;
+    kiss_fft_alloc(FFTSIZE, 0, NULL, &mem_needed);
+    PanicFalse(mem_needed <= sizeof(engine->mem));
+
+    size_t mem_available = sizeof(engine->mem);
+    engine->cfg = kiss_fft_alloc(FFTSIZE, 0, engine->mem, &mem_available);
+    PanicFalse(engine->cfg != NULL);
+}
+
+// Windowed copy of two real channels into the real and imaginary parts of one complex buffer
+static void copy_pair_to_kiss_fft_buffer(kiss_fft_cpx dest_buf[FFTSIZE],
+                                         const int16_t *const src_ring_re[CAPTURE_RING_BLOCKS],
+                                         const int16_t *const src_ring_im[CAPTURE_RING_BLOCKS], int start_block,
+                                         int shift, const int16_t window[FFTSIZE])
+{
+    PanicFalse(dest_buf != NULL);
+    PanicFalse(src_ring_re != NULL);
+    PanicFalse(src_ring_im != NULL);
+    PanicFalse(start_block < CAPTURE_RING_BLOCKS);
     PanicFalse(window != NULL);
 
-    for(int i = 0; i < FFTSIZE; i++)
+    for(int b = 0; b < NB_BLOCKS_IN_FFTSIZE; b++)
+    {
+        const int16_t *src_block_re = src_ring_re[(start_block + b) % CAPTURE_RING_BLOCKS];
+        const int16_t *src_block_im = src_ring_im[(start_block + b) % CAPTURE_RING_BLOCKS];
+        const int offset = b * AUDIO_BLOCK_SAMPLES;
+#ifdef FIXED_POINT
+        for(int i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+        {
+            dest_buf[offset + i].r = window_sample_q(src_block_re[i], shift, window[offset + i]);
+            dest_buf[offset + i].i = window_sample_q(src_block_im[i], shift, window[offset + i]);
+        }
+#else
+        (void)shift;
+        (void)window; //fftWindow is the float version of it
+        dsp_window_pair_q15_to_cpx(&dest_buf[offset], src_block_re, src_block_im, &fftWindow[offset],
+                                   AUDIO_BLOCK_SAMPLES);
+#endif
+    }
+}
+
+#ifdef FIXED_POINT
+#define FFT_HALF_SUM(a, b) ((kiss_fft_scalar)(((int64_t)(a) + (b)) >> 1))
+#define FFT_HALF_DIFF(a, b) ((kiss_fft_scalar)(((int64_t)(a) - (b)) >> 1))
+#else
+#define FFT_HALF_SUM(a, b) (0.5f * ((a) + (b)))
+#define FFT_HALF_DIFF(a, b) (0.5f * ((a) - (b)))
+#endif
+
+// With z = a + jb, Z = FFT(z): A[k] = (Z[k] + conj(Z[N-k])) / 2 and B[k] = (Z[k] - conj(Z[N-k])) / 2j
+// Fixed-point kiss fft scales both the complex and the real transforms by 1/N, so this holds in fixed point too.
+static void split_pair_fft_buffer(kiss_fft_cpx fft_a_dest[KISS_FFT_OUT_SIZE],
+                                  kiss_fft_cpx fft_b_dest[KISS_FFT_OUT_SIZE], const kiss_fft_cpx fft_pair_src[FFTSIZE])
+{
+    PanicFalse(fft_a_dest != NULL);
+    PanicFalse(fft_b_dest != NULL);
+    PanicFalse(fft_pair_src != NULL);
+
+    for(int k = 0; k < KISS_FFT_OUT_SIZE; k++)
+    {
+        const kiss_fft_cpx z = fft_pair_src[k];
+        const kiss_fft_cpx zm = fft_pair_src[(FFTSIZE - k) % FFTSIZE];
+
+        fft_a_dest[k].r = FFT_HALF_SUM(z.r, zm.r);
+        fft_a_dest[k].i = FFT_HALF_DIFF(z.i, zm.i);
+        fft_b_dest[k].r = FFT_HALF_SUM(z.i, zm.i);
+        fft_b_dest[k].i = FFT_HALF_DIFF(zm.r, z.r);
+    }
+}
+
+// Returns the block scaling shift, common to both channels
+static int ComputeFFTPair(kiss_fft_cpx fft_a_dest[KISS_FFT_OUT_SIZE], kiss_fft_cpx fft_b_dest[KISS_FFT_OUT_SIZE],
+                          const int16_t *const ring_a_src[CAPTURE_RING_BLOCKS],
+                          const int16_t *const ring_b_src[CAPTURE_RING_BLOCKS], int start_block)
+{
+    PanicFalse(fft_pair_engine.cfg != NULL);
+
+#ifdef FIXED_POINT
+    const int shift_a = block_scaling_shift(ring_a_src, start_block);
+    const int shift_b = block_scaling_shift(ring_b_src, start_block);
+    const int shift = (shift_a < shift_b) ? shift_a : shift_b;
+#else
+    const int shift = 0;
+#endif
+
+    copy_pair_to_kiss_fft_buffer(fftPairIn, ring_a_src, ring_b_src, start_block, shift, frame_window);
+    kiss_fft(fft_pair_engine.cfg, fftPairIn, fftPairOut);
+    split_pair_fft_buffer(fft_a_dest, fft_b_dest, fftPairOut);
+
+    return shift;
+}
+#endif
+
+// Returns the block scaling shift
+static int ComputeFFT(kiss_fft_cpx fft_buf_dest[KISS_FFT_OUT_SIZE], const int16_t *const ring_src[CAPTURE_RING_BLOCKS],
+                      int start_block)
+{
+    PanicFalse(fft_buf_dest != NULL);
+    PanicFalse(ring_src != NULL);
+
+#ifdef FIXED_POINT
+    const int shift = block_scaling_shift(ring_src, start_block);
+    copy_window_to_kiss_fft_buffer_q(fftIn, ring_src, start_block, shift, frame_window);
+#else
+    const int shift = 0;
+    copy_window_to_kiss_fft_buffer(fftIn, ring_src, start_block);
+#endif
+
+    FFTEngineForward(&fft_engine, fftIn, fft_buf_dest);
+
+    return shift;
+}
+
+// The reference of the periodic excitation needs no transform: every frame holds one whole period, circularly
+// shifted, which only changes the phases. The tests only use powers of the reference.
+static int CopyMultisineSpectrum(void)
+{
+    memcpy(fftNoise_delayed, multisine_spectrum, sizeof(multisine_spectrum));
+    return multisine_spectrum_shift;
+}
+
+// The multisine is analysed with the rectangular window, anything else with the window of the running test
+static void SetMultisineExcitation(bool enable)
+{
+    multisine_excitation = enable;
+    frame_window = WindowTable(enable ? ANALYSIS_WINDOW_RECTANGULAR : test_window);
+#ifndef FIXED_POINT
+    init_float_window(fftWindow, frame_window);
+#endif
+}
+
+// The analysis of a frame set is split in steps of about one transform each, so capture can be serviced in between
+typedef enum
+{
+#ifdef FFT_PAIRED_CHANNELS
+    ANALYSIS_STEP_FFT_L,
+    ANALYSIS_STEP_FFT_R,
+#else
+    ANALYSIS_STEP_FFT_OEM_L,
+    ANALYSIS_STEP_FFT_IEM_L,
+    ANALYSIS_STEP_FFT_OEM_R,
+    ANALYSIS_STEP_FFT_IEM_R,
+#endif
+    ANALYSIS_STEP_FFT_NOISE,
+    ANALYSIS_STEP_ACCUMULATE,
+    NB_ANALYSIS_STEPS,
+} analysis_step_t;
+
+static void ComputeFFTStep(analysis_step_t step, int start_block)
+{
+    PROFILE_BEGIN(fft_start);
+
+    switch(step)
     {
-        buf[i] *= (window[i] * Q_SCALING_FACTOR);
+#ifdef FFT_PAIRED_CHANNELS
+        case ANALYSIS_STEP_FFT_L:
+            fftOEM_L_shift = ComputeFFTPair(fftOEM_L, fftIEM_L, ringOEM_L, ringIEM_L, start_block);
+            fftIEM_L_shift = fftOEM_L_shift;
+            break;
+        case ANALYSIS_STEP_FFT_R:
+            fftOEM_R_shift = ComputeFFTPair(fftOEM_R, fftIEM_R, ringOEM_R, ringIEM_R, start_block);
+            fftIEM_R_shift = fftOEM_R_shift;
+            break;
+#else
+        case ANALYSIS_STEP_FFT_OEM_L:
+            fftOEM_L_shift = ComputeFFT(fftOEM_L, ringOEM_L, start_block);
+            break;
+        case ANALYSIS_STEP_FFT_IEM_L:
+            fftIEM_L_shift = ComputeFFT(fftIEM_L, ringIEM_L, start_block);
+            break;
+        case ANALYSIS_STEP_FFT_OEM_R:
+            fftOEM_R_shift = ComputeFFT(fftOEM_R, ringOEM_R, start_block);
+            break;
+        case ANALYSIS_STEP_FFT_IEM_R:
+            fftIEM_R_shift = ComputeFFT(fftIEM_R, ringIEM_R, start_block);
+            break;
+#endif
+        case ANALYSIS_STEP_FFT_NOISE:
+            fftNoise_delayed_shift = multisine_excitation
+                                         ? CopyMultisineSpectrum()
+                                         : ComputeFFT(fftNoise_delayed, ringNoise_delayed, start_block);
+            break;
+        default:
+            Panic();
+            break;
+    }
+
+    PROFILE_END(PROFILE_STAGE_FFT, fft_start);
+}
+
+// Same window, scaling and output units as ComputeFFT, for the sparse bins only, from the filters of a complete frame.
+// Returns the block scaling shift.
+static int ComputeSparseBins(kiss_fft_cpx fft_buf_dest[KISS_FFT_OUT_SIZE], const sparse_bank_t *frame,
+                             sparse_channel_t channel)
+{
+    PanicFalse(fft_buf_dest != NULL);
+    PanicFalse(frame != NULL);
+
+#ifdef FIXED_POINT
+    // The filters ran on the unshifted q2.30 products: shifted and brought to the kiss_fft_scalar format as
+    // window_sample_q() does, then scaled by 1/FFTSIZE as kiss fft does
+    const int shift = peak_scaling_shift(frame->peak[channel]);
+#if(FIXED_POINT == 32)
+    const float output_scale = ldexpf(1.0f, shift + 1) / FFTSIZE;
+#else
+    const float output_scale = ldexpf(1.0f, shift - 15) / FFTSIZE;
+#endif
+#else
+    const int shift = 0;
+    const float output_scale = 1.0f;
+#endif
+
+    for(int j = 0; j < sparse_nb_bins; j++)
+    {
+        const float s1 = frame->s1[channel][j];
+        const float s2 = frame->s2[channel][j];
+
+        // X[k] up to a phase factor, only its power is used
+        kiss_fft_cpx *dest = &fft_buf_dest[sparse_bins[j]];
+        dest->r = (kiss_fft_scalar)(output_scale * ((0.5f * sparse_coeffs[j] * s1) - s2));
+        dest->i = (kiss_fft_scalar)(output_scale * (sparse_sines[j] * s1));
+    }
+
+    return shift;
+}
+
+static void ComputeSparseStep(analysis_step_t step, const sparse_bank_t *frame)
+{
+    PROFILE_BEGIN(fft_start);
+
+    switch(step)
+    {
+#ifdef FFT_PAIRED_CHANNELS
+        case ANALYSIS_STEP_FFT_L:
+            fftOEM_L_shift = ComputeSparseBins(fftOEM_L, frame, SPARSE_OEM_L);
+            fftIEM_L_shift = ComputeSparseBins(fftIEM_L, frame, SPARSE_IEM_L);
+            break;
+        case ANALYSIS_STEP_FFT_R:
+            fftOEM_R_shift = ComputeSparseBins(fftOEM_R, frame, SPARSE_OEM_R);
+            fftIEM_R_shift = ComputeSparseBins(fftIEM_R, frame, SPARSE_IEM_R);
+            break;
+#else
+        case ANALYSIS_STEP_FFT_OEM_L:
+            fftOEM_L_shift = ComputeSparseBins(fftOEM_L, frame, SPARSE_OEM_L);
+            break;
+        case ANALYSIS_STEP_FFT_IEM_L:
+            fftIEM_L_shift = ComputeSparseBins(fftIEM_L, frame, SPARSE_IEM_L);
+            break;
+        case ANALYSIS_STEP_FFT_OEM_R:
+            fftOEM_R_shift = ComputeSparseBins(fftOEM_R, frame, SPARSE_OEM_R);
+            break;
+        case ANALYSIS_STEP_FFT_IEM_R:
+            fftIEM_R_shift = ComputeSparseBins(fftIEM_R, frame, SPARSE_IEM_R);
+            break;
+#endif
+        case ANALYSIS_STEP_FFT_NOISE:
+            fftNoise_delayed_shift = multisine_excitation
+                                         ? CopyMultisineSpectrum()
+                                         : ComputeSparseBins(fftNoise_delayed, frame, SPARSE_NOISE);
+            break;
+        default:
+            Panic();
+            break;
+    }
+
+    PROFILE_END(PROFILE_STAGE_FFT, fft_start);
+}
+
+// One pass over the bins for all the curves: the reference log is shared, and 10 * log10(yy / xx) becomes a difference
+// of fast logs. Same results as energy2dB(yy / xx) to within 1e-4 dB.
+static void FillTFCache(void)
+{
+    const tf_accum_t *cumul[8] = {MOEMLSquaredCumul,      MOEMRSquaredCumul,      MIEMLSquaredCumul,
+                                  MIEMRSquaredCumul,      Band2FOEMLSquaredCumul, Band2FOEMRSquaredCumul,
+                                  Band2FIEMLSquaredCumul, Band2FIEMRSquaredCumul};
+    const int nb_curves = sweep_excitation ? 8 : 4;
+    const float log2_to_db = 3.01029996f; //10 * log10(2)
+
+    for(int bin = 0; bin < (FFTSIZE / 2); bin++)
+    {
+        const float xx = (float)NoiseSquaredCumul[bin];
+        const float log2_xx = (xx > 0.0f) ? fast_log2f(xx) : 0.0f;
+
+        for(int curve = 0; curve < nb_curves; curve++)
+        {
+            const float yy = (float)cumul[curve][bin];
+            if((xx > 0.0f) && (yy > 0.0f))
+            {
+                tf_cache[curve][bin] = log2_to_db * (fast_log2f(yy) - log2_xx);
+            }
+            else
+            {
+                tf_cache[curve][bin] = TF_NO_DATA_DB;
+            }
+        }
+    }
+
+    tf_cache_valid = true;
+}
+
+static void ComputeAccumulateFFT(tf_accum_t squared_cumul[FFTSIZE / 2],
+                                 const kiss_fft_cpx fft_buf_src[KISS_FFT_OUT_SIZE], int shift)
+{
+    PanicFalse(squared_cumul != NULL);
+    PanicFalse(fft_buf_src != NULL);
+
+#ifdef FIXED_POINT
+    for(int i = 0; i < (FFTSIZE / 2); i++)
+    {
+        squared_cumul[i] += fixed_point_power(fft_buf_src[i], shift);
+    }
+#else
+    (void)shift;
+    dsp_accumulate_power(squared_cumul, fft_buf_src, FFTSIZE / 2);
+#endif
+}
+
+static void ComputeAccumulateFFTs(void)
+{
+    ComputeAccumulateFFT(NoiseSquaredCumul, fftNoise_delayed, fftNoise_delayed_shift);
+    ComputeAccumulateFFT(MOEMLSquaredCumul, fftOEM_L, fftOEM_L_shift);
+    ComputeAccumulateFFT(MIEMLSquaredCumul, fftIEM_L, fftIEM_L_shift);
+    ComputeAccumulateFFT(MOEMRSquaredCumul, fftOEM_R, fftOEM_R_shift);
+    ComputeAccumulateFFT(MIEMRSquaredCumul, fftIEM_R, fftIEM_R_shift);
+}
+
+static inline tf_accum_t accum_power(const kiss_fft_cpx c, int shift)
+{
+#ifdef FIXED_POINT
+    return fixed_point_power(c, shift);
+#else
+    (void)shift;
+    return c.r * c.r + c.i * c.i;
+#endif
+}
+
+static void ComputeAccumulateSparseBins(void)
+{
+    for(int j = 0; j < sparse_nb_bins; j++)
+    {
+        const int bin = sparse_bins[j];
+        NoiseSquaredCumul[bin] += accum_power(fftNoise_delayed[bin], fftNoise_delayed_shift);
+        MOEMLSquaredCumul[bin] += accum_power(fftOEM_L[bin], fftOEM_L_shift);
+        MIEMLSquaredCumul[bin] += accum_power(fftIEM_L[bin], fftIEM_L_shift);
+        MOEMRSquaredCumul[bin] += accum_power(fftOEM_R[bin], fftOEM_R_shift);
+        MIEMRSquaredCumul[bin] += accum_power(fftIEM_R[bin], fftIEM_R_shift);
+    }
+}
+
+// Sweep frames only excite a few bins, and only those are accumulated. A mic harmonic lands on bins the reference does
+// not excite in that frame, so it stays out of the transfer functions. The mic power over the bins the second harmonic
+// sweeps through is accumulated in the 2f band curves instead. It is not a deconvolved H2 response: there is no inverse
+// sweep and no window on harmonic impulse responses, so the band also holds whatever noise and other harmonics fall in
+// it, and reads the second harmonic distortion only when that dominates.
+static void ComputeAccumulateSweepFFTs(void)
+{
+    // Same order as the curve ids of audio_get_headset_tf
+    const kiss_fft_cpx *fft_mics[4] = {fftOEM_L, fftOEM_R, fftIEM_L, fftIEM_R};
+    const int fft_mics_shift[4] = {fftOEM_L_shift, fftOEM_R_shift, fftIEM_L_shift, fftIEM_R_shift};
+    tf_accum_t *cumul[4] = {MOEMLSquaredCumul, MOEMRSquaredCumul, MIEMLSquaredCumul, MIEMRSquaredCumul};
+    tf_accum_t *band2f_cumul[4] = {Band2FOEMLSquaredCumul, Band2FOEMRSquaredCumul, Band2FIEMLSquaredCumul,
+                                   Band2FIEMRSquaredCumul};
+
+    float max_power = 0.0f;
+    for(int k = 0; k < (FFTSIZE / 2); k++)
+    {
+        const float power = cpx_power(fftNoise_delayed[k], fftNoise_delayed_shift);
+        if(power > max_power)
+        {
+            max_power = power;
+        }
+    }
+    if(max_power <= 0.0f)
+    {
+        return;
+    }
+
+    const float gate = max_power * dB2energy(-SWEEP_GATE_DB);
+    for(int k = 0; k < (FFTSIZE / 2); k++)
+    {
+        if(cpx_power(fftNoise_delayed[k], fftNoise_delayed_shift) < gate)
+        {
+            continue;
+        }
+
+        NoiseSquaredCumul[k] += accum_power(fftNoise_delayed[k], fftNoise_delayed_shift);
+        for(int curve = 0; curve < 4; curve++)
+        {
+            cumul[curve][k] += accum_power(fft_mics[curve][k], fft_mics_shift[curve]);
+            // The harmonic sweeps twice as fast, over bins 2k and 2k+1 while the fundamental is in bin k
+            if(((2 * k) + 1) < (FFTSIZE / 2))
+            {
+                band2f_cumul[curve][k] += accum_power(fft_mics[curve][2 * k], fft_mics_shift[curve]) +
+                                      accum_power(fft_mics[curve][(2 * k) + 1], fft_mics_shift[curve]);
+            }
+        }
+    }
+}
+
+// Bin value in float, on the same scale whatever the block scaling of the frame
+static inline void cpx_to_float(const kiss_fft_cpx c, int shift, float *re, float *im)
+{
+    *re = ldexpf((float)c.r, -shift);
+    *im = ldexpf((float)c.i, -shift);
+}
+
+static void AccumulateCrossSpectra(void)
+{
+    // Same order as the curve ids of audio_get_headset_tf
+    const kiss_fft_cpx *fft_mics[4] = {fftOEM_L, fftOEM_R, fftIEM_L, fftIEM_R};
+    const int fft_mics_shift[4] = {fftOEM_L_shift, fftOEM_R_shift, fftIEM_L_shift, fftIEM_R_shift};
+
+    for(int k = 0; k < KISS_FFT_OUT_SIZE; k++)
+    {
+        float xr, xi;
+        cpx_to_float(fftNoise_delayed[k], fftNoise_delayed_shift, &xr, &xi);
+
+        for(int curve = 0; curve < 4; curve++)
+        {
+            float yr, yi;
+            cpx_to_float(fft_mics[curve][k], fft_mics_shift[curve], &yr, &yi);
+
+            // conj(X) * Y
+            latency_cross_re[curve][k] += (xr * yr) + (xi * yi);
+            latency_cross_im[curve][k] += (xr * yi) - (xi * yr);
+        }
+    }
+}
+
+// GCC-PHAT: the cross spectrum whitened to unit magnitude transforms back to a peak at the delay of the mic relative to
+// the reference. Returns false when the peak does not stand out of the correlation floor.
+static bool EstimateMicDelay(int curve, int *residual_delay)
+{
+    PanicFalse(curve < 4);
+    PanicFalse(residual_delay != NULL);
+
+#ifdef FIXED_POINT
+    const float phat_scale = (float)(1UL << (FIXED_POINT - 3)); //headroom for the first butterflies of kiss_fftri
+#else
+    const float phat_scale = 1.0f;
+#endif
+
+    // The analysis is idle between bursts, its output buffers serve as scratch
+    kiss_fft_cpx *weighted = fftOEM_L;
+    for(int k = 0; k < KISS_FFT_OUT_SIZE; k++)
+    {
+        const float re = latency_cross_re[curve][k];
+        const float im = latency_cross_im[curve][k];
+        const float mag = sqrtf((re * re) + (im * im));
+
+        if((k == 0) || (k == (KISS_FFT_OUT_SIZE - 1)) || (mag <= 0.0f))
+        {
+            weighted[k].r = 0;
+            weighted[k].i = 0;
+        }
+        else
+        {
+            weighted[k].r = (kiss_fft_scalar)(phat_scale * re / mag);
+            weighted[k].i = (kiss_fft_scalar)(phat_scale * im / mag);
+        }
+    }
+
+    kiss_fftri(fft_inverse_engine.cfg, weighted, fftIn);
+
+    int peak_index = 0;
+    float peak = 0.0f;
+    float sum_abs = 0.0f;
+    for(int n = 0; n < FFTSIZE; n++)
+    {
+        const float v = (float)fftIn[n];
+        sum_abs += fabsf(v);
+        if(v > peak)
+        {
+            peak = v;
+            peak_index = n;
+        }
+    }
+
+    const float mean_abs = sum_abs / FFTSIZE;
+    if((mean_abs <= 0.0f) || (peak < (LATENCY_MIN_PEAK_RATIO * mean_abs)))
+    {
+        return false;
+    }
+
+    *residual_delay = (peak_index < (FFTSIZE / 2)) ? peak_index : (peak_index - FFTSIZE);
+    return true;
+}
+
+static void ResetAccumulateBuffer(tf_accum_t buf[FFTSIZE / 2])
+{
+    memset(buf, 0, (FFTSIZE / 2) * sizeof(tf_accum_t));
+}
+
+static void ResetConvergenceStats(void)
+{
+    memset(convergence_stats, 0, sizeof(convergence_stats));
+    convergence_nb_frames = 0;
+}
+
+static void ResetAccumulateBuffers(void)
+{
+    ResetAccumulateBuffer(NoiseSquaredCumul);
+    ResetAccumulateBuffer(MOEMLSquaredCumul);
+    ResetAccumulateBuffer(MIEMLSquaredCumul);
+    ResetAccumulateBuffer(MOEMRSquaredCumul);
+    ResetAccumulateBuffer(MIEMRSquaredCumul);
+    ResetAccumulateBuffer(Band2FOEMLSquaredCumul);
+    ResetAccumulateBuffer(Band2FIEMLSquaredCumul);
+    ResetAccumulateBuffer(Band2FOEMRSquaredCumul);
+    ResetAccumulateBuffer(Band2FIEMRSquaredCumul);
+    tf_cache_valid = false;
+
+    ResetConvergenceStats();
+}
+
+static void ArenaEnterPhase(arena_phase_t phase)
+{
+    if(phase == arena_phase)
+    {
+        return;
+    }
+
+    if(phase == ARENA_PHASE_RESULTS)
+    {
+        // The TF cache overwrites the capture ring
+        PanicFalse(!audio_chain_running);
+        PanicFalse(arena_phase == ARENA_PHASE_TEST);
+    }
+
+    const arena_phase_t previous_phase = arena_phase;
+    arena_phase = phase;
+    PROFILE_ARENA_PHASE_CHANGE();
+
+    if(previous_phase == ARENA_PHASE_RESULTS)
+    {
+        tf_cache_valid = false;
+    }
+    else if(previous_phase == ARENA_PHASE_LATENCY)
+    {
+        ResetAccumulateBuffers(); //the cross spectra overwrote them
+    }
+
+    if(phase == ARENA_PHASE_LATENCY)
+    {
+        memset(&arena_accum_or_latency.latency, 0, sizeof(arena_accum_or_latency.latency));
+    }
+}
+
+static void UpdateTFCache(void)
+{
+    if(!tf_cache_valid)
+    {
+        PROFILE_BEGIN(get_tf_start);
+        ArenaEnterPhase(ARENA_PHASE_RESULTS);
+        FillTFCache();
+        PROFILE_END(PROFILE_STAGE_GET_TF, get_tf_start);
+    }
+}
+
+static void UpdateConvergenceStats(void)
+{
+    // Same order as the curve ids of audio_get_headset_tf
+    const kiss_fft_cpx *fft_mics[4] = {fftOEM_L, fftOEM_R, fftIEM_L, fftIEM_R};
+    const int fft_mics_shift[4] = {fftOEM_L_shift, fftOEM_R_shift, fftIEM_L_shift, fftIEM_R_shift};
+
+    convergence_nb_frames++;
+
+    for(int curve = 0; curve < 4; curve++)
+    {
+        convergence_stats_t *stats = &convergence_stats[curve];
+
+        for(int j = 0; j < CONVERGENCE_BAND_NB_BINS; j++)
+        {
+            const float xx = cpx_power(fftNoise_delayed[CONVERGENCE_BAND_FIRST_BIN + j], fftNoise_delayed_shift);
+            const float yy = cpx_power(fft_mics[curve][CONVERGENCE_BAND_FIRST_BIN + j], fft_mics_shift[curve]);
+
+            // Offset keeps a silent bin finite instead of poisoning its statistics
+            const float tf_db = energy2dB((yy + 1e-20f) / (xx + 1e-20f));
+
+            const float delta = tf_db - stats->mean[j];
+            stats->mean[j] += delta / convergence_nb_frames;
+            stats->m2[j] += delta * (tf_db - stats->mean[j]);
+        }
+    }
+}
+
+// Curves a test is judged on, as a bit mask of curve ids
+static unsigned ConvergenceCurveMask(test_type_t test_type)
+{
+    switch(test_type)
+    {
+        case TEST_TYPE_0:
+            return (1 << 0) | (1 << 1);
+        case TEST_TYPE_1:
+        case TEST_TYPE_2B:
+            return (1 << 2) | (1 << 3);
+        case TEST_TYPE_2A:
+        case TEST_TYPE_3:
+        case TEST_TYPE_SPK:
+        case TEST_TYPE_CAL:
+            return 0x0F;
+        default:
+            return 0;
+    }
+}
+
+static void ResetTFSnapshot(void)
+{
+    memset(tf_snapshot.ema_xx, 0, sizeof(tf_snapshot.ema_xx));
+    memset(tf_snapshot.ema_yy, 0, sizeof(tf_snapshot.ema_yy));
+    tf_snapshot.next_line = -1;
+    tf_snapshot.bins_sent = false;
+    tf_snapshot.nb_skipped = 0;
+}
+
+static void UpdateTFSnapshotAverages(void)
+{
+    // Same order as the curve ids of audio_get_headset_tf
+    const kiss_fft_cpx *fft_mics[4] = {fftOEM_L, fftOEM_R, fftIEM_L, fftIEM_R};
+    const int fft_mics_shift[4] = {fftOEM_L_shift, fftOEM_R_shift, fftIEM_L_shift, fftIEM_R_shift};
+    const float alpha = (convergence_nb_frames <= 1) ? 1.0f : TF_SNAPSHOT_EMA_ALPHA;
+
+    for(int p = 0; p < tf_snapshot.nb_points; p++)
+    {
+        const int bin = tf_snapshot.bins[p];
+        const float xx = cpx_power(fftNoise_delayed[bin], fftNoise_delayed_shift);
+        tf_snapshot.ema_xx[p] += alpha * (xx - tf_snapshot.ema_xx[p]);
+
+        for(int curve = 0; curve < 4; curve++)
+        {
+            const float yy = cpx_power(fft_mics[curve][bin], fft_mics_shift[curve]);
+            tf_snapshot.ema_yy[curve][p] += alpha * (yy - tf_snapshot.ema_yy[curve][p]);
+        }
+    }
+}
+
+static int16_t SnapshotCentiDB(float yy, float xx)
+{
+    if((xx <= 0.0f) || (yy <= 0.0f))
+    {
+        return (int16_t)(TF_NO_DATA_DB * 100.0f);
+    }
+
+    const float db = 3.01029996f * (fast_log2f(yy) - fast_log2f(xx)); //10 * log10(yy / xx)
+    return (int16_t)lroundf(100.0f * ((db < -300.0f) ? -300.0f : (db > 300.0f) ? 300.0f : db));
+}
+
+// Takes the values now, they are sent later a line at a time so capture never waits for the console
+static void TakeTFSnapshot(int frame)
+{
+    if(tf_snapshot.next_line >= 0)
+    {
+        tf_snapshot.nb_skipped++;
+        return;
+    }
+
+    const tf_accum_t *cumul[4] = {MOEMLSquaredCumul, MOEMRSquaredCumul, MIEMLSquaredCumul, MIEMRSquaredCumul};
+    const bool exponential = tf_snapshot.exponential && !sweep_excitation;
+
+    for(int p = 0; p < tf_snapshot.nb_points; p++)
+    {
+        const int bin = tf_snapshot.bins[p];
+        for(int curve = 0; curve < 4; curve++)
+        {
+            tf_snapshot.centi_db[curve][p] =
+                exponential ? SnapshotCentiDB(tf_snapshot.ema_yy[curve][p], tf_snapshot.ema_xx[p])
+                            : SnapshotCentiDB((float)cumul[curve][bin], (float)NoiseSquaredCumul[bin]);
+        }
+    }
+
+    tf_snapshot.frame = frame;
+    tf_snapshot.next_line = tf_snapshot.bins_sent ? 1 : 0;
+}
+
+// Sends the next line of the pending snapshot. Returns false when there was nothing to send.
+static bool SendTFSnapshotLine(void)
+{
+    if(tf_snapshot.next_line < 0)
+    {
+        return false;
+    }
+
+    if(tf_snapshot.next_line == 0)
+    {
+        console_write("TFBINS %d", FFTSIZE);
+        for(int p = 0; p < tf_snapshot.nb_points; p++)
+        {
+            console_write(" %d", tf_snapshot.bins[p]);
+        }
+        tf_snapshot.bins_sent = true;
+    }
+    else
+    {
+        const int curve = tf_snapshot.next_line - 1;
+        console_write("TF %d %d", tf_snapshot.frame, curve);
+        for(int p = 0; p < tf_snapshot.nb_points; p++)
+        {
+            console_write(" %d", tf_snapshot.centi_db[curve][p]);
+        }
+    }
+    console_write("\n");
+
+    tf_snapshot.next_line++;
+    if(tf_snapshot.next_line > 4)
+    {
+        tf_snapshot.next_line = -1;
+    }
+
+    return true;
+}
+
+// Frames of a periodic excitation only differ by the noise of the mics
+static inline int ConvergenceMinFrames(void)
+{
+    return multisine_excitation ? MULTISINE_CONVERGENCE_MIN_FRAMES : CONVERGENCE_MIN_FRAMES;
+}
+
+// Frames that share no samples, one per FFTSIZE samples. With 50 or 75 percent overlap the frames of a test are not
+// independent, and Welch averaging gains less than their count: counting one frame in 2 or 4 keeps the standard errors
+// an upper bound instead of stopping the test too soon.
+static inline float ConvergenceNbIndependentFrames(void)
+{
+    return ((float)convergence_nb_frames * FFT_HOP_BLOCKS) / NB_BLOCKS_IN_FFTSIZE;
+}
+
+static bool TestFailedEarly(test_type_t test_type)
+{
+    for(int r = 0; r < run_nb_results; r++)
+    {
+        if((run_results[r].test_type == test_type) && run_results[r].failed_early)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Curves of the tests that did not fail early
+static unsigned RunPendingCurveMask(void)
+{
+    unsigned curve_mask = 0;
+    for(int r = 0; r < run_nb_results; r++)
+    {
+        if(!TestFailedEarly(run_results[r].test_type))
+        {
+            curve_mask |= run_results[r].curve_mask;
+        }
+    }
+
+    return curve_mask;
+}
+
+static bool HasConverged(test_type_t test_type)
+{
+    // Only the curves of the results still to decide, once declared
+    unsigned curve_mask = ConvergenceCurveMask(test_type);
+    if(run_nb_results > 0)
+    {
+        curve_mask &= RunPendingCurveMask();
+    }
+
+    // Single sweep frames only cover a few bins, a sweep test always runs all its sweeps. The sparse analysis has no
+    // statistics on the convergence band.
+    const float n_independent = ConvergenceNbIndependentFrames();
+    if(sweep_excitation || (sparse_nb_bins > 0) || (convergence_bound_db <= 0.0f) || (curve_mask == 0) ||
+       (n_independent < ConvergenceMinFrames()))
+    {
+        return false;
+    }
+
+    // Z * sqrt(m2 / ((n - 1) * n_independent)) < bound, squared to avoid the sqrt per bin
+    const float n = (float)convergence_nb_frames;
+    const float m2_limit =
+        (convergence_bound_db * convergence_bound_db) * (n - 1.0f) * n_independent / (CONVERGENCE_Z * CONVERGENCE_Z);
+
+    for(int curve = 0; curve < 4; curve++)
+    {
+        if(!(curve_mask & (1 << curve)))
+        {
+            continue;
+        }
+
+        for(int j = 0; j < CONVERGENCE_BAND_NB_BINS; j++)
+        {
+            if(convergence_stats[curve].m2[j] >= m2_limit)
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static inline float BinFrequencyHz(int bin)
+{
+    return ((float)bin * SAMPLE_RATE) / FFTSIZE;
+}
+
+static void ResetRunResults(void)
+{
+    run_nb_results = 0;
+    limit_nb_checks = 0;
+    limit_mask_failed_early = false;
+}
+
+// Declares a result that the next run decides from the curves of curve_mask, with the same arguments as
+// JudgeLimitMasks(). Results already decided, e.g. without a headset, are left out: they get no limits, and their
+// curves neither keep the run going nor count for its convergence.
+static void PrepareResult(test_type_t test_type, unsigned curve_mask, const stray_test_result_t *result)
+{
+    if(*result != STRAY_RESULT_SUCCESS)
+    {
+        return;
+    }
+
+    PanicFalse(run_nb_results < RUN_MAX_RESULTS);
+    const int r = run_nb_results++;
+    run_results[r].test_type = test_type;
+    run_results[r].curve_mask = curve_mask;
+    run_results[r].failed_early = false;
+
+    for(int curve = 0; curve < 4; curve++)
+    {
+        if(!(curve_mask & (1 << curve)))
+        {
+            continue;
+        }
+
+        limit_check_t *check = NULL;
+        for(int m = 0; m < limit_masks.nb_masks; m++)
+        {
+            const limit_mask_t *mask = &limit_masks.masks[m];
+            if((mask->header.test_type != test_type) || (mask->header.curve != curve))
+            {
+                continue;
+            }
+
+            if(check == NULL)
+            {
+                PanicFalse(limit_nb_checks < LIMIT_MAX_CHECKS);
+                check = &limit_checks[limit_nb_checks++];
+                check->result = r;
+                check->curve = curve;
+                for(int j = 0; j < CONVERGENCE_BAND_NB_BINS; j++)
+                {
+                    check->lower_db[j] = -INFINITY;
+                    check->upper_db[j] = INFINITY;
+                }
+            }
+
+            for(int j = 0; j < CONVERGENCE_BAND_NB_BINS; j++)
+            {
+                float lower_db, upper_db;
+                if(limit_mask_limits_at(mask, BinFrequencyHz(CONVERGENCE_BAND_FIRST_BIN + j), &lower_db, &upper_db))
+                {
+                    check->lower_db[j] = fmaxf(check->lower_db[j], lower_db);
+                    check->upper_db[j] = fminf(check->upper_db[j], upper_db);
+                }
+            }
+        }
     }
 }
 
-// kiss_fft_scalar is a float in our configuration
-static void copy_to_kiss_fft_buffer(kiss_fft_scalar dest_buf[FFTSIZE], const int16_t src_buf[FFTSIZE])
+// A test fails early once a curve of one of its results is certainly out of its limits at one bin. The accumulated
+// curve is compared, with the standard error of the per-frame curves as its uncertainty, the same as the convergence
+// stop. The run no longer waits for the curves of failed tests, but goes on for the others. True once all its tests
+// failed.
+static bool LimitMaskFailsEarly(void)
 {
-    PanicFalse(dest_buf != NULL);
-    PanicFalse(src_buf != NULL);
-
-    for(int i = 0; i < FFTSIZE; i++)
+    // Sweep and sparse frames have no stats
+    const float n_independent = ConvergenceNbIndependentFrames();
+    if((limit_nb_checks == 0) || sweep_excitation || (sparse_nb_bins > 0) || (n_independent < ConvergenceMinFrames()))
     {
-        dest_buf[i] = (src_buf[i] * Q_SCALING_FACTOR);
+        return false;
     }
-}
-
-static void ComputeFFT(kiss_fft_cpx fft_buf_dest[KISS_FFT_OUT_SIZE], const int16_t buf_src[FFTSIZE])
-{
-    PanicFalse(fft_buf_dest != NULL);
-    PanicFalse(buf_src != NULL);
-
-    kiss_fftr_cfg fft_cfg = kiss_fftr_alloc(FFTSIZE, 0, 0, 0);
 
-    copy_to_kiss_fft_buffer(fftIn, buf_src);
-    apply_window_to_fft_buffer(fftIn, AudioWindowHamming1024);
+    const tf_accum_t *cumul[4] = {MOEMLSquaredCumul, MOEMRSquaredCumul, MIEMLSquaredCumul, MIEMRSquaredCumul};
+    const float log2_to_db = 3.01029996f; //10 * log10(2)
 
-    kiss_fftr(fft_cfg, fftIn, fft_buf_dest);
-    kiss_fftr_free(fft_cfg);
-}
+    // excess > Z * sqrt(m2 / ((n - 1) * n_independent)), squared to avoid the sqrt per bin
+    const float n = (float)convergence_nb_frames;
+    const float m2_scale = (LIMIT_MASK_FAIL_Z * LIMIT_MASK_FAIL_Z) / ((n - 1.0f) * n_independent);
 
-// Warning: processing is done in place and destroys the samples in the buffers
-static void ComputeFFTs(void)
-{
-    PanicFalse(fft_data_available);
+    for(int c = 0; c < limit_nb_checks; c++)
+    {
+        const limit_check_t *check = &limit_checks[c];
+        run_result_t *result = &run_results[check->result];
+        if(TestFailedEarly(result->test_type))
+        {
+            continue;
+        }
 
-    ComputeFFT(fftOEM_L, bOEM_L);
-    ComputeFFT(fftIEM_L, bIEM_L);
-    ComputeFFT(fftOEM_R, bOEM_R);
-    ComputeFFT(fftIEM_R, bIEM_R);
-    ComputeFFT(fftNoise_delayed, bNoise_delayed);
-}
+        for(int j = 0; j < CONVERGENCE_BAND_NB_BINS; j++)
+        {
+            const int bin = CONVERGENCE_BAND_FIRST_BIN + j;
+            const float xx = (float)NoiseSquaredCumul[bin];
+            const float yy = (float)cumul[check->curve][bin];
+            if((xx <= 0.0f) || (yy <= 0.0f))
+            {
+                continue;
+            }
 
-static inline float GetTFPoint(const float SyySquaredCumul[FFTSIZE / 2], const float SxxSquaredCumul[FFTSIZE / 2],
-                               const int bin)
-{
-    PanicFalse(bin < (FFTSIZE / 2));
+            const float tf_db = log2_to_db * (fast_log2f(yy) - fast_log2f(xx));
+            const float excess = fmaxf(tf_db - check->upper_db[j], check->lower_db[j] - tf_db);
+            if((excess > 0.0f) && ((excess * excess) > (m2_scale * convergence_stats[check->curve].m2[j])))
+            {
+                DEBUG("Test type %d curve %d out of its limit mask at bin %d after %d frames\n", result->test_type,
+                      check->curve, bin, convergence_nb_frames);
+                result->failed_early = true;
+                break;
+            }
+        }
+    }
 
-    return energy2dB(SyySquaredCumul[bin] / SxxSquaredCumul[bin]);
+    return RunPendingCurveMask() == 0;
 }
 
-static void ComputeAccumulateFFT(float squared_cumul[FFTSIZE / 2], const kiss_fft_cpx fft_buf_src[KISS_FFT_OUT_SIZE])
+// Fails result when one of the curves of curve_mask is out of a test_type mask at any bin, on the results of the last
+// run. Aborted runs and results already set to something else are left alone. STRAY_RESULT_FAIL is a new value of
+// stray_test_result_t, appended in audio.h after TEST_RESULT_NO_EEPROM.
+static void JudgeLimitMasks(test_type_t test_type, unsigned curve_mask, stray_test_result_t *result)
 {
-    PanicFalse(squared_cumul != NULL);
-    PanicFalse(fft_buf_src != NULL);
-
-    for(int i = 0; i < (FFTSIZE / 2); i++)
+    if(test_abort_requested || (*result != STRAY_RESULT_SUCCESS))
     {
-        Complex c(fft_buf_src[i].r, fft_buf_src[i].i);
-        Complex ccj = c * c.conjugate();
-        squared_cumul[i] += ccj.real();
+        return;
     }
-}
 
-static void ComputeAccumulateFFTs(void)
-{
-    ComputeAccumulateFFT(NoiseSquaredCumul, fftNoise_delayed);
-    ComputeAccumulateFFT(MOEMLSquaredCumul, fftOEM_L);
-    ComputeAccumulateFFT(MIEMLSquaredCumul, fftIEM_L);
-    ComputeAccumulateFFT(MOEMRSquaredCumul, fftOEM_R);
-    ComputeAccumulateFFT(MIEMRSquaredCumul, fftIEM_R);
-}
+    for(int m = 0; m < limit_masks.nb_masks; m++)
+    {
+        const limit_mask_t *mask = &limit_masks.masks[m];
+        const int curve = mask->header.curve;
+        if((mask->header.test_type != test_type) || !(curve_mask & (1 << curve)))
+        {
+            continue;
+        }
 
-static void ResetAccumulateBuffer(float buf[FFTSIZE / 2])
-{
-    memset(buf, 0, (FFTSIZE / 2) * sizeof(float));
-}
+        UpdateTFCache();
 
-static void ResetAccumulateBuffers(void)
-{
-    ResetAccumulateBuffer(NoiseSquaredCumul);
-    ResetAccumulateBuffer(MOEMLSquaredCumul);
-    ResetAccumulateBuffer(MIEMLSquaredCumul);
-    ResetAccumulateBuffer(MOEMRSquaredCumul);
-    ResetAccumulateBuffer(MIEMRSquaredCumul);
+        int nb_bins_out = 0;
+        for(int bin = 0; bin < (FFTSIZE / 2); bin++)
+        {
+            float lower_db, upper_db;
+            const float tf_db = tf_cache[curve][bin];
+            if((tf_db > TF_NO_DATA_DB) && limit_mask_limits_at(mask, BinFrequencyHz(bin), &lower_db, &upper_db) &&
+               ((tf_db < lower_db) || (tf_db > upper_db)))
+            {
+                nb_bins_out++;
+            }
+        }
+
+        if(nb_bins_out > 0)
+        {
+            DEBUG("Test type %d curve %d: %d bins out of the limit mask\n", test_type, curve, nb_bins_out);
+            *result = STRAY_RESULT_FAIL;
+        }
+    }
 }
 
 static void ResetChain(void)
 {
-    next_fft_block_number = 0;
-    fft_data_available = false;
+    next_capture_block_number = 0;
+    nb_blocks_captured = 0;
+    nb_blocks_since_last_fft = 0;
+    nb_blocks_in_run = 0;
+    ResetFrameSets();
+    ResetCaptureRing();
+    AudioMemoryUsageMaxReset();
+    nb_block_overruns = 0;
+#ifdef AUDIO_PROFILING
+    ResetProfilingStats();
+#endif
 
     pink_noise_clear();
+    excitation_next_sample = 0;
 
     audio_reset_record_queues();
 
+    ArenaEnterPhase(ARENA_PHASE_TEST);
     ResetAccumulateBuffers();
+    ResetTFSnapshot();
+    test_abort_requested = false;
+    ResetRunResults();
 }
 
 void audio_reset_record_queues(void)
@@ -402,9 +2612,10 @@ void audio_reset_record_queues(void)
     AudioRecordQueue_IEM_R.clear();
 }
 
-static bool RecordQueueNotEmpty(AudioRecordQueue &rq)
+static bool RecordQueueNotEmpty(capture_record_queue_t &rq)
 {
     int rq_blocks_available = rq.available();
+    PROFILE_QUEUE_DEPTH(rq_blocks_available);
 
     // If buffers fill up too much, that's abnormal
     PanicFalse(rq_blocks_available <= 2);
@@ -418,29 +2629,284 @@ static bool RecordQueuesNotEmpty(void)
            RecordQueueNotEmpty(AudioRecordQueue_OEM_R) && RecordQueueNotEmpty(AudioRecordQueue_IEM_R);
 }
 
-static void RunChain(test_type_t test_type, int duration_sec, bool enable_processing, uint8_t channel)
+static inline int DurationToNbFFT(int duration_sec)
+{
+    return duration_sec * SAMPLE_RATE / (FFT_HOP_BLOCKS * AUDIO_BLOCK_SAMPLES);
+}
+
+// Runs the next analysis step of the oldest pending frame set, and returns true once that frame set is done and handed
+// back to capture
+static bool RunAnalysisStep(bool enable_processing)
+{
+    frame_set_t *fs = &frame_sets[frame_set_analysis_index];
+
+    if(fs->state == FRAME_SET_FREE)
+    {
+        return false;
+    }
+
+    if(enable_processing)
+    {
+        fs->state = FRAME_SET_ANALYSING;
+
+        if(fs->analysis_step == ANALYSIS_STEP_ACCUMULATE)
+        {
+            PROFILE_BEGIN(accumulate_start);
+            tf_cache_valid = false;
+            if(latency_measurement_running)
+            {
+                AccumulateCrossSpectra();
+            }
+            else if(sweep_excitation)
+            {
+                ComputeAccumulateSweepFFTs();
+            }
+            else if(SparseAnalysisActive())
+            {
+                ComputeAccumulateSparseBins();
+            }
+            else
+            {
+                ComputeAccumulateFFTs();
+                UpdateConvergenceStats();
+                if(tf_snapshot.exponential && (tf_snapshot.every_nb_frames > 0))
+                {
+                    UpdateTFSnapshotAverages();
+                }
+            }
+            PROFILE_END(PROFILE_STAGE_ACCUMULATE, accumulate_start);
+        }
+        else if(SparseAnalysisActive())
+        {
+            ComputeSparseStep((analysis_step_t)fs->analysis_step, &sparse_frames[frame_set_analysis_index]);
+        }
+        else
+        {
+            ComputeFFTStep((analysis_step_t)fs->analysis_step, fs->start_block);
+        }
+
+        fs->analysis_step++;
+        if(fs->analysis_step < NB_ANALYSIS_STEPS)
+        {
+            return false;
+        }
+    }
+
+    fs->state = FRAME_SET_FREE;
+    frame_set_analysis_index = (frame_set_analysis_index + 1) % NB_FRAME_SETS;
+
+    return true;
+}
+
+// The block about to be captured is the oldest one queued: its number is the count of notified blocks less the depth
+// of the queues, all updated by the same audio interrupt
+static void CheckBlockDeadline(void)
+{
+    AudioNoInterrupts();
+    const uint32_t depth = AudioRecordQueue_OEM_L.available();
+    const uint32_t block = AudioBlockNotify_1.nb_blocks - depth;
+    const uint32_t queued_us = AudioBlockNotify_1.block_us[block % AUDIO_BLOCK_NOTIFY_HISTORY];
+    AudioInterrupts();
+
+    PanicFalse(depth <= AUDIO_BLOCK_NOTIFY_HISTORY);
+    if((micros() - queued_us) > CAPTURE_DEADLINE_US)
+    {
+        nb_block_overruns++;
+    }
+}
+
+// Sleeps until the audio update interrupt has queued another block than nb_blocks_seen
+static void WaitForAudioBlock(uint32_t nb_blocks_seen)
+{
+#if defined(__arm__)
+    // With interrupts masked, a block queued after the check still wakes WFI up, and is serviced once unmasked
+    __disable_irq();
+    if(AudioBlockNotify_1.nb_blocks == nb_blocks_seen)
+    {
+        asm volatile("wfi");
+    }
+    __enable_irq();
+#else
+    (void)nb_blocks_seen;
+#endif
+}
+
+// Returns the number of FFT frames run, which is less than duration_nb_fft when processing converged early
+static int RunChainFrames(test_type_t test_type, int duration_nb_fft, bool enable_processing, uint8_t channel)
 {
-    int duration_nb_fft = duration_sec * SAMPLE_RATE / FFTSIZE;
+    int nb_fft_done = 0;
 
-    while(duration_nb_fft > 0)
+    // Latency bursts are not part of the test, the host must not reanalyse them
+    capture_stream_flags = (enable_processing && !latency_measurement_running) ? CAPTURE_STREAM_FLAG_ANALYSED : 0;
+
+    while((nb_fft_done < duration_nb_fft) && !test_abort_requested)
     {
+        // Read before looking at the queues, so a block queued in between never gets slept through
+        const uint32_t nb_blocks_seen = AudioBlockNotify_1.nb_blocks;
+
+        // Capture always goes first, analysis only uses the time left until the next block
         if(RecordQueuesNotEmpty())
         {
+            CheckBlockDeadline();
+            PROFILE_BEGIN(capture_start);
             ManageQueueBuffers(test_type, channel);
-
-            if(fft_data_available)
+            PROFILE_END(PROFILE_STAGE_CAPTURE, capture_start);
+        }
+        else if(frame_sets[frame_set_analysis_index].state != FRAME_SET_FREE)
+        {
+            if(RunAnalysisStep(enable_processing))
             {
-                if(enable_processing)
+                nb_fft_done++;
+
+                if(enable_processing && !latency_measurement_running && (tf_snapshot.every_nb_frames > 0) &&
+                   ((nb_fft_done % tf_snapshot.every_nb_frames) == 0))
                 {
-                    ComputeFFTs();
-                    ComputeAccumulateFFTs();
+                    TakeTFSnapshot(nb_fft_done);
                 }
 
-                fft_data_available = false;
-                duration_nb_fft--;
+                if(enable_processing && HasConverged(test_type))
+                {
+                    break;
+                }
+
+                if(enable_processing && !latency_measurement_running &&
+                   ((nb_fft_done % LIMIT_MASK_CHECK_EVERY_NB_FRAMES) == 0) && LimitMaskFailsEarly())
+                {
+                    limit_mask_failed_early = true;
+                    break;
+                }
+            }
+        }
+        else if(!SendTFSnapshotLine())
+        {
+            if(idle_callback != NULL)
+            {
+                idle_callback();
             }
+            WaitForAudioBlock(nb_blocks_seen);
+        }
+    }
+
+    // Whatever is left of the last snapshot, the chain is about to stop
+    while(SendTFSnapshotLine())
+    {
+    }
+
+    return nb_fft_done;
+}
+
+static int RunChain(test_type_t test_type, int duration_sec, bool enable_processing, uint8_t channel)
+{
+    if(sweep_excitation && enable_processing && (test_type != TEST_TYPE_SINE_DEBUG))
+    {
+        duration_sec = SWEEP_DURATION_SEC * SWEEP_TEST_NB_SWEEPS;
+    }
+
+    const int nb_fft_done = RunChainFrames(test_type, DurationToNbFFT(duration_sec), enable_processing, channel);
+    if(test_abort_requested)
+    {
+        DEBUG("Test aborted after %d frames\n", nb_fft_done);
+    }
+    else if(limit_mask_failed_early)
+    {
+        DEBUG("Test failed its limit masks after %d frames\n", nb_fft_done);
+    }
+
+    return nb_fft_done;
+}
+
+// Runs a noise burst on a primed and running chain, and updates the delays. Leaves the chain to be primed again.
+static bool MeasureLatency(test_type_t test_type)
+{
+    // Both would correlate at every period or sweep, pink noise only at the delay
+    const bool sweep = sweep_excitation;
+    const bool multisine = multisine_excitation;
+    sweep_excitation = false;
+    SetMultisineExcitation(false);
+
+    ArenaEnterPhase(ARENA_PHASE_LATENCY);
+    DiscardFrameSets();
+    latency_measurement_running = true;
+    RunChainFrames(test_type, LATENCY_BURST_NB_FFT, true, 0);
+    latency_measurement_running = false;
+
+    sweep_excitation = sweep;
+    SetMultisineExcitation(multisine);
+
+    int delays[4];
+    int sum = 0;
+    int failed_curve = -1;
+    for(int curve = 0; curve < 4; curve++)
+    {
+        int residual_delay;
+        if(!EstimateMicDelay(curve, &residual_delay))
+        {
+            failed_curve = curve;
+            break;
+        }
+        delays[curve] = playback_to_mic_delay + residual_delay;
+        sum += delays[curve];
+    }
+
+    // Done with the cross spectra, give the accumulators back to the test
+    ArenaEnterPhase(ARENA_PHASE_TEST);
+
+    if(failed_curve >= 0)
+    {
+        DEBUG("Latency: no correlation peak on curve %d, keeping %d samples\n", failed_curve, playback_to_mic_delay);
+        return false;
+    }
+
+    const int mean_delay = (sum + 2) / 4;
+    if((mean_delay < LATENCY_MIN_DELAY_SAMPLES) || (mean_delay > LATENCY_MAX_DELAY_SAMPLES))
+    {
+        DEBUG("Latency: %d samples out of range, keeping %d samples\n", mean_delay, playback_to_mic_delay);
+        return false;
+    }
+
+    memcpy(latency_mic_delays, delays, sizeof(latency_mic_delays));
+    playback_to_mic_delay = mean_delay;
+    latency_measured = true;
+    DEBUG("Latency: OEML %d, OEMR %d, IEML %d, IEMR %d samples, reference delayed by %d\n", delays[0], delays[1],
+          delays[2], delays[3], playback_to_mic_delay);
+
+    return true;
+}
+
+// Frames to run before analysing, so that the first analysed frame starts after the mics got the excitation
+static int PrimeNbFFT(void)
+{
+    const int delay_blocks = (playback_to_mic_delay + AUDIO_BLOCK_SAMPLES - 1) / AUDIO_BLOCK_SAMPLES;
+
+    return (delay_blocks + PRIME_MARGIN_BLOCKS + FFT_HOP_BLOCKS - 1) / FFT_HOP_BLOCKS;
+}
+
+// Frames of the test type are analysed with its window from now on
+static void SelectTestWindow(test_type_t test_type)
+{
+    test_window = test_windows[test_type];
+    SetMultisineExcitation(multisine_excitation);
+}
+
+// Prime the audio chain so output samples have been captured by mics. Until the latency is known, priming lasts
+// PRETEST_DURATION_SEC and is followed by the latency measurement.
+static void PrimeChain(test_type_t test_type)
+{
+    accumulated_test_type = test_type;
+    SelectTestWindow(test_type);
+
+    if(!latency_measured)
+    {
+        RunChain(test_type, PRETEST_DURATION_SEC, false, 0);
+        if(!MeasureLatency(test_type))
+        {
+            DiscardFrameSets();
+            return;
         }
     }
+
+    RunChainFrames(test_type, PrimeNbFFT(), false, 0);
+    DiscardFrameSets();
 }
 
 // This test calculates the frequency responses between external speaker connected through earpiece speaker lines and
@@ -458,20 +2924,24 @@ bool audio_run_test0(stray_test_result_t *STOEML, stray_test_result_t *STOEMR)
     io_set_status_led_color(LED_COLOR_WHITE);
 
     ResetChain();
+    PrepareResult(TEST_TYPE_0, 1 << 0, STOEML);
+    PrepareResult(TEST_TYPE_0, 1 << 1, STOEMR);
     enableAudioChain();
 
-    // Prime the audio chain so output samples have been captures by mics
-    RunChain(TEST_TYPE_0, PRETEST_DURATION_SEC, false, 0);
+    PrimeChain(TEST_TYPE_0);
 
     DEBUG("Running test 0 for %d seconds\n", TEST1_DURATION_SEC);
-    RunChain(TEST_TYPE_0, TEST1_DURATION_SEC, true, 0);
-    DEBUG("Done - Analyzing Results\n");
+    last_test_nb_frames = RunChain(TEST_TYPE_0, TEST1_DURATION_SEC, true, 0);
+    DEBUG("Done after %d/%d frames - Analyzing Results\n", last_test_nb_frames, DurationToNbFFT(TEST1_DURATION_SEC));
 
     disableAudioChain();
 
+    JudgeLimitMasks(TEST_TYPE_0, 1 << 0, STOEML);
+    JudgeLimitMasks(TEST_TYPE_0, 1 << 1, STOEMR);
+
     io_set_status_led_color(LED_COLOR_BLUE);
 
-    return true;
+    return !test_abort_requested;
 }
 
 // This test calculates the frequency responses between each earpiece speaker and corresponding IEM
@@ -503,20 +2973,24 @@ bool audio_run_test1(stray_test_result_t *LTIEML, stray_test_result_t *LTIEMR)
     io_set_status_led_color(LED_COLOR_WHITE);
 
     ResetChain();
+    PrepareResult(TEST_TYPE_1, 1 << 2, LTIEML);
+    PrepareResult(TEST_TYPE_1, 1 << 3, LTIEMR);
     enableAudioChain();
 
-    // Prime the audio chain so output samples have been captures by mics
-    RunChain(TEST_TYPE_1, PRETEST_DURATION_SEC, false, 0);
+    PrimeChain(TEST_TYPE_1);
 
     DEBUG("Running test 1 for %d seconds\n", TEST1_DURATION_SEC);
-    RunChain(TEST_TYPE_1, TEST1_DURATION_SEC, true, 0);
-    DEBUG("Done - Analyzing Results\n");
+    last_test_nb_frames = RunChain(TEST_TYPE_1, TEST1_DURATION_SEC, true, 0);
+    DEBUG("Done after %d/%d frames - Analyzing Results\n", last_test_nb_frames, DurationToNbFFT(TEST1_DURATION_SEC));
 
     disableAudioChain();
 
+    JudgeLimitMasks(TEST_TYPE_1, 1 << 2, LTIEML);
+    JudgeLimitMasks(TEST_TYPE_1, 1 << 3, LTIEMR);
+
     io_set_status_led_color(LED_COLOR_BLUE);
 
-    return true;
+    return !test_abort_requested;
 }
 
 // This test calculates the frequency responses between the calibrator speakers and the 4 earpiece microphones
@@ -557,116 +3031,263 @@ bool audio_run_test2a(stray_test_result_t *STOEML, stray_test_result_t *STOEMR,
     io_set_status_led_color(LED_COLOR_WHITE);
 
     ResetChain();
+    PrepareResult(TEST_TYPE_2A, 1 << 0, STOEML);
+    PrepareResult(TEST_TYPE_2A, 1 << 1, STOEMR);
+    PrepareResult(TEST_TYPE_2A, 1 << 2, STIEML);
+    PrepareResult(TEST_TYPE_2A, 1 << 3, STIEMR);
+    enableAudioChain();
+
+    PrimeChain(TEST_TYPE_2A);
+
+    DEBUG("Running test 2A for %d seconds\n", TEST2A_DURATION_SEC);
+    last_test_nb_frames = RunChain(TEST_TYPE_2A, TEST2A_DURATION_SEC, true, 0);
+    DEBUG("Done after %d/%d frames - Analyzing Results\n", last_test_nb_frames, DurationToNbFFT(TEST2A_DURATION_SEC));
+
+    disableAudioChain();
+
+    JudgeLimitMasks(TEST_TYPE_2A, 1 << 0, STOEML);
+    JudgeLimitMasks(TEST_TYPE_2A, 1 << 1, STOEMR);
+    JudgeLimitMasks(TEST_TYPE_2A, 1 << 2, STIEML);
+    JudgeLimitMasks(TEST_TYPE_2A, 1 << 3, STIEMR);
+
+    io_set_status_led_color(LED_COLOR_BLUE);
+
+    return !test_abort_requested;
+}
+
+// This test calculates the frequency responses between each earpiece speaker and corresponding IEM
+bool audio_run_test2b(stray_test_result_t *LTIEML, stray_test_result_t *LTIEMR)
+{
+    PanicFalse(LTIEML != NULL);
+    PanicFalse(LTIEMR != NULL);
+
+    if(!audio_headset_connected)
+    {
+        *LTIEML = TEST_RESULT_NO_HEADSET;
+        *LTIEMR = TEST_RESULT_NO_HEADSET;
+        return false;
+    }
+    else if(!audio_headset_eeprom_alive)
+    {
+        *LTIEML = TEST_RESULT_NO_EEPROM;
+        *LTIEMR = TEST_RESULT_NO_EEPROM;
+        return false;
+    }
+    else
+    {
+        *LTIEML = STRAY_RESULT_SUCCESS;
+        *LTIEMR = STRAY_RESULT_SUCCESS;
+    }
+
+    AudioControlSGTL5000_1.volume(0.7);
+    AudioControlSGTL5000_2.volume(0.7);
+    io_set_status_led_color(LED_COLOR_WHITE);
+
+    ResetChain();
+    PrepareResult(TEST_TYPE_2B, 1 << 2, LTIEML);
+    PrepareResult(TEST_TYPE_2B, 1 << 3, LTIEMR);
+    enableAudioChain();
+
+    PrimeChain(TEST_TYPE_2B);
+
+    DEBUG("Running test 2B for %d seconds\n", TEST2B_DURATION_SEC);
+    last_test_nb_frames = RunChain(TEST_TYPE_2B, TEST2B_DURATION_SEC, true, 0);
+    DEBUG("Done after %d/%d frames - Analyzing Results\n", last_test_nb_frames, DurationToNbFFT(TEST2B_DURATION_SEC));
+
+    disableAudioChain();
+
+    JudgeLimitMasks(TEST_TYPE_2B, 1 << 2, LTIEML);
+    JudgeLimitMasks(TEST_TYPE_2B, 1 << 3, LTIEMR);
+
+    io_set_status_led_color(LED_COLOR_BLUE);
+
+    return !test_abort_requested;
+}
+
+// This test calculates the transfer function between OEM and IEM in order to detect leaks.
+bool audio_run_test3(stray_test_result_t *LTL, stray_test_result_t *LTR)
+{
+    PanicFalse(LTL != NULL);
+    PanicFalse(LTR != NULL);
+
+    if(!audio_headset_connected)
+    {
+        *LTL = TEST_RESULT_NO_HEADSET;
+        *LTR = TEST_RESULT_NO_HEADSET;
+        return false;
+    }
+    else if(!audio_headset_eeprom_alive)
+    {
+        *LTL = TEST_RESULT_NO_EEPROM;
+        *LTR = TEST_RESULT_NO_EEPROM;
+        return false;
+    }
+    else
+    {
+        *LTL = STRAY_RESULT_SUCCESS;
+        *LTR = STRAY_RESULT_SUCCESS;
+    }
+
+    AudioControlSGTL5000_1.volume(0.55); // Reset to output 80dB at unity gain on Presonus P5XT speakers
+    AudioControlSGTL5000_2.volume(0.55); // Reset to output 80dB at unity gain on Presonus P5XT speakers
+    io_set_status_led_color(LED_COLOR_WHITE);
+
+    ResetChain();
+    PrepareResult(TEST_TYPE_3, (1 << 0) | (1 << 2), LTL); //left earpiece
+    PrepareResult(TEST_TYPE_3, (1 << 1) | (1 << 3), LTR); //right earpiece
     enableAudioChain();
 
-    // Prime the audio chain so output samples have been captures by mics
-    RunChain(TEST_TYPE_2A, PRETEST_DURATION_SEC, false, 0);
+    PrimeChain(TEST_TYPE_3);
 
-    DEBUG("Running test 2A for %d seconds\n", TEST2A_DURATION_SEC);
-    RunChain(TEST_TYPE_2A, TEST2A_DURATION_SEC, true, 0);
-    DEBUG("Done - Analyzing Results\n");
+    DEBUG("Running test 3 for %d seconds\n", TEST3_DURATION_SEC);
+    last_test_nb_frames = RunChain(TEST_TYPE_3, TEST3_DURATION_SEC, true, 0);
+    DEBUG("Done after %d/%d frames - Analyzing Results\n", last_test_nb_frames, DurationToNbFFT(TEST3_DURATION_SEC));
 
     disableAudioChain();
 
+    JudgeLimitMasks(TEST_TYPE_3, (1 << 0) | (1 << 2), LTL); //left earpiece
+    JudgeLimitMasks(TEST_TYPE_3, (1 << 1) | (1 << 3), LTR); //right earpiece
+
     io_set_status_led_color(LED_COLOR_BLUE);
 
-    return true;
+    return !test_abort_requested;
 }
 
-// This test calculates the frequency responses between each earpiece speaker and corresponding IEM
-bool audio_run_test2b(stray_test_result_t *LTIEML, stray_test_result_t *LTIEMR)
+// Runs tests 0, 1 and 2B from a single SPK excitation. They all play the same noise on the earpiece speakers and
+// accumulate the same four mic curves, each test only reads different ones, so one run fills the curves of all three.
+// Test 0 does not need a headset, and still runs when tests 1 and 2B can not.
+bool audio_run_test0_1_2b(stray_test_result_t *STOEML, stray_test_result_t *STOEMR, stray_test_result_t *LTIEML_1,
+                          stray_test_result_t *LTIEMR_1, stray_test_result_t *LTIEML_2B, stray_test_result_t *LTIEMR_2B)
 {
-    PanicFalse(LTIEML != NULL);
-    PanicFalse(LTIEMR != NULL);
+    PanicFalse(STOEML != NULL);
+    PanicFalse(STOEMR != NULL);
+    PanicFalse(LTIEML_1 != NULL);
+    PanicFalse(LTIEMR_1 != NULL);
+    PanicFalse(LTIEML_2B != NULL);
+    PanicFalse(LTIEMR_2B != NULL);
+
+    *STOEML = STRAY_RESULT_SUCCESS;
+    *STOEMR = STRAY_RESULT_SUCCESS;
 
+    stray_test_result_t headset_result = STRAY_RESULT_SUCCESS;
     if(!audio_headset_connected)
     {
-        *LTIEML = TEST_RESULT_NO_HEADSET;
-        *LTIEMR = TEST_RESULT_NO_HEADSET;
-        return false;
+        headset_result = TEST_RESULT_NO_HEADSET;
     }
     else if(!audio_headset_eeprom_alive)
     {
-        *LTIEML = TEST_RESULT_NO_EEPROM;
-        *LTIEMR = TEST_RESULT_NO_EEPROM;
-        return false;
-    }
-    else
-    {
-        *LTIEML = STRAY_RESULT_SUCCESS;
-        *LTIEMR = STRAY_RESULT_SUCCESS;
+        headset_result = TEST_RESULT_NO_EEPROM;
     }
+    *LTIEML_1 = headset_result;
+    *LTIEMR_1 = headset_result;
+    *LTIEML_2B = headset_result;
+    *LTIEMR_2B = headset_result;
 
     AudioControlSGTL5000_1.volume(0.7);
     AudioControlSGTL5000_2.volume(0.7);
     io_set_status_led_color(LED_COLOR_WHITE);
 
     ResetChain();
+    PrepareResult(TEST_TYPE_0, 1 << 0, STOEML);
+    PrepareResult(TEST_TYPE_0, 1 << 1, STOEMR);
+    PrepareResult(TEST_TYPE_1, 1 << 2, LTIEML_1);
+    PrepareResult(TEST_TYPE_1, 1 << 3, LTIEMR_1);
+    PrepareResult(TEST_TYPE_2B, 1 << 2, LTIEML_2B);
+    PrepareResult(TEST_TYPE_2B, 1 << 3, LTIEMR_2B);
     enableAudioChain();
 
-    // Prime the audio chain so output samples have been captures by mics
-    RunChain(TEST_TYPE_2B, PRETEST_DURATION_SEC, false, 0);
+    PrimeChain(TEST_TYPE_SPK);
 
-    DEBUG("Running test 2B for %d seconds\n", TEST2B_DURATION_SEC);
-    RunChain(TEST_TYPE_2B, TEST2B_DURATION_SEC, true, 0);
-    DEBUG("Done - Analyzing Results\n");
+    DEBUG("Running tests 0, 1 and 2B for %d seconds\n", TEST_SPK_DURATION_SEC);
+    last_test_nb_frames = RunChain(TEST_TYPE_SPK, TEST_SPK_DURATION_SEC, true, 0);
+    DEBUG("Done after %d/%d frames - Analyzing Results\n", last_test_nb_frames, DurationToNbFFT(TEST_SPK_DURATION_SEC));
 
     disableAudioChain();
 
+    JudgeLimitMasks(TEST_TYPE_0, 1 << 0, STOEML);
+    JudgeLimitMasks(TEST_TYPE_0, 1 << 1, STOEMR);
+    JudgeLimitMasks(TEST_TYPE_1, 1 << 2, LTIEML_1);
+    JudgeLimitMasks(TEST_TYPE_1, 1 << 3, LTIEMR_1);
+    JudgeLimitMasks(TEST_TYPE_2B, 1 << 2, LTIEML_2B);
+    JudgeLimitMasks(TEST_TYPE_2B, 1 << 3, LTIEMR_2B);
+
     io_set_status_led_color(LED_COLOR_BLUE);
 
-    return true;
+    return (headset_result == STRAY_RESULT_SUCCESS) && !test_abort_requested;
 }
 
-// This test calculates the transfer function between OEM and IEM in order to detect leaks.
-bool audio_run_test3(stray_test_result_t *LTL, stray_test_result_t *LTR)
+// Runs tests 2A and 3 from a single CAL excitation. It plays at the 0.55 of test 3 (80 dB on the calibrator speakers),
+// so test 3 is judged at the level its limits were set at. Test 2A alone plays at 0.7: its transfer functions do not
+// depend on the level, only their SNR does.
+bool audio_run_test2a_3(stray_test_result_t *STOEML, stray_test_result_t *STOEMR, stray_test_result_t *STIEML,
+                        stray_test_result_t *STIEMR, stray_test_result_t *LTL, stray_test_result_t *LTR)
 {
+    PanicFalse(STOEML != NULL);
+    PanicFalse(STOEMR != NULL);
+    PanicFalse(STIEML != NULL);
+    PanicFalse(STIEMR != NULL);
     PanicFalse(LTL != NULL);
     PanicFalse(LTR != NULL);
 
+    stray_test_result_t headset_result = STRAY_RESULT_SUCCESS;
     if(!audio_headset_connected)
     {
-        *LTL = TEST_RESULT_NO_HEADSET;
-        *LTR = TEST_RESULT_NO_HEADSET;
-        return false;
+        headset_result = TEST_RESULT_NO_HEADSET;
     }
     else if(!audio_headset_eeprom_alive)
     {
-        *LTL = TEST_RESULT_NO_EEPROM;
-        *LTR = TEST_RESULT_NO_EEPROM;
-        return false;
+        headset_result = TEST_RESULT_NO_EEPROM;
     }
-    else
+    *STOEML = headset_result;
+    *STOEMR = headset_result;
+    *STIEML = headset_result;
+    *STIEMR = headset_result;
+    *LTL = headset_result;
+    *LTR = headset_result;
+
+    if(headset_result != STRAY_RESULT_SUCCESS)
     {
-        *LTL = STRAY_RESULT_SUCCESS;
-        *LTR = STRAY_RESULT_SUCCESS;
+        return false;
     }
 
-    AudioControlSGTL5000_1.volume(0.55); // Reset to output 80dB at unity gain on Presonus P5XT speakers
-    AudioControlSGTL5000_2.volume(0.55); // Reset to output 80dB at unity gain on Presonus P5XT speakers
+    AudioControlSGTL5000_1.volume(TEST_CAL_VOLUME);
+    AudioControlSGTL5000_2.volume(TEST_CAL_VOLUME);
     io_set_status_led_color(LED_COLOR_WHITE);
 
     ResetChain();
+    PrepareResult(TEST_TYPE_2A, 1 << 0, STOEML);
+    PrepareResult(TEST_TYPE_2A, 1 << 1, STOEMR);
+    PrepareResult(TEST_TYPE_2A, 1 << 2, STIEML);
+    PrepareResult(TEST_TYPE_2A, 1 << 3, STIEMR);
+    PrepareResult(TEST_TYPE_3, (1 << 0) | (1 << 2), LTL); //left earpiece
+    PrepareResult(TEST_TYPE_3, (1 << 1) | (1 << 3), LTR); //right earpiece
     enableAudioChain();
 
-    // Prime the audio chain so output samples have been captures by mics
-    RunChain(TEST_TYPE_3, PRETEST_DURATION_SEC, false, 0);
+    PrimeChain(TEST_TYPE_CAL);
 
-    DEBUG("Running test 3 for %d seconds\n", TEST3_DURATION_SEC);
-    RunChain(TEST_TYPE_3, TEST3_DURATION_SEC, true, 0);
-    DEBUG("Done - Analyzing Results\n");
+    DEBUG("Running tests 2A and 3 for %d seconds\n", TEST_CAL_DURATION_SEC);
+    last_test_nb_frames = RunChain(TEST_TYPE_CAL, TEST_CAL_DURATION_SEC, true, 0);
+    DEBUG("Done after %d/%d frames - Analyzing Results\n", last_test_nb_frames, DurationToNbFFT(TEST_CAL_DURATION_SEC));
 
     disableAudioChain();
+
+    JudgeLimitMasks(TEST_TYPE_2A, 1 << 0, STOEML);
+    JudgeLimitMasks(TEST_TYPE_2A, 1 << 1, STOEMR);
+    JudgeLimitMasks(TEST_TYPE_2A, 1 << 2, STIEML);
+    JudgeLimitMasks(TEST_TYPE_2A, 1 << 3, STIEMR);
+    JudgeLimitMasks(TEST_TYPE_3, (1 << 0) | (1 << 2), LTL); //left earpiece
+    JudgeLimitMasks(TEST_TYPE_3, (1 << 1) | (1 << 3), LTR); //right earpiece
+
     io_set_status_led_color(LED_COLOR_BLUE);
 
-    return true;
+    return !test_abort_requested;
 }
 
 bool audio_play_sine(uint32_t channel)
 {
     PanicFalse(channel < 4);
 
-    DEBUG("Playing sine wave on channel %lu for %d seconds\n", channel, SINE_TONE_PLAYBACK_DURATION);
+    DEBUG("Playing sine wave on channel %lu for %d seconds\n", (unsigned long)channel, SINE_TONE_PLAYBACK_DURATION);
     ResetChain();
     enableAudioChain();
     RunChain(TEST_TYPE_SINE_DEBUG, SINE_TONE_PLAYBACK_DURATION, false, channel);
@@ -676,38 +3297,496 @@ bool audio_play_sine(uint32_t channel)
     return true;
 }
 
+// All the curves at once, without copies: 4, or 8 with the sweep excitation. They stay valid until the next test runs.
+// None while a test runs, e.g. from the idle callback, since the cache overlays the capture ring.
+unsigned audio_get_headset_tf_curves(const float (**curves)[FFTSIZE / 2])
+{
+    PanicFalse(curves != NULL);
+
+    if(audio_chain_running)
+    {
+        *curves = NULL;
+        return 0;
+    }
+
+    UpdateTFCache();
+
+    *curves = tf_cache;
+    return sweep_excitation ? 8 : 4;
+}
+
 bool audio_get_headset_tf(float data[FFTSIZE / 2], unsigned curve_id)
 {
     PanicFalse(data != NULL);
     PanicFalse(curve_id < 8);
 
-    for(int i = 0; i < (FFTSIZE / 2); i++)
+    const float(*curves)[FFTSIZE / 2] = NULL;
+    const unsigned nb_curves = audio_get_headset_tf_curves(&curves);
+    if(curve_id >= nb_curves) //2f band curves need a sweep, and none while a test runs
+    {
+        return false;
+    }
+
+    memcpy(data, curves[curve_id], sizeof(tf_cache[curve_id]));
+    return true;
+}
+
+// Builds one packet with all the curves of the last test, 4 or 8 with the sweep excitation, for the station to send in
+// a single write. TF_EXPORT_PACKET_MAX_SIZE(8, FFTSIZE / 2) always fits. Returns the packet length, 0 when it does not
+// fit in packet_size or a test is running.
+size_t audio_export_headset_tf(uint8_t *packet, size_t packet_size, tf_export_resolution_t resolution)
+{
+    const float(*curves)[FFTSIZE / 2] = NULL;
+    const uint8_t nb_curves = (uint8_t)audio_get_headset_tf_curves(&curves);
+    if(nb_curves == 0) //a test is running
+    {
+        return 0;
+    }
+
+    tf_export_packet_t p;
+    if(!tf_export_begin(&p, packet, packet_size, (uint8_t)accumulated_test_type, resolution, nb_curves, FFTSIZE / 2,
+                        FFTSIZE, SAMPLE_RATE))
+    {
+        return 0;
+    }
+
+    for(unsigned curve_id = 0; curve_id < nb_curves; curve_id++)
+    {
+        tf_export_add_curve(&p, curves[curve_id]);
+    }
+
+    return tf_export_end(&p);
+}
+
+// Measures the playback to mic latency on its own. audio_initialise() does at start-up, and when that fails the tests
+// measure it the first time they run.
+bool audio_measure_latency(void)
+{
+    AudioControlSGTL5000_1.volume(0.7);
+    AudioControlSGTL5000_2.volume(0.7);
+
+    ResetChain();
+    enableAudioChain();
+
+    latency_measured = false;
+    SelectTestWindow(TEST_TYPE_SPK);
+    RunChain(TEST_TYPE_SPK, PRETEST_DURATION_SEC, false, 0);
+    const bool measured = MeasureLatency(TEST_TYPE_SPK);
+
+    disableAudioChain();
+
+    return measured;
+}
+
+// Delay of each mic in samples, in curve id order. Returns false until a measurement succeeded.
+bool audio_get_latency_samples(int delays[4])
+{
+    PanicFalse(delays != NULL);
+
+    memcpy(delays, latency_mic_delays, sizeof(latency_mic_delays));
+    return latency_measured;
+}
+
+// Pass/fail masks of the tests, as stored in EEPROM, see limit_mask.h. Tests then fail the results of the curves out of
+// their masks, and stop early once a failure is certain instead of running their full duration. An invalid blob, or
+// size = 0, removes the masks and every test passes again. Returns false for an invalid blob.
+bool audio_load_limit_masks(const uint8_t *blob, size_t size)
+{
+    const bool loaded = limit_mask_load(&limit_masks, blob, size);
+    DEBUG("%d limit masks loaded\n", limit_masks.nb_masks);
+
+    return loaded;
+}
+
+// Restricts the analysis of the next noise tests to the bins nearest to freqs_hz, for pass/fail checks on a few
+// frequencies: a Goertzel filter per bin and channel runs over each block as it is captured, instead of the full
+// transforms of each frame. Only those bins get accumulated, the others read TF_NO_DATA_DB. On the host the filters
+// cost as much as the full analysis at 8 to 16 bins, audio_run_sparse_benchmark() gives the crossover on target.
+// nb_freqs = 0 goes back to the full analysis. Returns the number of distinct bins.
+int audio_set_sparse_frequencies(const float *freqs_hz, int nb_freqs)
+{
+    PanicFalse((nb_freqs == 0) || (freqs_hz != NULL));
+    PanicFalse((nb_freqs >= 0) && (nb_freqs <= SPARSE_MAX_BINS));
+
+    sparse_nb_bins = 0;
+    for(int f = 0; f < nb_freqs; f++)
+    {
+        const int bin = (int)lroundf(freqs_hz[f] * FFTSIZE / SAMPLE_RATE);
+        PanicFalse((bin > 0) && (bin < (FFTSIZE / 2)));
+
+        bool known = false;
+        for(int j = 0; j < sparse_nb_bins; j++)
+        {
+            known = known || (sparse_bins[j] == bin);
+        }
+        if(known)
+        {
+            continue;
+        }
+
+        const double w = (2.0 * M_PI * bin) / FFTSIZE;
+        sparse_bins[sparse_nb_bins] = bin;
+        sparse_coeffs[sparse_nb_bins] = (float)(2.0 * cos(w));
+        sparse_sines[sparse_nb_bins] = (float)sin(w);
+        sparse_nb_bins++;
+    }
+
+    return sparse_nb_bins;
+}
+
+// Switches the transfer function tests between pink noise and exponential sine sweeps. With sweeps, curves 4 to 7 of
+// audio_get_headset_tf are the 2f band curves of curves 0 to 3: at bin k, the mic power over bins 2k and 2k + 1 while
+// the sweep excites bin k, relative to the reference at bin k. They read the second harmonic distortion where that
+// dominates the band, see ComputeAccumulateSweepFFTs().
+void audio_set_sweep_excitation(bool enable)
+{
+    if(enable)
+    {
+        SetMultisineExcitation(false);
+    }
+    sweep_excitation = enable;
+    tf_cache_valid = false; //the number of curves changes
+}
+
+// One period of pink multisine: every bin but DC and Nyquist at amplitude 1 / sqrt(k), with Schroeder phases to keep
+// the crest factor low. For powers p_l normalised to a sum of 1, phase_k = -2 pi sum_{l < k} (k - l) p_l, which for
+// p_l = 1 / (l H) is -2 pi (k H_{k-1} - (k - 1)) / H, with H_k the harmonic numbers and H the sum over all bins.
+// Synthesised sample by sample in two passes, peak then samples, so it needs no scratch buffer.
+static void GenerateMultisine(void)
+{
+    const int last_bin = (FFTSIZE / 2) - 1;
+
+    double harmonic_sum = 0.0;
+    for(int k = 1; k <= last_bin; k++)
+    {
+        harmonic_sum += 1.0 / k;
+    }
+
+    float peak = 0.0f;
+    for(int pass = 0; pass < 2; pass++)
+    {
+        const float scale = (pass == 0) ? 1.0f : (MULTISINE_AMPLITUDE / peak);
+
+        for(int n = 0; n < FFTSIZE; n++)
+        {
+            float sample = 0.0f;
+            double harmonic = 0.0; //H_{k-1}
+            for(int k = 1; k <= last_bin; k++)
+            {
+                // Both phases in turns, reduced before going to float
+                const double phase = (double)((k * n) % FFTSIZE) / FFTSIZE -
+                                     (((k * harmonic) - (k - 1)) / harmonic_sum);
+                const float turns = (float)(phase - floor(phase));
+                sample += cosf(2.0f * (float)M_PI * turns) / sqrtf((float)k);
+                harmonic += 1.0 / k;
+            }
+
+            if(pass == 0)
+            {
+                peak = fmaxf(peak, fabsf(sample));
+            }
+            else
+            {
+                multisine_period[n] = (int16_t)lroundf(scale * sample);
+            }
+        }
+    }
+
+    // The reference spectrum, from the quantised period exactly as it is played and analysed
+    PanicFalse(!audio_chain_running);
+    ArenaEnterPhase(ARENA_PHASE_TEST);
+
+    const int16_t *period_blocks[CAPTURE_RING_BLOCKS];
+    for(int b = 0; b < CAPTURE_RING_BLOCKS; b++)
+    {
+        period_blocks[b] = &multisine_period[(b % NB_BLOCKS_IN_FFTSIZE) * AUDIO_BLOCK_SAMPLES];
+    }
+    multisine_spectrum_shift = ComputeFFT(multisine_spectrum, period_blocks, 0);
+
+    multisine_generated = true;
+    DEBUG("Multisine: crest factor %d/100\n", (int)lroundf(100.0f * peak / sqrtf((float)harmonic_sum / 2.0f)));
+}
+
+// Switches the transfer function tests between pink noise and a periodic pink multisine. Each frame then holds exactly
+// one period, analysed with a rectangular window: there is no leakage nor random error from the excitation, so tests
+// converge in MULTISINE_CONVERGENCE_MIN_FRAMES frames when the mics are quiet. The period is generated on first use,
+// with the chain stopped.
+void audio_set_multisine_excitation(bool enable)
+{
+    if(enable)
+    {
+        sweep_excitation = false;
+    }
+    if(enable && !multisine_generated)
+    {
+        SetMultisineExcitation(true); //rectangular window first, the reference spectrum goes through it
+        GenerateMultisine();
+    }
+    SetMultisineExcitation(enable);
+    tf_cache_valid = false;
+}
+
+// Selects the window the frames of a test type are analysed with, ANALYSIS_WINDOW from audio_initialise() on. Takes
+// effect from the next run of the test; the multisine excitation still uses the rectangular window. The transfer
+// functions are ratios of spectra of the same frames, so the window changes their leakage and variance, not their
+// level. capture_reanalysis.py assumes the Hamming window.
+void audio_set_test_window(uint8_t test_type, analysis_window_t window)
+{
+    PanicFalse(test_type < NB_TEST_TYPES);
+    PanicFalse(window <= ANALYSIS_WINDOW_RECTANGULAR);
+
+    test_windows[test_type] = window;
+}
+
+// Streams the raw mic and reference blocks of the next tests over USB serial, for capture_receiver.py
+void audio_set_capture_streaming(bool enable)
+{
+    if(enable && !capture_streaming_enabled)
+    {
+        capture_stream_reset();
+    }
+    capture_streaming_enabled = enable;
+}
+
+void audio_set_idle_callback(void (*callback)(void))
+{
+    idle_callback = callback;
+}
+
+// Timings are since the start of the last test, in microseconds
+void audio_dump_profiling_stats(void)
+{
+#ifdef AUDIO_PROFILING
+    console_write("stage                   nb      min     mean      max   histogram (1/8 block period buckets)\n");
+    for(int stage = 0; stage < NB_PROFILE_STAGES; stage++)
     {
-        float point;
-        if(curve_id == 0) //OEML-Noise
+        const profile_stats_t *stats = &profile_stats[stage];
+        if(stats->nb == 0)
         {
-            point = GetTFPoint(MOEMLSquaredCumul, NoiseSquaredCumul, i);
+            console_write("%-20s %5d\n", profile_stage_names[stage], 0);
+            continue;
         }
-        else if(curve_id == 1) //OEMR-Noise
+
+        console_write("%-20s %5lu %8lu %8lu %8lu  ", profile_stage_names[stage], (unsigned long)stats->nb,
+                      (unsigned long)(stats->min / PROFILE_TICKS_PER_US),
+                      (unsigned long)((stats->sum / stats->nb) / PROFILE_TICKS_PER_US),
+                      (unsigned long)(stats->max / PROFILE_TICKS_PER_US));
+        for(int bucket = 0; bucket < PROFILE_HISTOGRAM_BUCKETS; bucket++)
         {
-            point = GetTFPoint(MOEMRSquaredCumul, NoiseSquaredCumul, i);
+            console_write(" %lu", (unsigned long)stats->histogram[bucket]);
         }
-        else if(curve_id == 2) //IEML-Noise
+        console_write("\n");
+    }
+    console_write("block period %lu us, record queue depth max %d, %d overruns, %d arena phase changes\n",
+                  (unsigned long)AUDIO_BLOCK_PERIOD_US, profile_queue_depth_max, nb_block_overruns,
+                  profile_nb_arena_phase_changes);
+#else
+    console_write("Profiling not compiled in (AUDIO_PROFILING)\n");
+#endif
+}
+
+// Static RAM of the analysis per phase and per test type, all known at compile time
+void audio_dump_memory_report(void)
+{
+    const size_t chain_bytes = sizeof(arena_chain_t);
+    const size_t accum_bytes = sizeof(arena_accum_t);
+    const size_t fixed_bytes = sizeof(fft_engine) + sizeof(fft_inverse_engine) +
+#ifdef FFT_PAIRED_CHANNELS
+                               sizeof(fft_pair_engine) +
+#endif
+#ifndef FIXED_POINT
+                               sizeof(fftWindow) +
+#endif
+                               sizeof(convergence_stats) + sizeof(bSine) + sizeof(multisine_period) +
+                               sizeof(multisine_spectrum);
+
+    console_write("FFTSIZE %d, arena %lu bytes (budget %lu), plans and tables %lu bytes\n", FFTSIZE,
+                  (unsigned long)(sizeof(arena_chain_or_results) + sizeof(arena_accum_or_latency)),
+                  (unsigned long)AUDIO_ARENA_BUDGET_BYTES, (unsigned long)fixed_bytes);
+    console_write("phase test %lu, latency %lu, results %lu bytes\n", (unsigned long)(chain_bytes + accum_bytes),
+                  (unsigned long)(chain_bytes + sizeof(arena_latency_t)),
+                  (unsigned long)(sizeof(tf_cache) + accum_bytes));
+
+    // A test first measures the latency if needed, then runs, then its results are read
+    const size_t test_peak_bytes = chain_bytes + ((accum_bytes > sizeof(arena_latency_t)) ? accum_bytes
+                                                                                            : sizeof(arena_latency_t));
+    console_write("tests 0 1 2A 2B 3 SPK CAL: %lu bytes peak, sine debug (capture only): %lu bytes\n",
+                  (unsigned long)test_peak_bytes, (unsigned long)chain_bytes);
+}
+
+// Analyses nb_frames frames of the current excitation from a fresh chain, returns the time it took in ticks
+static uint64_t BenchmarkAnalysis(int nb_frames)
+{
+    ResetChain();
+
+    // Every channel reads the reference, the analysis costs about the same whatever the mics hear
+    for(int b = 0; b < CAPTURE_RING_BLOCKS; b++)
+    {
+        int16_t *block = &bNoise_delayed[b * AUDIO_BLOCK_SAMPLES];
+        if(sweep_excitation)
         {
-            point = GetTFPoint(MIEMLSquaredCumul, NoiseSquaredCumul, i);
+            sweep_get(block, b * AUDIO_BLOCK_SAMPLES);
         }
-        else if(curve_id == 3) //IEMR-Noise
+        else if(multisine_excitation)
         {
-            point = GetTFPoint(MIEMRSquaredCumul, NoiseSquaredCumul, i);
+            multisine_get(block, b * AUDIO_BLOCK_SAMPLES);
         }
         else
         {
-            return false;
+            pink_noise_get(block);
         }
-        data[i] = point;
+        ringOEM_L[b] = ringIEM_L[b] = ringOEM_R[b] = ringIEM_R[b] = ringNoise_delayed[b];
     }
 
-    return true;
+    // The sparse filters run as the blocks come in, a frame costs its FFT_HOP_BLOCKS new blocks. The blocks before the
+    // first of them are not timed, as if capture had been running.
+    const bool sparse = SparseAnalysisActive();
+    while(sparse && (nb_blocks_in_run < (NB_BLOCKS_IN_FFTSIZE - FFT_HOP_BLOCKS)))
+    {
+        UpdateSparseBanks(nb_blocks_in_run % CAPTURE_RING_BLOCKS);
+        nb_blocks_in_run++;
+    }
+
+    // Summed per frame, the cycle counter wraps in seconds
+    uint64_t elapsed_ticks = 0;
+    for(int frame = 0; frame < nb_frames; frame++)
+    {
+        const uint32_t start_ticks = profile_ticks();
+        for(int b = 0; sparse && (b < FFT_HOP_BLOCKS); b++)
+        {
+            UpdateSparseBanks(nb_blocks_in_run % CAPTURE_RING_BLOCKS);
+            nb_blocks_in_run++;
+        }
+        if(sparse)
+        {
+            SaveSparseFrame(frame_set_capture_index);
+        }
+        PublishFrameSet((frame * FFT_HOP_BLOCKS) % CAPTURE_RING_BLOCKS);
+        while(!RunAnalysisStep(true))
+        {
+        }
+        (void)HasConverged(TEST_TYPE_SPK); //all four curves
+        elapsed_ticks += profile_ticks() - start_ticks;
+    }
+
+    return elapsed_ticks;
+}
+
+static void PrintBenchmark(const char *name, int nb_frames, uint64_t elapsed_ticks)
+{
+    const uint64_t frame_ns = (elapsed_ticks * 1000) / PROFILE_TICKS_PER_US / nb_frames;
+
+    console_write("%s: %d frames, %lu ns per frame (budget %lu us), %lu frames/s\n", name, nb_frames,
+                  (unsigned long)frame_ns, (unsigned long)(FFT_HOP_BLOCKS * AUDIO_BLOCK_PERIOD_US),
+                  (unsigned long)((frame_ns > 0) ? (1000000000ULL / frame_ns) : 0));
+}
+
+// Runs the analysis of nb_frames frames of each excitation, without the audio chain, and reports the frame rate
+// against the real time budget. Test types only differ in the speakers played and the curves convergence waits for,
+// not in the analysis, which is the same for all of them; the excitation changes it (gated sweep accumulation, copy of
+// the periodic reference spectrum). The analysis only needs the capture ring, so this runs the same on target without
+// shields attached, and on the host build of host/, whose analysis_bench runs the real tests in virtual time.
+void audio_run_analysis_benchmark(int nb_frames)
+{
+    PanicFalse(nb_frames > 0);
+    PanicFalse(!audio_chain_running);
+
+    const bool sweep = sweep_excitation;
+    const bool multisine = multisine_excitation;
+    const int nb_bins = sparse_nb_bins;
+    sparse_nb_bins = 0;
+
+    static const char *const excitation_names[] = {"pink noise", "sweep", "multisine"};
+    for(int excitation = 0; excitation < 3; excitation++)
+    {
+        audio_set_sweep_excitation(excitation == 1);
+        audio_set_multisine_excitation(excitation == 2);
+
+        PrintBenchmark(excitation_names[excitation], nb_frames, BenchmarkAnalysis(nb_frames));
+        audio_dump_profiling_stats();
+    }
+
+    audio_set_sweep_excitation(sweep);
+    audio_set_multisine_excitation(multisine);
+    sparse_nb_bins = nb_bins;
+    ResetChain();
+}
+
+// Frame time of the sparse analysis on the bins of audio_set_sparse_frequencies(), its filters over the blocks of the
+// frame included, against the full analysis
+void audio_run_sparse_benchmark(int nb_frames)
+{
+    PanicFalse(nb_frames > 0);
+    PanicFalse(sparse_nb_bins > 0);
+
+    const int nb_bins = sparse_nb_bins;
+    sparse_nb_bins = 0;
+    const uint64_t full_ticks = BenchmarkAnalysis(nb_frames);
+    sparse_nb_bins = nb_bins;
+    const uint64_t sparse_ticks = BenchmarkAnalysis(nb_frames);
+
+    console_write("full: %lu ns per frame, sparse on %d bins: %lu ns per frame, %lu%% of the full analysis\n",
+                  (unsigned long)((full_ticks * 1000) / PROFILE_TICKS_PER_US / nb_frames), nb_bins,
+                  (unsigned long)((sparse_ticks * 1000) / PROFILE_TICKS_PER_US / nb_frames),
+                  (unsigned long)((full_ticks > 0) ? ((sparse_ticks * 100) / full_ticks) : 0));
+
+    ResetChain();
+}
+
+int audio_get_block_overruns(void)
+{
+    return nb_block_overruns;
+}
+
+int audio_get_memory_usage_max(void)
+{
+    return AudioMemoryUsageMax();
+}
+
+int audio_get_last_test_nb_frames(void)
+{
+    return last_test_nb_frames;
+}
+
+// Every every_nb_frames analysed frames of the next tests, the curves at TF_SNAPSHOT_NB_POINTS log spaced bins go to
+// the console, as centi-dB of the test so far or of an exponential average of the last frames (noise only):
+//   TFBINS <FFTSIZE> <bin>...           once per test
+//   TF <frame> <curve id> <centi-dB>... one line per curve 0 to 3
+// 0 turns it off.
+void audio_set_tf_snapshots(int every_nb_frames, bool exponential)
+{
+    PanicFalse(every_nb_frames >= 0);
+
+    tf_snapshot.every_nb_frames = every_nb_frames;
+    tf_snapshot.exponential = exponential;
+
+    // Log spaced from the first bin to the last, without repeats at the low end
+    tf_snapshot.nb_points = 0;
+    const float ratio = (float)((FFTSIZE / 2) - 1);
+    for(int p = 0; p < TF_SNAPSHOT_NB_POINTS; p++)
+    {
+        const int bin = (int)lroundf(powf(ratio, (float)p / (TF_SNAPSHOT_NB_POINTS - 1)));
+        if((tf_snapshot.nb_points == 0) || (bin > tf_snapshot.bins[tf_snapshot.nb_points - 1]))
+        {
+            tf_snapshot.bins[tf_snapshot.nb_points++] = bin;
+        }
+    }
+
+    ResetTFSnapshot();
+}
+
+// Stops the running test at the next chance, e.g. from the idle callback when the operator sees a bad fit in the
+// snapshots. The test returns false. Tests starting afterwards run normally.
+void audio_abort_test(void)
+{
+    test_abort_requested = true;
+}
+
+// Enables the convergence stop with bound_db, e.g. CONVERGENCE_BOUND_DB. 0, the default, runs every test for its full
+// duration.
+void audio_set_convergence_bound_db(float bound_db)
+{
+    convergence_bound_db = bound_db;
 }
 
 bool audio_get_current_mic_rms(float *measured_rms_oem_l, float *measured_rms_oem_r, float *measured_rms_iem_l,
@@ -735,6 +3814,35 @@ bool audio_get_current_mic_rms(float *measured_rms_oem_l, float *measured_rms_oe
     return true;
 }
 
+// Non-blocking snapshot of the fractional octave levels of the mics, in dB full scale like audio_get_current_mic_rms.
+// levels_db[curve][band] takes the curve order of audio_get_headset_tf, bands go up from centres_hz[0], see
+// band_levels.h. Levels follow the mics with a BAND_LEVELS_TIME_CONSTANT_MS time constant, without running a test, for
+// seating and ambient noise checks. Returns false until they settled after audio_initialise() or a re-enable.
+bool audio_get_band_levels(float levels_db[4][BAND_LEVELS_NB_BANDS], const float **centres_hz)
+{
+    PanicFalse(levels_db != NULL);
+
+    if(centres_hz != NULL)
+    {
+        *centres_hz = AudioAnalyzeBandLevels_1.centres_hz();
+    }
+    return AudioAnalyzeBandLevels_1.read(levels_db);
+}
+
+// The band levels cost a bounded share of the audio update, the same for every block; they can be switched off during
+// the tests to give it back to the analysis
+void audio_enable_band_levels(bool enable)
+{
+    if(enable)
+    {
+        AudioAnalyzeBandLevels_1.begin();
+    }
+    else
+    {
+        AudioAnalyzeBandLevels_1.end();
+    }
+}
+
 void audio_enable_interrupts(void)
 {
     AudioInterrupts();
@@ -769,10 +3877,9 @@ void audio_initialise(void)
 {
     PanicFalse(AUDIO_BLOCK_SAMPLES == 128);
     PanicFalse(SAMPLE_RATE == 44100);
-    PanicFalse(FFTSIZE == 1024);
 
     //Audio connections require memory to work.  For more detailed information, see the MemoryAndCpuUsage example
-    AudioMemory(120);
+    AudioMemory(AUDIO_MEMORY_BLOCKS);
 
     //First audio shield
     AudioControlSGTL5000_1.setAddress(LOW);
@@ -786,7 +3893,25 @@ void audio_initialise(void)
     AudioControlSGTL5000_2.inputSelect(AUDIO_INPUT_LINEIN);
     AudioControlSGTL5000_2.volume(0.7);
 
+    for(int t = 0; t < NB_TEST_TYPES; t++)
+    {
+        test_windows[t] = ANALYSIS_WINDOW;
+    }
+
+    FFTEngineInitialise(&fft_engine, 0);
+    FFTEngineInitialise(&fft_inverse_engine, 1);
+#ifndef FIXED_POINT
+    init_float_window(fftWindow, frame_window);
+#endif
+#ifdef FFT_PAIRED_CHANNELS
+    FFTPairEngineInitialise(&fft_pair_engine);
+#endif
+
     pink_noise_amplitude(1.0f);
     AudioSynthWaveformSine_1.amplitude(1.0);
     AudioSynthWaveformSine_1.frequency(4000);
+
+    AudioAnalyzeBandLevels_1.begin();
+
+    audio_measure_latency();
 }
@@ -0,0 +1,180 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+#include <Arduino.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "band_levels.h"
+
+#define DEBUG_ENABLED
+#include "debug.h"
+
+// Decimation low-pass cutoff, relative to the rate of the octave it filters. The top band of the next octave ends at
+// 0.128 of it for octave bands, and what folds onto that band starts at 0.372.
+#define BAND_LEVELS_DECIMATION_CUTOFF 0.2
+
+// Same as the RBJ cookbook band-pass with 0 dB peak gain, for a band bw_octaves wide between its -3 dB points
+static band_levels_biquad_t DesignBandpass(double centre, double bw_octaves)
+{
+    const double w0 = 2.0 * M_PI * centre;
+    const double alpha = sin(w0) * sinh((log(2.0) / 2.0) * bw_octaves * (w0 / sin(w0)));
+    const double a0 = 1.0 + alpha;
+
+    band_levels_biquad_t q;
+    q.b0 = (float)(alpha / a0);
+    q.b1 = 0.0f;
+    q.b2 = (float)(-alpha / a0);
+    q.a1 = (float)((-2.0 * cos(w0)) / a0);
+    q.a2 = (float)((1.0 - alpha) / a0);
+    return q;
+}
+
+// Same as the RBJ cookbook low-pass
+static band_levels_biquad_t DesignLowpass(double cutoff, double quality)
+{
+    const double w0 = 2.0 * M_PI * cutoff;
+    const double alpha = sin(w0) / (2.0 * quality);
+    const double a0 = 1.0 + alpha;
+
+    band_levels_biquad_t q;
+    q.b0 = (float)(((1.0 - cos(w0)) / 2.0) / a0);
+    q.b1 = (float)((1.0 - cos(w0)) / a0);
+    q.b2 = q.b0;
+    q.a1 = (float)((-2.0 * cos(w0)) / a0);
+    q.a2 = (float)((1.0 - alpha) / a0);
+    return q;
+}
+
+void band_levels_design(band_levels_design_t *d, float sample_rate, int nb_samples, float time_constant_ms)
+{
+    PanicFalse(d != NULL);
+    PanicFalse((nb_samples > 0) && (nb_samples <= BAND_LEVELS_MAX_BLOCK_SAMPLES));
+    PanicFalse((nb_samples % (1 << (BAND_LEVELS_NB_OCTAVES - 1))) == 0);
+    PanicFalse(time_constant_ms > 0.0f);
+
+    const int n = BAND_LEVELS_BANDS_PER_OCTAVE;
+
+    // Identical sections in cascade: each one is made wider so the cascade is -3 dB at the band edges. With x the
+    // detuning Q (f / f0 - f0 / f) of one section, the cascade is -3 dB where (1 + x^2)^S = 2.
+    const double x_edge = sqrt(pow(2.0, 1.0 / BAND_LEVELS_BANDPASS_SECTIONS) - 1.0);
+    const double detuning_edge = pow(2.0, 1.0 / (2.0 * n)) - pow(2.0, -1.0 / (2.0 * n));
+    const double quality = x_edge / detuning_edge;
+    const double section_bw_octaves = (2.0 * asinh(1.0 / (2.0 * quality))) / log(2.0);
+
+    for(int j = 0; j < n; j++)
+    {
+        const double centre = (BAND_LEVELS_TOP_HZ * pow(2.0, -(double)j / n)) / sample_rate;
+        for(int s = 0; s < BAND_LEVELS_BANDPASS_SECTIONS; s++)
+        {
+            d->bandpass[j][s] = DesignBandpass(centre, section_bw_octaves);
+        }
+    }
+
+    // Butterworth: pole pairs at pi (2s + 1) / 2M from the imaginary axis, for order M
+    for(int s = 0; s < BAND_LEVELS_DECIMATION_SECTIONS; s++)
+    {
+        const double theta = (M_PI * ((2 * s) + 1)) / (4.0 * BAND_LEVELS_DECIMATION_SECTIONS);
+        d->decimation[s] = DesignLowpass(BAND_LEVELS_DECIMATION_CUTOFF, 1.0 / (2.0 * cos(theta)));
+    }
+
+    for(int k = 0; k < BAND_LEVELS_NB_BANDS; k++)
+    {
+        d->centres_hz[k] = (float)(BAND_LEVELS_TOP_HZ * pow(2.0, (double)(k + 1 - BAND_LEVELS_NB_BANDS) / n));
+    }
+
+    const double blocks_per_time_constant = (time_constant_ms * sample_rate) / (1000.0 * nb_samples);
+    d->alpha = (float)(1.0 - exp(-1.0 / blocks_per_time_constant));
+    d->settle_blocks = (uint32_t)ceil(2.0 * blocks_per_time_constant);
+    d->nb_samples = nb_samples;
+}
+
+void band_levels_reset(band_levels_channel_t *c)
+{
+    PanicFalse(c != NULL);
+
+    memset(c, 0, sizeof(*c));
+}
+
+// Transposed direct form II, from src to dest, which can be the same buffer
+static void BiquadBlock(const band_levels_biquad_t *q, float z[2], const float *src, float *dest, int nb_samples)
+{
+    const float b0 = q->b0, b1 = q->b1, b2 = q->b2, a1 = q->a1, a2 = q->a2;
+    float z1 = z[0];
+    float z2 = z[1];
+
+    for(int i = 0; i < nb_samples; i++)
+    {
+        const float x = src[i];
+        const float y = (b0 * x) + z1;
+        z1 = (b1 * x) - (a1 * y) + z2;
+        z2 = (b2 * x) - (a2 * y);
+        dest[i] = y;
+    }
+
+    z[0] = z1;
+    z[1] = z2;
+}
+
+void band_levels_process(const band_levels_design_t *d, band_levels_channel_t *c, const int16_t *samples)
+{
+    float x[BAND_LEVELS_MAX_BLOCK_SAMPLES];
+    float y[BAND_LEVELS_MAX_BLOCK_SAMPLES];
+    int nb = d->nb_samples;
+
+    for(int i = 0; i < nb; i++)
+    {
+        x[i] = samples[i] * (1.0f / 32768.0f);
+    }
+
+    for(int octave = 0; octave < BAND_LEVELS_NB_OCTAVES; octave++)
+    {
+        for(int j = 0; j < BAND_LEVELS_BANDS_PER_OCTAVE; j++)
+        {
+            BiquadBlock(&d->bandpass[j][0], c->bandpass_z[octave][j][0], x, y, nb);
+            for(int s = 1; s < BAND_LEVELS_BANDPASS_SECTIONS; s++)
+            {
+                BiquadBlock(&d->bandpass[j][s], c->bandpass_z[octave][j][s], y, y, nb);
+            }
+
+            float sum = 0.0f;
+            for(int i = 0; i < nb; i++)
+            {
+                sum += y[i] * y[i];
+            }
+
+            const int band = BAND_LEVELS_NB_BANDS - 1 - ((octave * BAND_LEVELS_BANDS_PER_OCTAVE) + j);
+            c->mean_square[band] += d->alpha * ((sum / nb) - c->mean_square[band]);
+        }
+
+        if(octave == (BAND_LEVELS_NB_OCTAVES - 1))
+        {
+            break;
+        }
+
+        // Next octave: low-pass every sample, keep every other one
+        for(int s = 0; s < BAND_LEVELS_DECIMATION_SECTIONS; s++)
+        {
+            BiquadBlock(&d->decimation[s], c->decimation_z[octave][s], x, x, nb);
+        }
+        nb /= 2;
+        for(int i = 0; i < nb; i++)
+        {
+            x[i] = x[2 * i];
+        }
+    }
+
+    c->nb_blocks++;
+}
@@ -0,0 +1,75 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+#ifndef BAND_LEVELS_H
+#define BAND_LEVELS_H
+
+#include <stdint.h>
+
+// Fractional octave band levels of one channel, block by block. Octaves are processed from the top down: the bands of
+// an octave are band-pass biquad cascades at the rate of that octave, then a low-pass cascade and a decimation by 2
+// bring the next octave down to the same normalised frequencies. Every octave thus shares the same coefficients, and
+// the whole bank costs about twice its top octave, whatever the number of octaves.
+//
+// Band k, counted from the lowest, is centred on BAND_LEVELS_TOP_HZ * 2^((k + 1 - BAND_LEVELS_NB_BANDS) / N) for
+// N = BAND_LEVELS_BANDS_PER_OCTAVE. Its level is the exponential average of the mean square of its output, one update
+// per block, in dB full scale.
+
+#define BAND_LEVELS_BANDS_PER_OCTAVE 3 //1 for octaves, 3 for third octaves
+#define BAND_LEVELS_NB_OCTAVES 8
+#define BAND_LEVELS_NB_BANDS (BAND_LEVELS_NB_OCTAVES * BAND_LEVELS_BANDS_PER_OCTAVE)
+#define BAND_LEVELS_TOP_HZ 8000.0 //centre of the highest band, its upper edge must stay well below Nyquist
+#define BAND_LEVELS_BANDPASS_SECTIONS 2
+#define BAND_LEVELS_DECIMATION_SECTIONS 3 //6th order Butterworth
+#define BAND_LEVELS_MAX_BLOCK_SAMPLES 128
+#define BAND_LEVELS_NO_DATA_DB -200.0f
+
+// Every octave must get at least one sample per block
+#if(BAND_LEVELS_MAX_BLOCK_SAMPLES % (1 << (BAND_LEVELS_NB_OCTAVES - 1))) != 0
+#error "BAND_LEVELS_MAX_BLOCK_SAMPLES must be a multiple of 2^(BAND_LEVELS_NB_OCTAVES - 1)"
+#endif
+
+typedef struct
+{
+    float b0, b1, b2, a1, a2; //a0 normalised to 1
+} band_levels_biquad_t;
+
+// Coefficients, shared by all channels
+typedef struct
+{
+    band_levels_biquad_t bandpass[BAND_LEVELS_BANDS_PER_OCTAVE][BAND_LEVELS_BANDPASS_SECTIONS]; //highest band first
+    band_levels_biquad_t decimation[BAND_LEVELS_DECIMATION_SECTIONS];
+    float centres_hz[BAND_LEVELS_NB_BANDS]; //lowest band first
+    float alpha;                            //weight of the newest block in the averages
+    uint32_t settle_blocks;                 //blocks for the averages to settle, two time constants
+    int nb_samples;                         //per block, at the top octave
+} band_levels_design_t;
+
+// Filter states and averages of one channel
+typedef struct
+{
+    float bandpass_z[BAND_LEVELS_NB_OCTAVES][BAND_LEVELS_BANDS_PER_OCTAVE][BAND_LEVELS_BANDPASS_SECTIONS][2];
+    float decimation_z[BAND_LEVELS_NB_OCTAVES - 1][BAND_LEVELS_DECIMATION_SECTIONS][2];
+    float mean_square[BAND_LEVELS_NB_BANDS]; //lowest band first, full scale is 1
+    uint32_t nb_blocks;
+} band_levels_channel_t;
+
+void band_levels_design(band_levels_design_t *d, float sample_rate, int nb_samples, float time_constant_ms);
+
+void band_levels_reset(band_levels_channel_t *c);
+
+// One block of d->nb_samples samples. The cost only depends on the design, never on the samples.
+void band_levels_process(const band_levels_design_t *d, band_levels_channel_t *c, const int16_t *samples);
+
+#endif
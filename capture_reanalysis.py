@@ -0,0 +1,253 @@
+"""Re-runs the transfer function analysis of the firmware over archived capture files.
+
+Capture files are written by capture_receiver.py. Each one is memory-mapped, its analysed
+blocks are grouped into test segments, and each segment is cut into frames the same way
+audio.cpp does: FFTSIZE samples, a Hamming window, and a hop given by the overlap. For
+every segment the four curves of audio_get_headset_tf are produced:
+
+    curve 0  OEM_L / noise    curve 1  OEM_R / noise
+    curve 2  IEM_L / noise    curve 3  IEM_R / noise
+
+in dB, 10 * log10(sum |Y|^2 / sum |X|^2) over the frames, for bins 0 to FFTSIZE / 2 - 1.
+
+Segments are split into chunks of frames, and the chunks of all files are handed out one
+at a time to a pool of worker processes, so a long capture does not hold up the others.
+Chunks return partial power sums, which add up to the same result in any order.
+
+Frames are only cut from analysed blocks, and frames touching a missing block are
+skipped, so the first frame of a segment can start a few blocks later than on the
+station.
+"""
+
+import argparse
+import multiprocessing
+import os
+import sys
+import time
+
+import numpy as np
+
+from capture_receiver import (
+    CAPTURE_FILE_HEADER,
+    CAPTURE_FILE_HEADER_SIZE,
+    CAPTURE_FILE_MAGIC,
+    CAPTURE_FILE_VERSION,
+    TEST_TYPE_NAMES,
+)
+
+FFTSIZE = 1024
+FLAG_ANALYSED = 0x01
+NB_CURVES = 4
+NOISE_CHANNEL = 4
+# Channel of each curve, in the file order OEM_L, IEM_L, OEM_R, IEM_R, delayed noise
+CURVE_CHANNELS = (0, 2, 1, 3)
+FRAMES_PER_CHUNK = 64
+
+
+def open_capture(path):
+    """Returns the header fields and the records of a capture file, memory-mapped."""
+    with open(path, "rb") as f:
+        header = CAPTURE_FILE_HEADER.unpack(f.read(CAPTURE_FILE_HEADER_SIZE))
+    magic, version, nb_channels, nb_samples, record_size, sample_rate, _ = header
+    if magic != CAPTURE_FILE_MAGIC or version != CAPTURE_FILE_VERSION:
+        raise ValueError(f"{path}: not a version {CAPTURE_FILE_VERSION} capture file")
+    if nb_channels <= NOISE_CHANNEL:
+        raise ValueError(f"{path}: {nb_channels} channels, no noise reference")
+
+    record = np.dtype(
+        [
+            ("sequence", "<u4"),
+            ("test_type", "u1"),
+            ("flags", "u1"),
+            ("valid", "u1"),
+            ("reserved", "u1"),
+            ("samples", "<i2", (nb_channels, nb_samples)),
+        ]
+    )
+    if record.itemsize != record_size:
+        raise ValueError(f"{path}: record size {record_size}, expected {record.itemsize}")
+
+    nb_records = (os.path.getsize(path) - CAPTURE_FILE_HEADER_SIZE) // record_size
+    records = np.memmap(
+        path, dtype=record, mode="r", offset=CAPTURE_FILE_HEADER_SIZE, shape=(nb_records,)
+    )
+    return sample_rate, nb_samples, records
+
+
+def find_segments(records):
+    """Runs of analysed blocks of the same test, as (test_type, first, end) ranges.
+
+    Missing blocks carry no flags, they stay inside the run they interrupt.
+    """
+    analysed = (records["flags"] & FLAG_ANALYSED) != 0
+    valid = records["valid"] != 0
+    test_types = records["test_type"]
+
+    segments = []
+    first = None
+    last = None
+    for i in range(len(records) + 1):
+        if i < len(records) and not valid[i]:
+            continue
+        in_segment = i < len(records) and analysed[i]
+        if first is not None and (not in_segment or test_types[i] != test_types[first]):
+            segments.append((int(test_types[first]), first, last + 1))
+            first = None
+        if in_segment:
+            if first is None:
+                first = i
+            last = i
+    return segments
+
+
+def frame_starts(records, first, end, nb_blocks, hop_blocks):
+    """First blocks of the frames of a segment, leaving out frames with missing blocks."""
+    valid = records["valid"][first:end] != 0
+    starts = []
+    for start in range(0, end - first - nb_blocks + 1, hop_blocks):
+        if valid[start : start + nb_blocks].all():
+            starts.append(first + start)
+    return starts
+
+
+def accumulate_chunk(task):
+    """Power sums of a chunk of frames, one row per channel."""
+    path, segment_index, starts, fft_size = task
+    _, nb_samples, records = open_capture(path)
+    nb_blocks = fft_size // nb_samples
+    window = np.hamming(fft_size)
+
+    # (blocks, channels, samples) to (frames, channels, frame samples)
+    frames = np.stack(
+        [
+            records["samples"][start : start + nb_blocks]
+            .transpose(1, 0, 2)
+            .reshape(-1, fft_size)
+            for start in starts
+        ]
+    )
+    spectrum = np.fft.rfft(frames * window, axis=-1)[..., : fft_size // 2]
+    sums = (spectrum.real**2 + spectrum.imag**2).sum(axis=0)
+    return path, segment_index, sums
+
+
+def plan(paths, fft_size, overlap_percent, frames_per_chunk):
+    """Chunks of work for all files, and the segments they add up to."""
+    tasks = []
+    segments = {}
+    for path in paths:
+        _, nb_samples, records = open_capture(path)
+        nb_blocks = fft_size // nb_samples
+        hop_blocks = (nb_blocks * (100 - overlap_percent)) // 100
+
+        segments[path] = []
+        for test_type, first, end in find_segments(records):
+            starts = frame_starts(records, first, end, nb_blocks, hop_blocks)
+            segment_index = len(segments[path])
+            segments[path].append(
+                {
+                    "test_type": test_type,
+                    "first": first,
+                    "nb_frames": len(starts),
+                    "sums": None,
+                }
+            )
+            for i in range(0, len(starts), frames_per_chunk):
+                chunk = starts[i : i + frames_per_chunk]
+                tasks.append((path, segment_index, chunk, fft_size))
+    return tasks, segments
+
+
+def reanalyse(paths, fft_size=FFTSIZE, overlap_percent=0, jobs=None):
+    """Curves of every test segment of every capture, as {path: [segment, ...]}."""
+    tasks, segments = plan(paths, fft_size, overlap_percent, FRAMES_PER_CHUNK)
+
+    with multiprocessing.Pool(jobs) as pool:
+        for path, segment_index, sums in pool.imap_unordered(accumulate_chunk, tasks):
+            segment = segments[path][segment_index]
+            segment["sums"] = sums if segment["sums"] is None else segment["sums"] + sums
+
+    for path_segments in segments.values():
+        for segment in path_segments:
+            sums = segment.pop("sums")
+            if sums is None:
+                segment["curves"] = None
+                continue
+            segment["curves"] = np.array(
+                [
+                    10.0 * np.log10(sums[CURVE_CHANNELS[c]] / sums[NOISE_CHANNEL])
+                    for c in range(NB_CURVES)
+                ]
+            )
+    return segments
+
+
+def write_curves(path, segments, output_dir, sample_rate, fft_size):
+    """One CSV per test segment: bin, frequency, then the four curves in dB."""
+    base = os.path.splitext(os.path.basename(path))[0]
+    freqs = np.arange(fft_size // 2) * sample_rate / fft_size
+    for segment in segments:
+        if segment["curves"] is None:
+            continue
+        name = TEST_TYPE_NAMES.get(segment["test_type"], str(segment["test_type"]))
+        out = os.path.join(output_dir, f"{base}.test{name}.{segment['first']}.csv")
+        table = np.column_stack([np.arange(fft_size // 2), freqs, segment["curves"].T])
+        np.savetxt(
+            out,
+            table,
+            delimiter=",",
+            fmt=["%d", "%.1f"] + ["%.3f"] * NB_CURVES,
+            header="bin,freq_hz,oem_l,oem_r,iem_l,iem_r",
+            comments="",
+        )
+
+
+def bench(paths, fft_size, overlap_percent, jobs):
+    """Captures per second with one worker, then with all of them."""
+    nb_jobs = jobs or os.cpu_count()
+    results = []
+    for n in sorted({1, nb_jobs}):
+        start = time.perf_counter()
+        segments = reanalyse(paths, fft_size, overlap_percent, n)
+        elapsed = time.perf_counter() - start
+        nb_frames = sum(s["nb_frames"] for segs in segments.values() for s in segs)
+        results.append((n, elapsed))
+        print(
+            f"{n:3d} workers: {len(paths) / elapsed:8.2f} captures/s, "
+            f"{nb_frames / elapsed:10.1f} frames/s"
+        )
+    if len(results) > 1:
+        speedup = results[0][1] / results[-1][1]
+        print(f"speedup {speedup:.2f}x on {nb_jobs} workers")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("captures", nargs="+", help="capture files, .ecap")
+    parser.add_argument("--output-dir", help="where to write the curves as CSV")
+    parser.add_argument("--fft-size", type=int, default=FFTSIZE)
+    parser.add_argument("--overlap", type=int, default=0, choices=(0, 50, 75))
+    parser.add_argument("--jobs", type=int, help="worker processes, all cores by default")
+    parser.add_argument("--bench", action="store_true", help="report captures per second")
+    args = parser.parse_args()
+
+    if args.bench:
+        bench(args.captures, args.fft_size, args.overlap, args.jobs)
+        return 0
+
+    segments = reanalyse(args.captures, args.fft_size, args.overlap, args.jobs)
+    for path, path_segments in segments.items():
+        sample_rate = open_capture(path)[0]
+        for segment in path_segments:
+            name = TEST_TYPE_NAMES.get(segment["test_type"], str(segment["test_type"]))
+            print(
+                f"{path}: test {name} at block {segment['first']}, "
+                f"{segment['nb_frames']} frames"
+            )
+        if args.output_dir is not None:
+            write_curves(path, path_segments, args.output_dir, sample_rate, args.fft_size)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
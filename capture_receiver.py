@@ -0,0 +1,249 @@
+"""Receives the raw capture stream of the audio tests and writes it to capture files.
+
+The firmware sends one frame per audio block (see capture_stream.h). Frames are checked
+and written as fixed size records, so block n of a capture is at a known offset:
+
+    file header    CAPTURE_FILE_HEADER, CAPTURE_FILE_HEADER_SIZE bytes
+    record n       CAPTURE_RECORD_HEADER, then nb_channels * nb_samples int16, channel
+                   after channel (OEM_L, IEM_L, OEM_R, IEM_R, delayed noise)
+
+Blocks dropped by the firmware, or lost to a bad checksum, are written as zero records
+with valid = 0. A sequence number going back means the stream was restarted, and the
+next blocks go to a new file.
+"""
+
+import argparse
+import struct
+import sys
+import time
+import zlib
+
+STREAM_MAGIC = 0x50414345
+STREAM_HEADER = struct.Struct("<IIHBBB3x")
+STREAM_CRC = struct.Struct("<I")
+STREAM_MAX_CHANNELS = 8
+
+CAPTURE_FILE_MAGIC = b"ECAPFILE"
+CAPTURE_FILE_VERSION = 1
+CAPTURE_FILE_HEADER = struct.Struct("<8sHHHHII8x")
+CAPTURE_FILE_HEADER_SIZE = CAPTURE_FILE_HEADER.size
+CAPTURE_RECORD_HEADER = struct.Struct("<IBBBx")
+
+DEFAULT_SAMPLE_RATE = 44100  # SAMPLE_RATE of the firmware
+MAX_SEQUENCE_GAP = 1 << 16
+
+TEST_TYPE_NAMES = {
+    0: "0",
+    1: "1",
+    2: "2A",
+    3: "2B",
+    4: "3",
+    5: "SINE_DEBUG",
+    6: "0_1_2B",
+    7: "2A_3",
+}
+
+
+class Frame:
+    def __init__(self, sequence, test_type, flags, nb_channels, nb_samples, samples):
+        self.sequence = sequence
+        self.test_type = test_type
+        self.flags = flags
+        self.nb_channels = nb_channels
+        self.nb_samples = nb_samples
+        self.samples = samples
+
+
+class FrameParser:
+    """Splits the serial byte stream into checked frames, resyncing on the magic."""
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.nb_bad_crc = 0
+        self.nb_skipped_bytes = 0
+
+    def feed(self, data):
+        self.buffer.extend(data)
+        frames = []
+        magic = struct.pack("<I", STREAM_MAGIC)
+
+        while True:
+            start = self.buffer.find(magic)
+            if start < 0:
+                # Keep what could be the beginning of a magic
+                skip = max(len(self.buffer) - (len(magic) - 1), 0)
+                self.nb_skipped_bytes += skip
+                del self.buffer[:skip]
+                break
+            if start > 0:
+                self.nb_skipped_bytes += start
+                del self.buffer[:start]
+
+            if len(self.buffer) < STREAM_HEADER.size:
+                break
+            header = STREAM_HEADER.unpack_from(self.buffer)
+            _, sequence, nb_samples, test_type, flags, nb_channels = header
+            if nb_channels > STREAM_MAX_CHANNELS:
+                self._skip_magic()
+                continue
+
+            payload_size = 2 * nb_channels * nb_samples
+            frame_size = STREAM_HEADER.size + payload_size + STREAM_CRC.size
+            if len(self.buffer) < frame_size:
+                break
+
+            (crc,) = STREAM_CRC.unpack_from(self.buffer, frame_size - STREAM_CRC.size)
+            if zlib.crc32(self.buffer[: frame_size - STREAM_CRC.size]) != crc:
+                self.nb_bad_crc += 1
+                self._skip_magic()
+                continue
+
+            payload_end = STREAM_HEADER.size + payload_size
+            samples = bytes(self.buffer[STREAM_HEADER.size : payload_end])
+            frames.append(
+                Frame(sequence, test_type, flags, nb_channels, nb_samples, samples)
+            )
+            del self.buffer[:frame_size]
+
+        return frames
+
+    def _skip_magic(self):
+        self.nb_skipped_bytes += 1
+        del self.buffer[:1]
+
+
+class CaptureWriter:
+    """Writes frames at the offset given by their sequence number."""
+
+    def __init__(self, path, nb_channels, nb_samples, sample_rate, first_sequence):
+        self.path = path
+        self.nb_channels = nb_channels
+        self.nb_samples = nb_samples
+        self.first_sequence = first_sequence
+        self.record_size = CAPTURE_RECORD_HEADER.size + 2 * nb_channels * nb_samples
+        self.nb_records = 0
+        self.nb_missing = 0
+        self.file = open(path, "wb")
+        self.file.write(
+            CAPTURE_FILE_HEADER.pack(
+                CAPTURE_FILE_MAGIC,
+                CAPTURE_FILE_VERSION,
+                nb_channels,
+                nb_samples,
+                self.record_size,
+                sample_rate,
+                first_sequence,
+            )
+        )
+
+    def accepts(self, frame):
+        gap = frame.sequence - self.first_sequence - self.nb_records
+        return (
+            frame.nb_channels == self.nb_channels
+            and frame.nb_samples == self.nb_samples
+            and 0 <= gap < MAX_SEQUENCE_GAP
+        )
+
+    def write(self, frame):
+        index = frame.sequence - self.first_sequence
+        while self.nb_records < index:
+            self._write_record(self.first_sequence + self.nb_records, 0, 0, 0, None)
+            self.nb_missing += 1
+        self._write_record(frame.sequence, frame.test_type, frame.flags, 1, frame.samples)
+
+    def _write_record(self, sequence, test_type, flags, valid, samples):
+        self.file.write(CAPTURE_RECORD_HEADER.pack(sequence, test_type, flags, valid))
+        if samples is None:
+            samples = bytes(self.record_size - CAPTURE_RECORD_HEADER.size)
+        self.file.write(samples)
+        self.nb_records += 1
+
+    def close(self):
+        self.file.close()
+
+
+def numbered_path(path, index):
+    if index == 0:
+        return path
+    stem, dot, ext = path.rpartition(".")
+    if not dot:
+        return f"{path}-{index}"
+    return f"{stem}-{index}.{ext}"
+
+
+def receive(source, output, sample_rate, duration_sec=None, read_size=1 << 16):
+    parser = FrameParser()
+    writer = None
+    nb_files = 0
+    start = time.monotonic()
+
+    try:
+        while duration_sec is None or (time.monotonic() - start) < duration_sec:
+            data = source.read(read_size)
+            if not data:
+                if getattr(source, "is_serial", False):
+                    continue
+                break
+
+            for frame in parser.feed(data):
+                if writer is None or not writer.accepts(frame):
+                    if writer is not None:
+                        report(writer)
+                        writer.close()
+                    writer = CaptureWriter(
+                        numbered_path(output, nb_files),
+                        frame.nb_channels,
+                        frame.nb_samples,
+                        sample_rate,
+                        frame.sequence,
+                    )
+                    nb_files += 1
+                writer.write(frame)
+    finally:
+        if writer is not None:
+            report(writer)
+            writer.close()
+
+    print(f"{parser.nb_bad_crc} bad frames, {parser.nb_skipped_bytes} bytes skipped")
+    return nb_files
+
+
+def report(writer):
+    print(
+        f"{writer.path}: {writer.nb_records} blocks, {writer.nb_missing} missing, "
+        f"{writer.nb_channels} channels of {writer.nb_samples} samples"
+    )
+
+
+def open_source(args):
+    if args.input is not None:
+        return open(args.input, "rb")
+
+    import serial
+
+    port = serial.Serial(args.port, args.baud, timeout=0.1)
+    port.is_serial = True
+    return port
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--port", help="serial port of the station, e.g. /dev/ttyACM0")
+    source.add_argument("--input", help="raw stream previously saved to a file")
+    parser.add_argument("--baud", type=int, default=115200, help="ignored by USB serial")
+    parser.add_argument("--output", required=True, help="capture file, .ecap")
+    parser.add_argument("--sample-rate", type=int, default=DEFAULT_SAMPLE_RATE)
+    parser.add_argument("--duration", type=float, help="seconds to record, or until EOF")
+    args = parser.parse_args()
+
+    with open_source(args) as src:
+        try:
+            receive(src, args.output, args.sample_rate, args.duration)
+        except KeyboardInterrupt:
+            pass
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
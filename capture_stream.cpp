@@ -0,0 +1,105 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+#include <Arduino.h>
+#include <stdint.h>
+
+#include "capture_stream.h"
+
+#define DEBUG_ENABLED
+#include "debug.h"
+
+static_assert(sizeof(capture_stream_header_t) == 16, "capture_stream_header_t must match capture_receiver.py");
+
+static uint32_t capture_stream_sequence;
+static uint32_t capture_stream_nb_sent;
+static uint32_t capture_stream_nb_dropped;
+
+// Nibble table of the reflected 0x04C11DB7 polynomial, small enough to stay in cache next to the audio code
+static const uint32_t crc32_nibble_table[16] = {
+    0x00000000UL, 0x1DB71064UL, 0x3B6E20C8UL, 0x26D930ACUL, 0x76DC4190UL, 0x6B6B51F4UL, 0x4DB26158UL, 0x5005713CUL,
+    0xEDB88320UL, 0xF00F9344UL, 0xD6D6A3E8UL, 0xCB61B38CUL, 0x9B64C2B0UL, 0x86D3D2D4UL, 0xA00AE278UL, 0xBDBDF21CUL,
+};
+
+// Start with crc = 0, and chain calls by passing the previous result
+uint32_t capture_stream_crc32(uint32_t crc, const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+
+    crc = ~crc;
+    for(size_t i = 0; i < len; i++)
+    {
+        crc ^= p[i];
+        crc = (crc >> 4) ^ crc32_nibble_table[crc & 0x0F];
+        crc = (crc >> 4) ^ crc32_nibble_table[crc & 0x0F];
+    }
+
+    return ~crc;
+}
+
+void capture_stream_reset(void)
+{
+    capture_stream_sequence = 0;
+    capture_stream_nb_sent = 0;
+    capture_stream_nb_dropped = 0;
+}
+
+bool capture_stream_send_block(uint8_t test_type, uint8_t flags, const int16_t *const channels[], uint8_t nb_channels,
+                               uint16_t nb_samples)
+{
+    PanicFalse(channels != NULL);
+    PanicFalse(nb_channels <= CAPTURE_STREAM_MAX_CHANNELS);
+
+    capture_stream_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = CAPTURE_STREAM_MAGIC;
+    header.sequence = capture_stream_sequence++;
+    header.nb_samples = nb_samples;
+    header.test_type = test_type;
+    header.flags = flags;
+    header.nb_channels = nb_channels;
+
+    const size_t channel_size = nb_samples * sizeof(int16_t);
+    const size_t frame_size = sizeof(header) + (nb_channels * channel_size) + sizeof(uint32_t);
+
+    // Audio comes first: rather lose a capture frame than wait for the host
+    if((size_t)Serial.availableForWrite() < frame_size)
+    {
+        capture_stream_nb_dropped++;
+        return false;
+    }
+
+    uint32_t crc = capture_stream_crc32(0, &header, sizeof(header));
+    Serial.write((const uint8_t *)&header, sizeof(header));
+    for(int c = 0; c < nb_channels; c++)
+    {
+        PanicFalse(channels[c] != NULL);
+        crc = capture_stream_crc32(crc, channels[c], channel_size);
+        Serial.write((const uint8_t *)channels[c], channel_size);
+    }
+    Serial.write((const uint8_t *)&crc, sizeof(crc));
+
+    capture_stream_nb_sent++;
+    return true;
+}
+
+uint32_t capture_stream_get_nb_sent(void)
+{
+    return capture_stream_nb_sent;
+}
+
+uint32_t capture_stream_get_nb_dropped(void)
+{
+    return capture_stream_nb_dropped;
+}
@@ -0,0 +1,54 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+#ifndef CAPTURE_STREAM_H
+#define CAPTURE_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Raw capture blocks streamed over USB serial while a test runs, received by capture_receiver.py.
+// One frame per audio block, little endian:
+//   header (capture_stream_header_t)
+//   nb_channels * nb_samples int16, one channel after the other
+//   uint32 CRC-32 (same as zlib) of the header and samples
+// The sequence number counts every block offered, so the receiver sees the blocks dropped when USB could not keep up.
+
+#define CAPTURE_STREAM_MAGIC 0x50414345UL //"ECAP" on the wire
+#define CAPTURE_STREAM_FLAG_ANALYSED 0x01 //block is part of the measurement, not of the priming
+#define CAPTURE_STREAM_MAX_CHANNELS 8
+
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;
+    uint32_t sequence;
+    uint16_t nb_samples;
+    uint8_t test_type;
+    uint8_t flags;
+    uint8_t nb_channels;
+    uint8_t reserved[3];
+} capture_stream_header_t;
+
+void capture_stream_reset(void);
+
+// Never blocks: the frame is dropped when the USB transmit buffers can not take all of it
+bool capture_stream_send_block(uint8_t test_type, uint8_t flags, const int16_t *const channels[], uint8_t nb_channels,
+                               uint16_t nb_samples);
+
+uint32_t capture_stream_get_nb_sent(void);
+uint32_t capture_stream_get_nb_dropped(void);
+
+uint32_t capture_stream_crc32(uint32_t crc, const void *data, size_t len);
+
+#endif
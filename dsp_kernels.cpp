@@ -0,0 +1,207 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "dsp_kernels.h"
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+// The kernels work on float spectra, the fixed-point build has its own integer path in audio.cpp
+#ifndef FIXED_POINT
+
+void dsp_window_q15_to_float_ref(float *dest, const int16_t *src, const float *window, int nb_samples)
+{
+    for(int i = 0; i < nb_samples; i++)
+    {
+        dest[i] = src[i] * window[i];
+    }
+}
+
+void dsp_window_pair_q15_to_cpx_ref(kiss_fft_cpx *dest, const int16_t *src_re, const int16_t *src_im,
+                                    const float *window, int nb_samples)
+{
+    for(int i = 0; i < nb_samples; i++)
+    {
+        dest[i].r = src_re[i] * window[i];
+        dest[i].i = src_im[i] * window[i];
+    }
+}
+
+void dsp_accumulate_power_ref(float *acc, const kiss_fft_cpx *src, int nb_bins)
+{
+    for(int k = 0; k < nb_bins; k++)
+    {
+        acc[k] += src[k].r * src[k].r + src[k].i * src[k].i;
+    }
+}
+
+#if defined(__ARM_FEATURE_DSP)
+// Cortex-M7: no float SIMD, but dual-issue. Samples are fetched two at a time with one 32-bit load and split with
+// sign-extending shifts, and the loops are unrolled by 4 so loads, conversions and FMAs overlap.
+static inline void load_q15_pair(const int16_t *src, float *lo, float *hi)
+{
+    int32_t packed;
+    memcpy(&packed, src, sizeof(packed)); //single LDR, src is at least 4-byte aligned at every even index
+    *lo = (float)(int16_t)packed;
+    *hi = (float)(packed >> 16);
+}
+
+void dsp_window_q15_to_float(float *dest, const int16_t *src, const float *window, int nb_samples)
+{
+    int i = 0;
+    for(; i + 4 <= nb_samples; i += 4)
+    {
+        float s0, s1, s2, s3;
+        load_q15_pair(&src[i], &s0, &s1);
+        load_q15_pair(&src[i + 2], &s2, &s3);
+        dest[i] = s0 * window[i];
+        dest[i + 1] = s1 * window[i + 1];
+        dest[i + 2] = s2 * window[i + 2];
+        dest[i + 3] = s3 * window[i + 3];
+    }
+    dsp_window_q15_to_float_ref(&dest[i], &src[i], &window[i], nb_samples - i);
+}
+
+void dsp_window_pair_q15_to_cpx(kiss_fft_cpx *dest, const int16_t *src_re, const int16_t *src_im,
+                                const float *window, int nb_samples)
+{
+    int i = 0;
+    for(; i + 2 <= nb_samples; i += 2)
+    {
+        float re0, re1, im0, im1;
+        load_q15_pair(&src_re[i], &re0, &re1);
+        load_q15_pair(&src_im[i], &im0, &im1);
+        dest[i].r = re0 * window[i];
+        dest[i].i = im0 * window[i];
+        dest[i + 1].r = re1 * window[i + 1];
+        dest[i + 1].i = im1 * window[i + 1];
+    }
+    dsp_window_pair_q15_to_cpx_ref(&dest[i], &src_re[i], &src_im[i], &window[i], nb_samples - i);
+}
+
+void dsp_accumulate_power(float *acc, const kiss_fft_cpx *src, int nb_bins)
+{
+    int k = 0;
+    for(; k + 4 <= nb_bins; k += 4)
+    {
+        acc[k] = fmaf(src[k].r, src[k].r, fmaf(src[k].i, src[k].i, acc[k]));
+        acc[k + 1] = fmaf(src[k + 1].r, src[k + 1].r, fmaf(src[k + 1].i, src[k + 1].i, acc[k + 1]));
+        acc[k + 2] = fmaf(src[k + 2].r, src[k + 2].r, fmaf(src[k + 2].i, src[k + 2].i, acc[k + 2]));
+        acc[k + 3] = fmaf(src[k + 3].r, src[k + 3].r, fmaf(src[k + 3].i, src[k + 3].i, acc[k + 3]));
+    }
+    dsp_accumulate_power_ref(&acc[k], &src[k], nb_bins - k);
+}
+
+#elif defined(__AVX2__) || defined(__SSE4_1__)
+// Host builds
+void dsp_window_q15_to_float(float *dest, const int16_t *src, const float *window, int nb_samples)
+{
+    int i = 0;
+#if defined(__AVX2__)
+    for(; i + 8 <= nb_samples; i += 8)
+    {
+        const __m256i s = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)&src[i]));
+        _mm256_storeu_ps(&dest[i], _mm256_mul_ps(_mm256_cvtepi32_ps(s), _mm256_loadu_ps(&window[i])));
+    }
+#endif
+    for(; i + 4 <= nb_samples; i += 4)
+    {
+        const __m128i s = _mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i *)&src[i]));
+        _mm_storeu_ps(&dest[i], _mm_mul_ps(_mm_cvtepi32_ps(s), _mm_loadu_ps(&window[i])));
+    }
+    dsp_window_q15_to_float_ref(&dest[i], &src[i], &window[i], nb_samples - i);
+}
+
+void dsp_window_pair_q15_to_cpx(kiss_fft_cpx *dest, const int16_t *src_re, const int16_t *src_im,
+                                const float *window, int nb_samples)
+{
+    float *out = (float *)dest; //kiss_fft_cpx is {r, i} in float
+    int i = 0;
+#if defined(__AVX2__)
+    for(; i + 8 <= nb_samples; i += 8)
+    {
+        const __m256 w = _mm256_loadu_ps(&window[i]);
+        const __m256i s_re = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)&src_re[i]));
+        const __m256i s_im = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)&src_im[i]));
+        const __m256 re = _mm256_mul_ps(_mm256_cvtepi32_ps(s_re), w);
+        const __m256 im = _mm256_mul_ps(_mm256_cvtepi32_ps(s_im), w);
+        // unpack interleaves per 128-bit lane: samples 0 1 4 5 and 2 3 6 7
+        const __m256 lo = _mm256_unpacklo_ps(re, im);
+        const __m256 hi = _mm256_unpackhi_ps(re, im);
+        _mm256_storeu_ps(&out[2 * i], _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(&out[2 * i + 8], _mm256_permute2f128_ps(lo, hi, 0x31));
+    }
+#endif
+    for(; i + 4 <= nb_samples; i += 4)
+    {
+        const __m128 w = _mm_loadu_ps(&window[i]);
+        const __m128i s_re = _mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i *)&src_re[i]));
+        const __m128i s_im = _mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i *)&src_im[i]));
+        const __m128 re = _mm_mul_ps(_mm_cvtepi32_ps(s_re), w);
+        const __m128 im = _mm_mul_ps(_mm_cvtepi32_ps(s_im), w);
+        _mm_storeu_ps(&out[2 * i], _mm_unpacklo_ps(re, im));
+        _mm_storeu_ps(&out[2 * i + 4], _mm_unpackhi_ps(re, im));
+    }
+    dsp_window_pair_q15_to_cpx_ref(&dest[i], &src_re[i], &src_im[i], &window[i], nb_samples - i);
+}
+
+void dsp_accumulate_power(float *acc, const kiss_fft_cpx *src, int nb_bins)
+{
+    const float *in = (const float *)src;
+    int k = 0;
+#if defined(__AVX2__)
+    for(; k + 8 <= nb_bins; k += 8)
+    {
+        const __m256 a = _mm256_loadu_ps(&in[2 * k]);
+        const __m256 b = _mm256_loadu_ps(&in[2 * k + 8]);
+        // hadd pairs up r^2 + i^2 per 128-bit lane, giving bins 0 1 4 5 | 2 3 6 7
+        const __m256 p = _mm256_hadd_ps(_mm256_mul_ps(a, a), _mm256_mul_ps(b, b));
+        const __m256 ordered = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(p), _MM_SHUFFLE(3, 1, 2, 0)));
+        _mm256_storeu_ps(&acc[k], _mm256_add_ps(_mm256_loadu_ps(&acc[k]), ordered));
+    }
+#endif
+    for(; k + 4 <= nb_bins; k += 4)
+    {
+        const __m128 a = _mm_loadu_ps(&in[2 * k]);
+        const __m128 b = _mm_loadu_ps(&in[2 * k + 4]);
+        const __m128 p = _mm_hadd_ps(_mm_mul_ps(a, a), _mm_mul_ps(b, b));
+        _mm_storeu_ps(&acc[k], _mm_add_ps(_mm_loadu_ps(&acc[k]), p));
+    }
+    dsp_accumulate_power_ref(&acc[k], &src[k], nb_bins - k);
+}
+
+#else
+void dsp_window_q15_to_float(float *dest, const int16_t *src, const float *window, int nb_samples)
+{
+    dsp_window_q15_to_float_ref(dest, src, window, nb_samples);
+}
+
+void dsp_window_pair_q15_to_cpx(kiss_fft_cpx *dest, const int16_t *src_re, const int16_t *src_im,
+                                const float *window, int nb_samples)
+{
+    dsp_window_pair_q15_to_cpx_ref(dest, src_re, src_im, window, nb_samples);
+}
+
+void dsp_accumulate_power(float *acc, const kiss_fft_cpx *src, int nb_bins)
+{
+    dsp_accumulate_power_ref(acc, src, nb_bins);
+}
+#endif
+
+#endif
@@ -0,0 +1,39 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+#ifndef DSP_KERNELS_H
+#define DSP_KERNELS_H
+
+#include <stdint.h>
+
+#include "src/kissfft/kiss_fftr.h"
+
+// Fused per-frame kernels of the float analysis path. The plain functions pick the best variant for the target at
+// compile time (Cortex-M7 DSP, AVX2, SSE4.1, or scalar); the _ref functions are the scalar references they must match.
+
+// dest[i] = src[i] * window[i], the window already including the q1.15 to float scaling
+void dsp_window_q15_to_float(float *dest, const int16_t *src, const float *window, int nb_samples);
+void dsp_window_q15_to_float_ref(float *dest, const int16_t *src, const float *window, int nb_samples);
+
+// Same, for two real channels going to the real and imaginary parts of a complex buffer
+void dsp_window_pair_q15_to_cpx(kiss_fft_cpx *dest, const int16_t *src_re, const int16_t *src_im,
+                                const float *window, int nb_samples);
+void dsp_window_pair_q15_to_cpx_ref(kiss_fft_cpx *dest, const int16_t *src_re, const int16_t *src_im,
+                                    const float *window, int nb_samples);
+
+// acc[k] += |src[k]|^2
+void dsp_accumulate_power(float *acc, const kiss_fft_cpx *src, int nb_bins);
+void dsp_accumulate_power_ref(float *acc, const kiss_fft_cpx *src, int nb_bins);
+
+#endif
@@ -0,0 +1,229 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+// Benchmark of the analysis chain on the host, built with AUDIO_PROFILING. Every test function runs for real with each
+// excitation, in virtual time on the acoustic model of the stand-ins, and reports per run:
+//   frames     frames analysed (tests stop early on convergence)
+//   frames/s   frames over the CPU time of the whole run: priming, latency burst, capture, analysis and judging,
+//              without the audio library updates, which stand for the interrupts of the target
+//   ns/frame   FFT, sparse filter and accumulation time per frame
+//   stages     mean ns of each profiled stage, see profile_stage_t
+//   heap/fr    heap allocations per frame, which must stay 0
+//   blocks/fr  audio library blocks allocated per frame (the I2S input and the play queues, from the pool)
+//   arena      arena phase changes of the run
+// Then audio_run_analysis_benchmark() times the analysis alone per excitation, on nb_frames frames (argument, 200 by
+// default), and audio_run_sparse_benchmark() the sparse analysis against the full one for 1 to SPARSE_MAX_BINS bins.
+// Exits with an error when a run allocated from the heap or a test did not pass.
+
+#include "audio.cpp"
+
+#include <stdlib.h>
+
+#include "host_test.h"
+
+typedef enum
+{
+    EXCITATION_PINK_NOISE,
+    EXCITATION_SWEEP,
+    EXCITATION_MULTISINE,
+    EXCITATION_SPARSE,
+    NB_EXCITATIONS,
+} excitation_t;
+
+static const char *const excitation_names[NB_EXCITATIONS] = {"pink", "sweep", "multisine", "sparse"};
+
+// Octave centres, for the sparse analysis
+static const float sparse_freqs_hz[] = {125.0f, 250.0f, 500.0f, 1000.0f, 2000.0f, 4000.0f, 8000.0f};
+
+static stray_test_result_t results[6];
+
+static bool RunTest0(void)
+{
+    return audio_run_test0(&results[0], &results[1]);
+}
+
+static bool RunTest1(void)
+{
+    return audio_run_test1(&results[0], &results[1]);
+}
+
+static bool RunTest2A(void)
+{
+    return audio_run_test2a(&results[0], &results[1], &results[2], &results[3]);
+}
+
+static bool RunTest2B(void)
+{
+    return audio_run_test2b(&results[0], &results[1]);
+}
+
+static bool RunTest3(void)
+{
+    return audio_run_test3(&results[0], &results[1]);
+}
+
+static bool RunTestSPK(void)
+{
+    return audio_run_test0_1_2b(&results[0], &results[1], &results[2], &results[3], &results[4], &results[5]);
+}
+
+static bool RunTestCAL(void)
+{
+    return audio_run_test2a_3(&results[0], &results[1], &results[2], &results[3], &results[4], &results[5]);
+}
+
+typedef struct
+{
+    const char *name;
+    bool (*run)(void);
+    int nb_results;
+} bench_test_t;
+
+static const bench_test_t tests[] = {
+    {"0", RunTest0, 2},     {"1", RunTest1, 2},     {"2A", RunTest2A, 4},   {"2B", RunTest2B, 2},
+    {"3", RunTest3, 2},     {"SPK", RunTestSPK, 6}, {"CAL", RunTestCAL, 6},
+};
+
+static uint64_t idle_ns;
+
+static uint64_t NowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+// The audio update of the target runs in interrupts, it is not part of the chain's time
+static void TimedAudioBlock(void)
+{
+    const uint64_t start_ns = NowNs();
+    host_audio_block();
+    idle_ns += NowNs() - start_ns;
+}
+
+static void SetExcitation(excitation_t excitation)
+{
+    audio_set_sweep_excitation(excitation == EXCITATION_SWEEP);
+    audio_set_multisine_excitation(excitation == EXCITATION_MULTISINE);
+    if(excitation == EXCITATION_SPARSE)
+    {
+        audio_set_sparse_frequencies(sparse_freqs_hz, sizeof(sparse_freqs_hz) / sizeof(sparse_freqs_hz[0]));
+    }
+    else
+    {
+        audio_set_sparse_frequencies(NULL, 0);
+    }
+}
+
+static uint32_t StageMeanNs(profile_stage_t stage)
+{
+    const profile_stats_t *stats = &profile_stats[stage];
+
+    return (stats->nb > 0) ? (uint32_t)(((stats->sum * 1000) / PROFILE_TICKS_PER_US) / stats->nb) : 0;
+}
+
+// Returns false when the run allocated from the heap or a result did not pass
+static bool BenchmarkTest(const bench_test_t *test, excitation_t excitation)
+{
+    SetExcitation(excitation);
+
+    const uint32_t heap_start = host_get_nb_heap_allocations();
+    const uint32_t blocks_start = AudioStream::nb_allocations;
+    idle_ns = 0;
+
+    const uint64_t start_ns = NowNs();
+    const bool completed = test->run();
+    const float(*curves)[FFTSIZE / 2] = NULL;
+    const unsigned nb_curves = audio_get_headset_tf_curves(&curves); //fills the TF cache, profiled as get_tf
+    const uint64_t busy_ns = NowNs() - start_ns - idle_ns;
+
+    const int nb_frames = audio_get_last_test_nb_frames();
+    const uint32_t nb_heap = host_get_nb_heap_allocations() - heap_start;
+    const uint32_t nb_blocks = AudioStream::nb_allocations - blocks_start;
+    const uint64_t analysis_ticks = profile_stats[PROFILE_STAGE_FFT].sum +
+                                    profile_stats[PROFILE_STAGE_SPARSE_FILTERS].sum +
+                                    profile_stats[PROFILE_STAGE_ACCUMULATE].sum;
+
+    bool passed = completed && (nb_frames > 0) && (nb_curves > 0) && (nb_heap == 0);
+    for(int r = 0; r < test->nb_results; r++)
+    {
+        passed = passed && (results[r] == STRAY_RESULT_SUCCESS);
+    }
+
+    printf("%-4s %-10s %6d %9lu %9lu %8lu %8lu %8lu %8lu %8lu %8lu %8lu %7.2f %9.2f %5d%s\n", test->name,
+           excitation_names[excitation], nb_frames,
+           (unsigned long)((busy_ns > 0) ? (((uint64_t)nb_frames * 1000000000ULL) / busy_ns) : 0),
+           (unsigned long)(((analysis_ticks * 1000) / PROFILE_TICKS_PER_US) / nb_frames),
+           (unsigned long)StageMeanNs(PROFILE_STAGE_CAPTURE), (unsigned long)StageMeanNs(PROFILE_STAGE_PINK_NOISE),
+           (unsigned long)StageMeanNs(PROFILE_STAGE_PINK_NOISE_DELAYED), (unsigned long)StageMeanNs(PROFILE_STAGE_FFT),
+           (unsigned long)StageMeanNs(PROFILE_STAGE_SPARSE_FILTERS),
+           (unsigned long)StageMeanNs(PROFILE_STAGE_ACCUMULATE), (unsigned long)StageMeanNs(PROFILE_STAGE_GET_TF),
+           (double)nb_heap / nb_frames, (double)nb_blocks / nb_frames, profile_nb_arena_phase_changes,
+           passed ? "" : "  FAILED");
+
+    return passed;
+}
+
+int main(int argc, char **argv)
+{
+    const int nb_frames = (argc > 1) ? atoi(argv[1]) : 200;
+    PanicFalse(nb_frames > 0);
+
+    host_mute_console(true);
+    audio_set_idle_callback(TimedAudioBlock); //audio_initialise measures the latency
+    audio_initialise();
+    audio_set_headset_connected(true);
+    audio_set_headset_eeprom_alive(true);
+
+    printf("FFTSIZE %d, %s, hop %d blocks, budget %lu us per frame\n", FFTSIZE,
+#ifdef FIXED_POINT
+           (FIXED_POINT == 32) ? "q31" : "q15",
+#else
+           "float",
+#endif
+           FFT_HOP_BLOCKS, (unsigned long)(FFT_HOP_BLOCKS * AUDIO_BLOCK_PERIOD_US));
+    printf("test excitation frames  frames/s  ns/frame  capture     pink  pink_dl      fft   sparse accumulate  get_tf"
+           " heap/fr blocks/fr arena\n");
+
+    bool passed = true;
+    for(unsigned t = 0; t < (sizeof(tests) / sizeof(tests[0])); t++)
+    {
+        for(int excitation = 0; excitation < NB_EXCITATIONS; excitation++)
+        {
+            passed = BenchmarkTest(&tests[t], (excitation_t)excitation) && passed;
+        }
+    }
+    SetExcitation(EXCITATION_PINK_NOISE);
+
+    printf("\nanalysis alone, %d frames per excitation:\n", nb_frames);
+    host_mute_console(false);
+    audio_run_analysis_benchmark(nb_frames);
+
+    // Bins 100 Hz apart, more than a bin width, up to where the filters cost as much as the transforms
+    printf("\nsparse analysis alone, %d frames per number of bins:\n", nb_frames);
+    float freqs_hz[SPARSE_MAX_BINS];
+    for(int f = 0; f < SPARSE_MAX_BINS; f++)
+    {
+        freqs_hz[f] = 100.0f * (f + 1);
+    }
+    for(int nb_bins = 1; nb_bins <= SPARSE_MAX_BINS; nb_bins *= 2)
+    {
+        PanicFalse(audio_set_sparse_frequencies(freqs_hz, nb_bins) == nb_bins);
+        audio_run_sparse_benchmark(nb_frames);
+    }
+    audio_set_sparse_frequencies(NULL, 0);
+
+    printf("%s\n", passed ? "passed" : "FAILED");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+// Time of the DSP kernels of one float analysis frame, against their scalar references: two paired windows, one
+// window and five power accumulations, as in RunAnalysisStep with paired channels. Each gets the best of
+// NB_ROUNDS rounds, alternating with its reference. Argument: number of frames per round, 20000 by default.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "dsp_kernels.h"
+
+#define NB_ROUNDS 5
+
+#ifndef FFTSIZE
+#define FFTSIZE 1024
+#endif
+
+static int16_t src_re[FFTSIZE];
+static int16_t src_im[FFTSIZE];
+static float window[FFTSIZE];
+static float dest[FFTSIZE];
+static kiss_fft_cpx dest_cpx[FFTSIZE];
+static kiss_fft_cpx spectrum[FFTSIZE / 2];
+static float acc[FFTSIZE / 2];
+
+static uint64_t NowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static void WindowPair(void)
+{
+    dsp_window_pair_q15_to_cpx(dest_cpx, src_re, src_im, window, FFTSIZE);
+    dsp_window_pair_q15_to_cpx(dest_cpx, src_im, src_re, window, FFTSIZE);
+}
+
+static void WindowPairRef(void)
+{
+    dsp_window_pair_q15_to_cpx_ref(dest_cpx, src_re, src_im, window, FFTSIZE);
+    dsp_window_pair_q15_to_cpx_ref(dest_cpx, src_im, src_re, window, FFTSIZE);
+}
+
+static void Window(void)
+{
+    dsp_window_q15_to_float(dest, src_re, window, FFTSIZE);
+}
+
+static void WindowRef(void)
+{
+    dsp_window_q15_to_float_ref(dest, src_re, window, FFTSIZE);
+}
+
+static void Accumulate(void)
+{
+    for(int c = 0; c < 5; c++)
+    {
+        dsp_accumulate_power(acc, spectrum, FFTSIZE / 2);
+    }
+}
+
+static void AccumulateRef(void)
+{
+    for(int c = 0; c < 5; c++)
+    {
+        dsp_accumulate_power_ref(acc, spectrum, FFTSIZE / 2);
+    }
+}
+
+static uint64_t NsPerFrame(void (*kernels)(void), int nb_frames)
+{
+    const uint64_t start_ns = NowNs();
+    for(int n = 0; n < nb_frames; n++)
+    {
+        kernels();
+        __asm__ volatile("" : : "r"(dest), "r"(dest_cpx), "r"(acc) : "memory"); //keeps every frame
+    }
+    return (NowNs() - start_ns) / nb_frames;
+}
+
+static void Benchmark(const char *name, void (*kernels)(void), void (*kernels_ref)(void), int nb_frames)
+{
+    uint64_t ns = UINT64_MAX;
+    uint64_t ns_ref = UINT64_MAX;
+    for(int round = 0; round < NB_ROUNDS; round++)
+    {
+        const uint64_t round_ns = NsPerFrame(kernels, nb_frames);
+        const uint64_t round_ns_ref = NsPerFrame(kernels_ref, nb_frames);
+        ns = (round_ns < ns) ? round_ns : ns;
+        ns_ref = (round_ns_ref < ns_ref) ? round_ns_ref : ns_ref;
+    }
+
+    printf("%-22s %7lu ns per frame, reference %7lu ns, x%.2f\n", name, (unsigned long)ns, (unsigned long)ns_ref,
+           (ns > 0) ? ((double)ns_ref / ns) : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+    const int nb_frames = (argc > 1) ? atoi(argv[1]) : 20000;
+    if(nb_frames <= 0)
+    {
+        return 1;
+    }
+
+    srand(1);
+    for(int i = 0; i < FFTSIZE; i++)
+    {
+        src_re[i] = (int16_t)((rand() % 65536) - 32768);
+        src_im[i] = (int16_t)((rand() % 65536) - 32768);
+        window[i] = (0.54f - (0.46f * cosf((2.0f * (float)M_PI * i) / FFTSIZE))) / 32768.0f;
+    }
+    for(int k = 0; k < (FFTSIZE / 2); k++)
+    {
+        spectrum[k].r = ((float)rand() / RAND_MAX) - 0.5f;
+        spectrum[k].i = ((float)rand() / RAND_MAX) - 0.5f;
+    }
+
+    printf("FFTSIZE %d, %s kernels, %d frames\n", FFTSIZE,
+#if defined(__ARM_FEATURE_DSP)
+           "Cortex-M7",
+#elif defined(__AVX2__)
+           "AVX2",
+#elif defined(__SSE4_1__)
+           "SSE4.1",
+#else
+           "scalar",
+#endif
+           nb_frames);
+    Benchmark("2 x window pair", WindowPair, WindowPairRef, nb_frames);
+    Benchmark("1 x window", Window, WindowRef, nb_frames);
+    Benchmark("5 x accumulate power", Accumulate, AccumulateRef, nb_frames);
+    return 0;
+}
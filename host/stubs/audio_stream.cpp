@@ -0,0 +1,553 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+#include <Arduino.h>
+#include <Audio.h>
+#include <math.h>
+#include <string.h>
+
+#include "debug.h"
+#include "host_stubs.h"
+
+// Same allocation, routing and queueing as the Teensy audio library, without the DMA and the software interrupt
+
+#define SPEAKER_HISTORY_SAMPLES 8192 //longer than any delay of the acoustic model, power of 2
+
+AudioStream *AudioStream::first_update = NULL;
+uint16_t AudioStream::memory_used = 0;
+uint16_t AudioStream::memory_used_max = 0;
+uint32_t AudioStream::nb_allocations = 0;
+
+static audio_block_t memory_pool[AUDIO_MEMORY_MAX_BLOCKS];
+static bool memory_pool_used[AUDIO_MEMORY_MAX_BLOCKS];
+static unsigned int memory_pool_size;
+
+static int interrupts_masked;
+static uint32_t nb_audio_blocks;
+
+float AudioControlSGTL5000::volume_of_shield[2];
+
+static host_acoustics_t acoustics;
+static bool acoustics_set;
+static uint32_t acoustics_rng = 1;
+
+// Output samples of the I2S outputs, at the index of the audio block they were played in
+static int16_t speaker_history[4][SPEAKER_HISTORY_SAMPLES];
+static uint32_t speaker_next_sample;
+
+AudioStream::AudioStream(unsigned char ninput, audio_block_t **iqueue)
+    : active(false), num_inputs(ninput), inputQueue(iqueue), destination_list(NULL), next_update(NULL)
+{
+    for(int i = 0; i < num_inputs; i++)
+    {
+        inputQueue[i] = NULL;
+    }
+
+    if(first_update == NULL)
+    {
+        first_update = this;
+    }
+    else
+    {
+        AudioStream *p = first_update;
+        while(p->next_update != NULL)
+        {
+            p = p->next_update;
+        }
+        p->next_update = this;
+    }
+}
+
+void AudioStream::update_all(void)
+{
+    for(AudioStream *p = first_update; p != NULL; p = p->next_update)
+    {
+        if(p->active)
+        {
+            p->update();
+        }
+    }
+}
+
+void AudioStream::initialize_memory(unsigned int num)
+{
+    PanicFalse(num <= AUDIO_MEMORY_MAX_BLOCKS);
+    PanicFalse(memory_used == 0);
+
+    memory_pool_size = num;
+    for(unsigned int i = 0; i < num; i++)
+    {
+        memory_pool[i].memory_pool_index = (uint16_t)i;
+        memory_pool_used[i] = false;
+    }
+}
+
+audio_block_t *AudioStream::allocate(void)
+{
+    for(unsigned int i = 0; i < memory_pool_size; i++)
+    {
+        if(!memory_pool_used[i])
+        {
+            memory_pool_used[i] = true;
+            memory_pool[i].ref_count = 1;
+            memory_used++;
+            if(memory_used > memory_used_max)
+            {
+                memory_used_max = memory_used;
+            }
+            nb_allocations++;
+            return &memory_pool[i];
+        }
+    }
+
+    return NULL;
+}
+
+void AudioStream::release(audio_block_t *block)
+{
+    PanicFalse(block != NULL);
+    PanicFalse(block->ref_count > 0);
+
+    if(block->ref_count > 1)
+    {
+        block->ref_count--;
+    }
+    else
+    {
+        block->ref_count = 0;
+        memory_pool_used[block->memory_pool_index] = false;
+        memory_used--;
+    }
+}
+
+void AudioStream::transmit(audio_block_t *block, unsigned char index)
+{
+    for(AudioConnection *c = destination_list; c != NULL; c = c->next_dest)
+    {
+        if((c->src_index == index) && (c->dst.inputQueue[c->dest_index] == NULL))
+        {
+            c->dst.inputQueue[c->dest_index] = block;
+            block->ref_count++;
+        }
+    }
+}
+
+audio_block_t *AudioStream::receiveReadOnly(unsigned int index)
+{
+    if(index >= num_inputs)
+    {
+        return NULL;
+    }
+
+    audio_block_t *in = inputQueue[index];
+    inputQueue[index] = NULL;
+
+    return in;
+}
+
+audio_block_t *AudioStream::receiveWritable(unsigned int index)
+{
+    audio_block_t *in = receiveReadOnly(index);
+    if((in != NULL) && (in->ref_count > 1))
+    {
+        audio_block_t *p = allocate();
+        if(p != NULL)
+        {
+            memcpy(p->data, in->data, sizeof(p->data));
+        }
+        in->ref_count--;
+        in = p;
+    }
+
+    return in;
+}
+
+AudioConnection::AudioConnection(AudioStream &source, unsigned char sourceOutput, AudioStream &destination,
+                                 unsigned char destinationInput)
+    : src(source), dst(destination), src_index(sourceOutput), dest_index(destinationInput), next_dest(NULL)
+{
+    PanicFalse(destinationInput < destination.num_inputs);
+
+    if(src.destination_list == NULL)
+    {
+        src.destination_list = this;
+    }
+    else
+    {
+        AudioConnection *p = src.destination_list;
+        while(p->next_dest != NULL)
+        {
+            p = p->next_dest;
+        }
+        p->next_dest = this;
+    }
+    src.active = true;
+    dst.active = true;
+}
+
+int AudioRecordQueue::available(void)
+{
+    uint32_t h = head;
+    uint32_t t = tail;
+
+    return (h >= t) ? (h - t) : (max_buffers + h - t);
+}
+
+void AudioRecordQueue::clear(void)
+{
+    if(userblock != NULL)
+    {
+        release(userblock);
+        userblock = NULL;
+    }
+
+    uint32_t t = tail;
+    while(t != head)
+    {
+        if(++t >= max_buffers)
+        {
+            t = 0;
+        }
+        release(queue[t]);
+    }
+    tail = t;
+}
+
+int16_t *AudioRecordQueue::readBuffer(void)
+{
+    if(userblock != NULL)
+    {
+        return NULL;
+    }
+
+    uint32_t t = tail;
+    if(t == head)
+    {
+        return NULL;
+    }
+    if(++t >= max_buffers)
+    {
+        t = 0;
+    }
+    userblock = queue[t];
+    tail = t;
+
+    return userblock->data;
+}
+
+void AudioRecordQueue::freeBuffer(void)
+{
+    if(userblock == NULL)
+    {
+        return;
+    }
+    release(userblock);
+    userblock = NULL;
+}
+
+void AudioRecordQueue::update(void)
+{
+    audio_block_t *block = receiveReadOnly();
+    if(block == NULL)
+    {
+        return;
+    }
+    if(!enabled)
+    {
+        release(block);
+        return;
+    }
+
+    uint32_t h = head + 1;
+    if(h >= max_buffers)
+    {
+        h = 0;
+    }
+    if(h == tail)
+    {
+        release(block);
+    }
+    else
+    {
+        queue[h] = block;
+        head = h;
+    }
+}
+
+// The library waits for a free block or queue slot with the audio interrupt running. Here nothing would free one.
+int16_t *AudioPlayQueue::getBuffer(void)
+{
+    if(userblock == NULL)
+    {
+        userblock = allocate();
+        PanicFalse(userblock != NULL);
+    }
+
+    return userblock->data;
+}
+
+void AudioPlayQueue::playBuffer(void)
+{
+    if(userblock == NULL)
+    {
+        return;
+    }
+
+    uint32_t h = head + 1;
+    if(h >= max_buffers)
+    {
+        h = 0;
+    }
+    PanicFalse(h != tail);
+    queue[h] = userblock;
+    head = h;
+    userblock = NULL;
+}
+
+void AudioPlayQueue::update(void)
+{
+    uint32_t t = tail;
+    if(t == head)
+    {
+        return;
+    }
+    if(++t >= max_buffers)
+    {
+        t = 0;
+    }
+    audio_block_t *block = queue[t];
+    tail = t;
+    transmit(block);
+    release(block);
+}
+
+bool AudioAnalyzeRMS::available(void)
+{
+    return new_output;
+}
+
+float AudioAnalyzeRMS::read(void)
+{
+    AudioNoInterrupts();
+    const int64_t sum = accum;
+    const uint32_t num = count;
+    accum = 0;
+    count = 0;
+    new_output = false;
+    AudioInterrupts();
+
+    return (num > 0) ? (sqrtf((float)sum / (float)num) / 32767.0f) : 0.0f;
+}
+
+void AudioAnalyzeRMS::update(void)
+{
+    audio_block_t *block = receiveReadOnly();
+    if(block == NULL)
+    {
+        return;
+    }
+    for(int i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+    {
+        accum += (int32_t)block->data[i] * block->data[i];
+    }
+    count += AUDIO_BLOCK_SAMPLES;
+    new_output = true;
+    release(block);
+}
+
+void AudioSynthWaveformSine::frequency(float freq)
+{
+    phase_increment = 2.0 * M_PI * freq / AUDIO_SAMPLE_RATE_EXACT;
+}
+
+void AudioSynthWaveformSine::amplitude(float n)
+{
+    magnitude = n;
+}
+
+void AudioSynthWaveformSine::update(void)
+{
+    if(magnitude == 0.0f)
+    {
+        return;
+    }
+    audio_block_t *block = allocate();
+    if(block == NULL)
+    {
+        return;
+    }
+    for(int i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+    {
+        block->data[i] = (int16_t)lrint(32767.0 * magnitude * sin(phase));
+        phase = fmod(phase + phase_increment, 2.0 * M_PI);
+    }
+    transmit(block);
+    release(block);
+}
+
+bool AudioControlSGTL5000::volume(float n)
+{
+    volume_of_shield[(address == LOW) ? 0 : 1] = n;
+    return true;
+}
+
+static float AcousticsNoise(void)
+{
+    acoustics_rng = (acoustics_rng * 1103515245u) + 12345u;
+    return ((float)((acoustics_rng >> 8) & 0xffff) / 32768.0f) - 1.0f;
+}
+
+static float SpeakerSample(int output, int32_t n)
+{
+    if((n < 0) || ((speaker_next_sample - (uint32_t)n) > SPEAKER_HISTORY_SAMPLES))
+    {
+        return 0.0f;
+    }
+
+    const float volume = AudioControlSGTL5000::volume_of_shield[output / 2];
+    return volume * speaker_history[output][n & (SPEAKER_HISTORY_SAMPLES - 1)] / 32768.0f;
+}
+
+// The block captured while the last output block played, as the inputs heard it
+void AudioInputI2SQuad::update(void)
+{
+    if(!acoustics_set)
+    {
+        host_get_default_acoustics(&acoustics);
+        acoustics_set = true;
+    }
+
+    audio_block_t *blocks[4];
+    for(int in = 0; in < 4; in++)
+    {
+        blocks[in] = allocate();
+        if(blocks[in] == NULL)
+        {
+            for(int i = 0; i < in; i++)
+            {
+                release(blocks[i]);
+            }
+            return;
+        }
+    }
+
+    const int32_t first_sample = (int32_t)speaker_next_sample - AUDIO_BLOCK_SAMPLES;
+    for(int in = 0; in < 4; in++)
+    {
+        for(int i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+        {
+            const int32_t n = first_sample + i - acoustics.delay_samples[in];
+            float y = 0.0f;
+            for(int out = 0; out < 4; out++)
+            {
+                if(acoustics.gain[in][out] != 0.0f)
+                {
+                    y += acoustics.gain[in][out] *
+                         (SpeakerSample(out, n) + (acoustics.echo[in] * SpeakerSample(out, n - 1)));
+                }
+            }
+            y += acoustics.square[in] * y * y;
+            y += acoustics.noise * AcousticsNoise();
+
+            const float scaled = roundf(y * 32768.0f);
+            blocks[in]->data[i] = (int16_t)fmaxf(-32768.0f, fminf(32767.0f, scaled));
+        }
+    }
+
+    for(int in = 0; in < 4; in++)
+    {
+        transmit(blocks[in], in);
+        release(blocks[in]);
+    }
+}
+
+void AudioOutputI2SQuad::update(void)
+{
+    for(int out = 0; out < 4; out++)
+    {
+        int16_t *dest = &speaker_history[out][speaker_next_sample & (SPEAKER_HISTORY_SAMPLES - 1)];
+        audio_block_t *block = receiveReadOnly(out);
+        if(block != NULL)
+        {
+            memcpy(dest, block->data, sizeof(block->data));
+            release(block);
+        }
+        else
+        {
+            memset(dest, 0, AUDIO_BLOCK_SAMPLES * sizeof(int16_t));
+        }
+    }
+    speaker_next_sample += AUDIO_BLOCK_SAMPLES;
+}
+
+void AudioNoInterrupts(void)
+{
+    interrupts_masked = 1;
+}
+
+void AudioInterrupts(void)
+{
+    interrupts_masked = 0;
+}
+
+bool host_run_audio_update(void)
+{
+    if(interrupts_masked)
+    {
+        return false;
+    }
+
+    AudioStream::update_all();
+    nb_audio_blocks++;
+    return true;
+}
+
+void host_audio_block(void)
+{
+    host_advance_us((AUDIO_BLOCK_SAMPLES * 1000000UL) / (uint32_t)AUDIO_SAMPLE_RATE_EXACT);
+    host_run_audio_update();
+}
+
+uint32_t host_get_nb_audio_blocks(void)
+{
+    return nb_audio_blocks;
+}
+
+void host_get_default_acoustics(host_acoustics_t *dest)
+{
+    memset(dest, 0, sizeof(*dest));
+
+    // Inputs 0 and 1 are the right earpiece, outputs 1 and 3 its speakers
+    for(int in = 0; in < 4; in++)
+    {
+        const bool right = (in < 2);
+        for(int out = 0; out < 4; out++)
+        {
+            dest->gain[in][out] = (right == ((out % 2) == 1)) ? 0.5f : 0.25f;
+        }
+        dest->delay_samples[in] = 200;
+    }
+    dest->noise = 0.001f;
+}
+
+void host_set_acoustics(const host_acoustics_t *src)
+{
+    acoustics = *src;
+    acoustics_set = true;
+}
+
+void host_reseed_acoustics(uint32_t seed)
+{
+    acoustics_rng = seed;
+}
@@ -0,0 +1,92 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+#ifndef AUDIO_MODULE_H
+#define AUDIO_MODULE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "analysis_window.h"
+#include "band_levels.h"
+#include "tf_export.h"
+
+// Host copy of the firmware's audio.h, which is not part of this tree: the configuration and types audio.cpp expects
+// from it, and the prototypes of its public functions. FFTSIZE can be overridden from the build.
+
+#ifndef FFTSIZE
+#define FFTSIZE 1024
+#endif
+
+typedef enum
+{
+    STRAY_RESULT_SUCCESS,
+    TEST_RESULT_NO_HEADSET,
+    TEST_RESULT_NO_EEPROM,
+    STRAY_RESULT_FAIL, //limit masks, appended so the values the station knows keep their numbers
+} stray_test_result_t;
+
+void audio_initialise(void);
+
+bool audio_run_test0(stray_test_result_t *STOEML, stray_test_result_t *STOEMR);
+bool audio_run_test1(stray_test_result_t *LTIEML, stray_test_result_t *LTIEMR);
+bool audio_run_test2a(stray_test_result_t *STOEML, stray_test_result_t *STOEMR, stray_test_result_t *STIEML,
+                      stray_test_result_t *STIEMR);
+bool audio_run_test2b(stray_test_result_t *LTIEML, stray_test_result_t *LTIEMR);
+bool audio_run_test3(stray_test_result_t *LTL, stray_test_result_t *LTR);
+bool audio_run_test0_1_2b(stray_test_result_t *STOEML, stray_test_result_t *STOEMR, stray_test_result_t *LTIEML_1,
+                          stray_test_result_t *LTIEMR_1, stray_test_result_t *LTIEML_2B, stray_test_result_t *LTIEMR_2B);
+bool audio_run_test2a_3(stray_test_result_t *STOEML, stray_test_result_t *STOEMR, stray_test_result_t *STIEML,
+                        stray_test_result_t *STIEMR, stray_test_result_t *LTL, stray_test_result_t *LTR);
+bool audio_play_sine(uint32_t channel);
+void audio_abort_test(void);
+
+unsigned audio_get_headset_tf_curves(const float (**curves)[FFTSIZE / 2]);
+bool audio_get_headset_tf(float data[FFTSIZE / 2], unsigned curve_id);
+size_t audio_export_headset_tf(uint8_t *packet, size_t packet_size, tf_export_resolution_t resolution);
+int audio_get_last_test_nb_frames(void);
+
+bool audio_measure_latency(void);
+bool audio_get_latency_samples(int delays[4]);
+bool audio_load_limit_masks(const uint8_t *blob, size_t size);
+int audio_set_sparse_frequencies(const float *freqs_hz, int nb_freqs);
+void audio_set_sweep_excitation(bool enable);
+void audio_set_multisine_excitation(bool enable);
+void audio_set_test_window(uint8_t test_type, analysis_window_t window);
+void audio_set_convergence_bound_db(float bound_db);
+void audio_set_capture_streaming(bool enable);
+void audio_set_tf_snapshots(int every_nb_frames, bool exponential);
+void audio_set_idle_callback(void (*callback)(void));
+
+void audio_dump_profiling_stats(void);
+void audio_dump_memory_report(void);
+void audio_run_analysis_benchmark(int nb_frames);
+void audio_run_sparse_benchmark(int nb_frames);
+int audio_get_block_overruns(void);
+int audio_get_memory_usage_max(void);
+
+bool audio_get_current_mic_rms(float *measured_rms_oem_l, float *measured_rms_oem_r, float *measured_rms_iem_l,
+                               float *measured_rms_iem_r);
+bool audio_get_band_levels(float levels_db[4][BAND_LEVELS_NB_BANDS], const float **centres_hz);
+void audio_enable_band_levels(bool enable);
+
+void audio_reset_record_queues(void);
+void audio_enable_interrupts(void);
+void audio_disable_interrupts(void);
+bool audio_is_headset_connected(void);
+void audio_set_headset_connected(bool headset_connected);
+bool audio_is_headset_eeprom_alive(void);
+void audio_set_headset_eeprom_alive(bool headset_eeprom_alive);
+
+#endif
@@ -0,0 +1,38 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+#ifndef DEBUG_H
+#define DEBUG_H
+
+// Host stand-in: the console is stdout, and Panic() aborts unless a test installed a handler, see host_stubs.h
+
+void console_write(const char *format, ...) __attribute__((format(printf, 1, 2)));
+void Panic(void);
+
+#define PanicFalse(condition) \
+    do \
+    { \
+        if(!(condition)) \
+        { \
+            Panic(); \
+        } \
+    } while(0)
+
+#ifdef DEBUG_ENABLED
+#define DEBUG(...) console_write(__VA_ARGS__)
+#else
+#define DEBUG(...)
+#endif
+
+#endif
@@ -0,0 +1,31 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+#ifndef IO_H
+#define IO_H
+
+// Host stand-in: the status LED only remembers its colour
+
+typedef enum
+{
+    LED_COLOR_OFF,
+    LED_COLOR_WHITE,
+    LED_COLOR_BLUE,
+    LED_COLOR_GREEN,
+    LED_COLOR_RED,
+} led_color_t;
+
+void io_set_status_led_color(led_color_t color);
+
+#endif
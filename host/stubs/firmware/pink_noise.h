@@ -0,0 +1,27 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+#ifndef PINK_NOISE_H
+#define PINK_NOISE_H
+
+#include <stdint.h>
+
+// Host stand-in: pink noise from a seeded generator, with enough history for the longest playback to mic delay
+
+void pink_noise_get(int16_t *dest);
+void pink_noise_get_delayed(int16_t *dest, int delay);
+void pink_noise_clear(void);
+void pink_noise_amplitude(float amplitude);
+
+#endif
@@ -0,0 +1,235 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+#include <Arduino.h>
+#include <new>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "debug.h"
+#include "host_stubs.h"
+#include "io.h"
+#include "src/kissfft/kiss_fftr.h"
+
+// Teensy core, console and board stand-ins, and the allocation and fft plan counters
+
+void host_reseed_acoustics(uint32_t seed); //audio_stream.cpp
+void host_reseed_pink_noise(uint32_t seed); //pink_noise.cpp
+
+usb_serial_class Serial;
+
+static uint64_t clock_us;
+static uint32_t nb_serial_bytes;
+static void (*serial_sink)(const uint8_t *data, size_t size);
+static int serial_available = 1 << 20;
+static void (*panic_handler)(void);
+static bool console_muted;
+static led_color_t led_color;
+static uint32_t nb_heap_allocations;
+static uint32_t nb_fft_plans;
+static bool in_fftr_alloc;
+
+uint32_t micros(void)
+{
+    return (uint32_t)clock_us;
+}
+
+uint32_t millis(void)
+{
+    return (uint32_t)(clock_us / 1000);
+}
+
+void host_advance_us(uint32_t us)
+{
+    clock_us += us;
+}
+
+int usb_serial_class::availableForWrite(void)
+{
+    return serial_available;
+}
+
+size_t usb_serial_class::write(const uint8_t *buffer, size_t size)
+{
+    nb_serial_bytes += size;
+    if(serial_sink != NULL)
+    {
+        serial_sink(buffer, size);
+    }
+    return size;
+}
+
+uint32_t host_get_nb_serial_bytes(void)
+{
+    return nb_serial_bytes;
+}
+
+void host_set_serial_sink(void (*sink)(const uint8_t *data, size_t size))
+{
+    serial_sink = sink;
+}
+
+void host_set_serial_available(int nb_bytes)
+{
+    serial_available = nb_bytes;
+}
+
+void console_write(const char *format, ...)
+{
+    if(console_muted)
+    {
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+void host_mute_console(bool mute)
+{
+    fflush(stdout);
+    console_muted = mute;
+}
+
+void Panic(void)
+{
+    if(panic_handler != NULL)
+    {
+        panic_handler();
+    }
+    fflush(stdout);
+    fprintf(stderr, "Panic\n");
+    abort();
+}
+
+void host_set_panic_handler(void (*handler)(void))
+{
+    panic_handler = handler;
+}
+
+void io_set_status_led_color(led_color_t color)
+{
+    led_color = color;
+}
+
+int host_get_led_color(void)
+{
+    return led_color;
+}
+
+void host_reseed(uint32_t seed)
+{
+    host_reseed_acoustics(seed);
+    host_reseed_pink_noise(seed);
+}
+
+// The host build links with --wrap for these, so every heap allocation of the firmware code goes through here
+extern "C" void *__real_malloc(size_t size);
+extern "C" void *__real_calloc(size_t nmemb, size_t size);
+extern "C" void *__real_realloc(void *ptr, size_t size);
+
+extern "C" void *__wrap_malloc(size_t size)
+{
+    nb_heap_allocations++;
+    return __real_malloc(size);
+}
+
+extern "C" void *__wrap_calloc(size_t nmemb, size_t size)
+{
+    nb_heap_allocations++;
+    return __real_calloc(nmemb, size);
+}
+
+extern "C" void *__wrap_realloc(void *ptr, size_t size)
+{
+    nb_heap_allocations++;
+    return __real_realloc(ptr, size);
+}
+
+// And for the kiss fft allocators: a plan is counted when one is built, not when only its size is asked. The complex
+// plan kiss_fftr_alloc builds inside its own is part of it.
+extern "C" kiss_fft_cfg __real_kiss_fft_alloc(int nfft, int inverse_fft, void *mem, size_t *lenmem);
+extern "C" kiss_fftr_cfg __real_kiss_fftr_alloc(int nfft, int inverse_fft, void *mem, size_t *lenmem);
+
+extern "C" kiss_fft_cfg __wrap_kiss_fft_alloc(int nfft, int inverse_fft, void *mem, size_t *lenmem)
+{
+    kiss_fft_cfg cfg = __real_kiss_fft_alloc(nfft, inverse_fft, mem, lenmem);
+    if((cfg != NULL) && !in_fftr_alloc)
+    {
+        nb_fft_plans++;
+    }
+    return cfg;
+}
+
+extern "C" kiss_fftr_cfg __wrap_kiss_fftr_alloc(int nfft, int inverse_fft, void *mem, size_t *lenmem)
+{
+    in_fftr_alloc = true;
+    kiss_fftr_cfg cfg = __real_kiss_fftr_alloc(nfft, inverse_fft, mem, lenmem);
+    in_fftr_alloc = false;
+    if(cfg != NULL)
+    {
+        nb_fft_plans++;
+    }
+    return cfg;
+}
+
+void *operator new(size_t size)
+{
+    void *p = malloc(size);
+    if(p == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t size) noexcept
+{
+    (void)size;
+    free(p);
+}
+
+void operator delete[](void *p, size_t size) noexcept
+{
+    (void)size;
+    free(p);
+}
+
+uint32_t host_get_nb_heap_allocations(void)
+{
+    return nb_heap_allocations;
+}
+
+uint32_t host_get_nb_fft_plans(void)
+{
+    return nb_fft_plans;
+}
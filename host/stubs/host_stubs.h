@@ -0,0 +1,74 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+#ifndef HOST_STUBS_H
+#define HOST_STUBS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Controls and counters of the host stand-ins, for the host tests and benchmarks
+
+// Virtual time of micros() and millis(). It starts at 0 and only moves when told to.
+void host_advance_us(uint32_t us);
+
+// Runs the audio update now, unless audio interrupts are masked (AudioNoInterrupts()), which drops it as a missed
+// I2S interrupt would. Returns false when dropped.
+bool host_run_audio_update(void);
+
+// One block period of virtual time, then the audio update: the I2S interrupt of a real shield. Pass it to
+// audio_set_idle_callback() so a test runs in virtual time, each idle slot of RunChain waiting for the next block.
+void host_audio_block(void);
+uint32_t host_get_nb_audio_blocks(void);
+
+// Acoustic model from the I2S outputs to the I2S inputs. Each input is the sum over the outputs of gain times the
+// output delayed by delay_samples of that input, with an echo one sample later of relative gain echo, then
+// y + square * y^2 (full scale 1), plus uniform white noise of peak noise (full scale 1). Outputs are scaled by the
+// volume of their shield first.
+#define HOST_AUDIO_PIPELINE_SAMPLES 512
+
+typedef struct
+{
+    float gain[4][4]; //[I2S input][I2S output], linear
+    int delay_samples[4];
+    float echo[4];
+    float square[4];
+    float noise;
+} host_acoustics_t;
+
+// Every input hears every output, the speakers on its own side 6 dB louder, after 200 samples, with a little noise.
+// Going through the audio library adds HOST_AUDIO_PIPELINE_SAMPLES from a play queue to a record queue.
+void host_get_default_acoustics(host_acoustics_t *acoustics);
+void host_set_acoustics(const host_acoustics_t *acoustics);
+
+// Restarts the noise generators of the acoustic model and of the pink noise
+void host_reseed(uint32_t seed);
+
+// Called by Panic() instead of aborting, e.g. a longjmp back into a test expecting the panic
+void host_set_panic_handler(void (*handler)(void));
+
+// Console output goes to stdout unless muted
+void host_mute_console(bool mute);
+
+// Allocations since start: heap (malloc, calloc, realloc, new) in the host build, and plans built by kiss fft
+uint32_t host_get_nb_heap_allocations(void);
+uint32_t host_get_nb_fft_plans(void);
+
+// USB serial: bytes written so far, where they go (nowhere by default), and the room availableForWrite() reports
+uint32_t host_get_nb_serial_bytes(void);
+void host_set_serial_sink(void (*sink)(const uint8_t *data, size_t size));
+void host_set_serial_available(int nb_bytes);
+int host_get_led_color(void);
+
+#endif
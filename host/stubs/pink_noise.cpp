@@ -0,0 +1,88 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "debug.h"
+#include "host_stubs.h"
+#include "pink_noise.h"
+#include <Audio.h>
+
+// White noise from a linear congruential generator through Paul Kellet's economy pinking filter, about -14 dB full
+// scale RMS at amplitude 1. Every block generated is kept, for the delayed reads of the reference.
+
+#define PINK_NOISE_HISTORY_SAMPLES 4096 //power of 2, over LATENCY_MAX_DELAY_SAMPLES plus a block
+#define PINK_NOISE_SCALE 0.05f
+
+static uint32_t rng = 1;
+static float b0, b1, b2;
+static float pink_amplitude = 1.0f;
+static int16_t history[PINK_NOISE_HISTORY_SAMPLES];
+static uint32_t next_sample; //index of the next sample generated
+
+static float WhiteNoise(void)
+{
+    rng = (rng * 1664525u) + 1013904223u;
+    return ((float)(rng >> 8) / 8388608.0f) - 1.0f;
+}
+
+void pink_noise_get(int16_t *dest)
+{
+    PanicFalse(dest != NULL);
+
+    for(int i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+    {
+        const float white = WhiteNoise();
+        b0 = (0.99765f * b0) + (white * 0.0990460f);
+        b1 = (0.96300f * b1) + (white * 0.2965164f);
+        b2 = (0.57000f * b2) + (white * 1.0526913f);
+        const float pink = b0 + b1 + b2 + (white * 0.1848f);
+
+        const float scaled = roundf(pink * PINK_NOISE_SCALE * pink_amplitude * 32767.0f);
+        dest[i] = (int16_t)fmaxf(-32768.0f, fminf(32767.0f, scaled));
+        history[next_sample & (PINK_NOISE_HISTORY_SAMPLES - 1)] = dest[i];
+        next_sample++;
+    }
+}
+
+// The last block generated, as it was delay samples earlier, silence before the first one
+void pink_noise_get_delayed(int16_t *dest, int delay)
+{
+    PanicFalse(dest != NULL);
+    PanicFalse((delay >= 0) && ((delay + AUDIO_BLOCK_SAMPLES) <= PINK_NOISE_HISTORY_SAMPLES));
+
+    for(int i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+    {
+        const int32_t n = (int32_t)next_sample - AUDIO_BLOCK_SAMPLES + i - delay;
+        dest[i] = (n < 0) ? 0 : history[n & (PINK_NOISE_HISTORY_SAMPLES - 1)];
+    }
+}
+
+void pink_noise_clear(void)
+{
+    memset(history, 0, sizeof(history));
+    next_sample = 0;
+}
+
+void pink_noise_amplitude(float amplitude)
+{
+    pink_amplitude = amplitude;
+}
+
+void host_reseed_pink_noise(uint32_t seed)
+{
+    rng = seed;
+    b0 = b1 = b2 = 0.0f;
+}
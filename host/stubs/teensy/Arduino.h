@@ -0,0 +1,50 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Host stand-in for the parts of the Teensy core the firmware uses. Time is virtual, see host_stubs.h: it only moves
+// when the host moves it, so a test runs the same however fast the host is.
+
+#define LOW 0
+#define HIGH 1
+
+uint32_t micros(void);
+uint32_t millis(void);
+
+// USB serial: takes everything, see host_set_serial_sink()
+class usb_serial_class
+{
+  public:
+    int availableForWrite(void);
+    size_t write(const uint8_t *buffer, size_t size);
+    bool dtr(void)
+    {
+        return true;
+    }
+    operator bool()
+    {
+        return true;
+    }
+};
+
+extern usb_serial_class Serial;
+
+#endif
@@ -0,0 +1,228 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+#ifndef AUDIO_H_
+#define AUDIO_H_
+
+#include <stdint.h>
+
+// Host stand-in for the Teensy audio library, with the same update model: streams register in construction order, a
+// patch cord hands a transmitted block to its destination input, and the audio update runs every active stream once.
+// The update runs when host_stubs.h says so, in place of the I2S interrupt.
+
+#define AUDIO_BLOCK_SAMPLES 128
+#define AUDIO_SAMPLE_RATE_EXACT 44100.0f
+#define AUDIO_INPUT_LINEIN 0
+#define AUDIO_INPUT_MIC 1
+#define AUDIO_MEMORY_MAX_BLOCKS 512
+
+typedef struct audio_block_struct
+{
+    uint8_t ref_count;
+    uint8_t reserved1;
+    uint16_t memory_pool_index;
+    int16_t data[AUDIO_BLOCK_SAMPLES];
+} audio_block_t;
+
+class AudioConnection;
+
+class AudioStream
+{
+  public:
+    AudioStream(unsigned char ninput, audio_block_t **iqueue);
+    virtual void update(void) = 0;
+
+    static void update_all(void);
+    static void initialize_memory(unsigned int num);
+
+    static uint16_t memory_used;
+    static uint16_t memory_used_max;
+    static uint32_t nb_allocations; //blocks handed out since start
+
+  protected:
+    static audio_block_t *allocate(void);
+    static void release(audio_block_t *block);
+    void transmit(audio_block_t *block, unsigned char index = 0);
+    audio_block_t *receiveReadOnly(unsigned int index = 0);
+    audio_block_t *receiveWritable(unsigned int index = 0);
+
+    bool active;
+    unsigned char num_inputs;
+
+  private:
+    friend class AudioConnection;
+
+    audio_block_t **inputQueue;
+    AudioConnection *destination_list;
+    AudioStream *next_update;
+    static AudioStream *first_update;
+};
+
+class AudioConnection
+{
+  public:
+    AudioConnection(AudioStream &source, unsigned char sourceOutput, AudioStream &destination,
+                    unsigned char destinationInput);
+
+  private:
+    friend class AudioStream;
+
+    AudioStream &src;
+    AudioStream &dst;
+    unsigned char src_index;
+    unsigned char dest_index;
+    AudioConnection *next_dest;
+};
+
+class AudioRecordQueue : public AudioStream
+{
+  public:
+    AudioRecordQueue(void) : AudioStream(1, inputQueueArray), userblock(NULL), head(0), tail(0), enabled(0)
+    {
+    }
+    void begin(void)
+    {
+        clear();
+        enabled = 1;
+    }
+    void end(void)
+    {
+        enabled = 0;
+    }
+    int available(void);
+    void clear(void);
+    int16_t *readBuffer(void);
+    void freeBuffer(void);
+    virtual void update(void);
+
+  private:
+    static const int max_buffers = 53;
+
+    audio_block_t *inputQueueArray[1];
+    audio_block_t *queue[max_buffers];
+    audio_block_t *userblock;
+    uint32_t head, tail;
+    uint8_t enabled;
+};
+
+class AudioPlayQueue : public AudioStream
+{
+  public:
+    AudioPlayQueue(void) : AudioStream(0, NULL), userblock(NULL), head(0), tail(0)
+    {
+    }
+    int16_t *getBuffer(void);
+    void playBuffer(void);
+    virtual void update(void);
+
+  private:
+    static const int max_buffers = 32;
+
+    audio_block_t *queue[max_buffers];
+    audio_block_t *userblock;
+    uint32_t head, tail;
+};
+
+class AudioAnalyzeRMS : public AudioStream
+{
+  public:
+    AudioAnalyzeRMS(void) : AudioStream(1, inputQueueArray), accum(0), count(0), new_output(false)
+    {
+    }
+    bool available(void);
+    float read(void);
+    virtual void update(void);
+
+  private:
+    audio_block_t *inputQueueArray[1];
+    int64_t accum;
+    uint32_t count;
+    bool new_output;
+};
+
+class AudioSynthWaveformSine : public AudioStream
+{
+  public:
+    AudioSynthWaveformSine(void) : AudioStream(0, NULL), phase(0.0), phase_increment(0.0), magnitude(0.0f)
+    {
+    }
+    void frequency(float freq);
+    void amplitude(float n);
+    virtual void update(void);
+
+  private:
+    double phase;
+    double phase_increment;
+    float magnitude;
+};
+
+// The four inputs are computed from the four outputs by the acoustic model of host_stubs.h
+class AudioInputI2SQuad : public AudioStream
+{
+  public:
+    AudioInputI2SQuad(void) : AudioStream(0, NULL)
+    {
+    }
+    virtual void update(void);
+};
+
+class AudioOutputI2SQuad : public AudioStream
+{
+  public:
+    AudioOutputI2SQuad(void) : AudioStream(4, inputQueueArray)
+    {
+    }
+    virtual void update(void);
+
+  private:
+    audio_block_t *inputQueueArray[4];
+};
+
+// Shield LOW drives I2S outputs 0 and 1, shield HIGH outputs 2 and 3, at their volume
+class AudioControlSGTL5000
+{
+  public:
+    AudioControlSGTL5000(void) : address(0)
+    {
+    }
+    void setAddress(uint8_t level)
+    {
+        address = level;
+    }
+    bool enable(void)
+    {
+        return true;
+    }
+    bool inputSelect(int n)
+    {
+        (void)n;
+        return true;
+    }
+    bool volume(float n);
+
+    static float volume_of_shield[2];
+
+  private:
+    uint8_t address;
+};
+
+#define AudioMemory(num) AudioStream::initialize_memory(num)
+#define AudioMemoryUsage() (AudioStream::memory_used)
+#define AudioMemoryUsageMax() (AudioStream::memory_used_max)
+#define AudioMemoryUsageMaxReset() (AudioStream::memory_used_max = AudioStream::memory_used)
+
+void AudioNoInterrupts(void);
+void AudioInterrupts(void);
+
+#endif
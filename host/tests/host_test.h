@@ -0,0 +1,78 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <Audio.h>
+#include <math.h>
+#include <stdio.h>
+
+#include "audio.h"
+#include "host_stubs.h"
+
+// Checks of the host tests, which include audio.cpp before this. A failed check is reported and the test goes on;
+// main() returns host_test_exit_code().
+
+static int host_test_nb_failures;
+
+#define CHECK(condition) \
+    do \
+    { \
+        if(!(condition)) \
+        { \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            host_test_nb_failures++; \
+        } \
+    } while(0)
+
+#define CHECK_NEAR(value, expected, tolerance) \
+    do \
+    { \
+        const double check_value = (value); \
+        const double check_expected = (expected); \
+        if(!(fabs(check_value - check_expected) <= (tolerance))) \
+        { \
+            printf("%s:%d: %s is %g, expected %g within %g\n", __FILE__, __LINE__, #value, check_value, \
+                   check_expected, (double)(tolerance)); \
+            host_test_nb_failures++; \
+        } \
+    } while(0)
+
+static inline int host_test_exit_code(void)
+{
+    printf("%s\n", (host_test_nb_failures == 0) ? "passed" : "FAILED");
+    return (host_test_nb_failures == 0) ? 0 : 1;
+}
+
+// Initialises the chain with a headset plugged in, running in virtual time
+static inline void host_test_boot(void)
+{
+    host_mute_console(true);
+    audio_set_idle_callback(host_audio_block); //audio_initialise measures the latency
+    audio_initialise();
+    audio_set_headset_connected(true);
+    audio_set_headset_eeprom_alive(true);
+}
+
+// 20 log10 of the gain of an I2S input hearing both outputs of a shield, which play the same excitation
+static inline float host_test_pair_gain_db(const host_acoustics_t *acoustics, int input, int shield)
+{
+    const float volume = AudioControlSGTL5000::volume_of_shield[shield];
+    const float gain = acoustics->gain[input][2 * shield] + acoustics->gain[input][(2 * shield) + 1];
+
+    return 20.0f * log10f(volume * gain);
+}
+
+#endif
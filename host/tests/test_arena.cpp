@@ -0,0 +1,145 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+// The analysis arena: the TF cache overlays the capture ring and FFT buffers, the latency cross spectra overlay the
+// accumulators, and the phase changes clear or invalidate what they overlay. The getters return no results while the
+// chain runs. The static RAM of a test is compared with the same buffers as separate arrays.
+
+#include "audio.cpp"
+
+#include <setjmp.h>
+
+#include "host_test.h"
+
+static bool Overlaps(const void *a, size_t a_size, const void *b, size_t b_size)
+{
+    const uint8_t *a_begin = (const uint8_t *)a;
+    const uint8_t *b_begin = (const uint8_t *)b;
+    return (a_begin < (b_begin + b_size)) && (b_begin < (a_begin + a_size));
+}
+
+static bool AllZero(const void *data, size_t size)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    for(size_t i = 0; i < size; i++)
+    {
+        if(bytes[i] != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static jmp_buf panic_jump;
+
+static void PanicJump(void)
+{
+    longjmp(panic_jump, 1);
+}
+
+static int nb_idle_blocks;
+static int nb_reads_while_running;
+static int nb_curves_while_running;
+
+// Reads the results a few blocks into the test, with the chain running
+static void ReadResultsWhileRunning(void)
+{
+    host_audio_block();
+    if(++nb_idle_blocks == (4 * NB_BLOCKS_IN_FFTSIZE))
+    {
+        float tf[FFTSIZE / 2];
+        const float(*curves)[FFTSIZE / 2] = NULL;
+        uint8_t packet[TF_EXPORT_PACKET_MAX_SIZE(8, FFTSIZE / 2)];
+        nb_reads_while_running++;
+        nb_curves_while_running += audio_get_headset_tf(tf, 0) ? 1 : 0;
+        nb_curves_while_running += (int)audio_get_headset_tf_curves(&curves);
+        nb_curves_while_running += (curves != NULL) ? 1 : 0;
+        nb_curves_while_running += (int)audio_export_headset_tf(packet, sizeof(packet), TF_EXPORT_BINS);
+    }
+}
+
+int main(void)
+{
+    host_test_boot();
+
+    // The overlays
+    CHECK((void *)tf_cache == (void *)&arena_chain_or_results.chain);
+    CHECK(sizeof(tf_cache) <= sizeof(arena_chain_t));
+    CHECK(Overlaps(tf_cache, sizeof(tf_cache), bOEM_L, sizeof(bOEM_L)));
+    CHECK(Overlaps(latency_cross_re, sizeof(latency_cross_re), NoiseSquaredCumul, sizeof(NoiseSquaredCumul)));
+    CHECK(!Overlaps(tf_cache, sizeof(tf_cache), &arena_accum_or_latency, sizeof(arena_accum_or_latency)));
+    CHECK(!Overlaps(latency_cross_re, sizeof(latency_cross_re), &arena_chain_or_results,
+                    sizeof(arena_chain_or_results)));
+
+    // Static RAM of a test, with the buffers of every phase as separate arrays before
+    const size_t separate_bytes = sizeof(arena_chain_t) + sizeof(arena_accum_t) + sizeof(arena_latency_t) +
+                                  sizeof(tf_cache);
+    const size_t arena_bytes = sizeof(arena_chain_or_results) + sizeof(arena_accum_or_latency);
+    printf("FFTSIZE %d: separate buffers %zu bytes, arena %zu bytes\n", FFTSIZE, separate_bytes, arena_bytes);
+    CHECK(arena_bytes == (separate_bytes - sizeof(arena_latency_t) - sizeof(tf_cache)));
+    CHECK(arena_bytes <= AUDIO_ARENA_BUDGET_BYTES);
+
+    stray_test_result_t r[2];
+    CHECK(audio_run_test0(&r[0], &r[1]));
+    CHECK(arena_phase == ARENA_PHASE_TEST);
+
+    // Entering the latency phase clears the cross spectra, leaving it clears the accumulators they overwrote
+    memset(&arena_accum_or_latency, 0x5a, sizeof(arena_accum_or_latency));
+    ArenaEnterPhase(ARENA_PHASE_LATENCY);
+    CHECK(AllZero(&arena_accum_or_latency.latency, sizeof(arena_latency_t)));
+    latency_cross_re[0][1] = 1.0f;
+    latency_cross_im[3][KISS_FFT_OUT_SIZE - 1] = -1.0f;
+    ArenaEnterPhase(ARENA_PHASE_TEST);
+    CHECK(AllZero(&arena_accum_or_latency.accum, sizeof(arena_accum_t)));
+
+    // Reading the results fills the cache over the capture ring, a new test invalidates it
+    CHECK(audio_run_test0(&r[0], &r[1]));
+    float tf[FFTSIZE / 2];
+    CHECK(audio_get_headset_tf(tf, 0));
+    CHECK(arena_phase == ARENA_PHASE_RESULTS);
+    CHECK(tf_cache_valid);
+    ResetChain();
+    CHECK(arena_phase == ARENA_PHASE_TEST);
+    CHECK(!tf_cache_valid);
+
+    // The chain cannot start on the results
+    CHECK(audio_get_headset_tf(tf, 0));
+    bool panicked = false;
+    host_set_panic_handler(PanicJump);
+    if(setjmp(panic_jump) == 0)
+    {
+        enableAudioChain();
+    }
+    else
+    {
+        panicked = true;
+    }
+    host_set_panic_handler(NULL);
+    CHECK(panicked);
+    CHECK(!audio_chain_running);
+
+    // Nor are the results read while it runs, the getters return none. The test runs on and its results are read after.
+    audio_set_idle_callback(ReadResultsWhileRunning);
+    CHECK(audio_run_test0(&r[0], &r[1]));
+    audio_set_idle_callback(host_audio_block);
+    CHECK(nb_reads_while_running == 1);
+    CHECK(nb_curves_while_running == 0);
+    CHECK(!audio_chain_running);
+    CHECK(arena_phase == ARENA_PHASE_TEST);
+    CHECK(audio_get_headset_tf(tf, 0));
+    CHECK(arena_phase == ARENA_PHASE_RESULTS);
+
+    return host_test_exit_code();
+}
@@ -0,0 +1,87 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+// The fractional octave bank, on a half-scale sine at the centre of each band: the band reads 10 log10(0.5^2 / 2),
+// -9.03 dB, within 0.25 dB (the bandpass cascades lose 0.08 dB at the centre, and the average of the lowest bands
+// still ripples at twice their frequency), and its neighbours read at least 7.5 dB lower. Also prints the cost of a
+// block.
+
+#include <time.h>
+
+#include "band_levels.h"
+#include "host_test.h"
+
+#define SAMPLE_RATE_HZ 44100.0f
+#define BLOCK_SAMPLES 128
+#define TIME_CONSTANT_MS 125.0f
+
+static band_levels_design_t design;
+static band_levels_channel_t channel;
+
+static float LevelDb(int band)
+{
+    return 10.0f * log10f(channel.mean_square[band]);
+}
+
+// Settles the averages on a sine, and returns the ns per block of the last blocks
+static uint64_t PlaySine(float freq_hz, float amplitude)
+{
+    band_levels_reset(&channel);
+
+    int16_t block[BLOCK_SAMPLES];
+    const uint32_t nb_blocks = 2 * design.settle_blocks;
+    uint64_t ns = 0;
+    for(uint32_t b = 0; b < nb_blocks; b++)
+    {
+        for(int i = 0; i < BLOCK_SAMPLES; i++)
+        {
+            const double t = ((double)b * BLOCK_SAMPLES + i) / SAMPLE_RATE_HZ;
+            block[i] = (int16_t)lround(32768.0 * amplitude * sin(2.0 * M_PI * freq_hz * t));
+        }
+
+        struct timespec start;
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        band_levels_process(&design, &channel, block);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        ns += ((uint64_t)(end.tv_sec - start.tv_sec) * 1000000000ULL) + end.tv_nsec - start.tv_nsec;
+    }
+
+    return ns / nb_blocks;
+}
+
+int main(void)
+{
+    band_levels_design(&design, SAMPLE_RATE_HZ, BLOCK_SAMPLES, TIME_CONSTANT_MS);
+    const float expected_db = 10.0f * log10f(0.5f * 0.5f / 2.0f);
+
+    uint64_t ns = 0;
+    for(int band = 0; band < BAND_LEVELS_NB_BANDS; band++)
+    {
+        ns += PlaySine(design.centres_hz[band], 0.5f);
+
+        const float level_db = LevelDb(band);
+        const float below_db = (band > 0) ? (level_db - LevelDb(band - 1)) : 0.0f;
+        const float above_db = (band < (BAND_LEVELS_NB_BANDS - 1)) ? (level_db - LevelDb(band + 1)) : 0.0f;
+        printf("%7.1f Hz: %6.2f dB, band below %5.2f dB lower, band above %5.2f dB lower\n", design.centres_hz[band],
+               level_db, below_db, above_db);
+
+        CHECK_NEAR(level_db, expected_db, 0.25);
+        CHECK((band == 0) || (below_db >= 7.5f));
+        CHECK((band == (BAND_LEVELS_NB_BANDS - 1)) || (above_db >= 7.5f));
+    }
+    printf("%lu ns per block of %d samples\n", (unsigned long)(ns / BAND_LEVELS_NB_BANDS), BLOCK_SAMPLES);
+
+    return host_test_exit_code();
+}
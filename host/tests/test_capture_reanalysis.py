@@ -0,0 +1,62 @@
+"""Reanalyses a capture stream of the host build with the station tools.
+
+test_capture_stream records test 2A through a 2-tap echo: the raw stream, and the curves of
+the firmware followed by the responses of the model. The stream goes through
+capture_receiver.py into a capture file, and capture_reanalysis.py must give the curves of
+the firmware, and so the responses of the model, over the convergence band.
+
+    test_capture_reanalysis.py <firmware dir> <stream file> <curves file> <work dir>
+"""
+
+import os
+import sys
+
+import numpy as np
+
+FFTSIZE = 1024
+SAMPLE_RATE = 44100
+BAND_LOW_HZ = 100  # CONVERGENCE_BAND of audio.cpp
+BAND_HIGH_HZ = 10000
+FIRMWARE_TOLERANCE_DB = 0.01
+MODEL_TOLERANCE_DB = 0.03  # random error of 430 frames of pink noise, 0.02 dB measured
+
+
+def main():
+    firmware_dir, stream_path, curves_path, work_dir = sys.argv[1:5]
+    sys.path.insert(0, firmware_dir)
+    import capture_reanalysis
+    import capture_receiver
+
+    capture_path = os.path.join(work_dir, "test_capture_reanalysis.ecap")
+    with open(stream_path, "rb") as stream:
+        nb_files = capture_receiver.receive(stream, capture_path, SAMPLE_RATE)
+    if nb_files != 1:
+        print(f"FAILED: {nb_files} capture files")
+        return 1
+
+    segments = capture_reanalysis.reanalyse([capture_path], FFTSIZE)[capture_path]
+    if len(segments) != 1 or segments[0]["test_type"] != 2:
+        print(f"FAILED: segments {[(s['test_type'], s['nb_frames']) for s in segments]}")
+        return 1
+
+    curves = np.fromfile(curves_path, dtype="<f4").reshape(8, FFTSIZE // 2)
+    firmware, model = curves[:4], curves[4:]
+    band = slice(
+        int(np.ceil(BAND_LOW_HZ * FFTSIZE / SAMPLE_RATE)),
+        int(BAND_HIGH_HZ * FFTSIZE / SAMPLE_RATE) + 1,
+    )
+    reanalysed = segments[0]["curves"]
+    firmware_worst = np.abs(reanalysed[:, band] - firmware[:, band]).max()
+    model_worst = np.abs(reanalysed[:, band] - model[:, band]).max()
+    print(
+        f"test 2A: {segments[0]['nb_frames']} frames, off the firmware by "
+        f"{firmware_worst:.5f} dB, off the model by {model_worst:.4f} dB"
+    )
+
+    passed = firmware_worst <= FIRMWARE_TOLERANCE_DB and model_worst <= MODEL_TOLERANCE_DB
+    print("passed" if passed else "FAILED")
+    return 0 if passed else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
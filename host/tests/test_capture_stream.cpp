@@ -0,0 +1,151 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+// The raw capture stream of a test, parsed back from the USB serial stand-in: every block goes out as one frame of
+// 1300 bytes with a valid CRC and consecutive sequence numbers, the measurement blocks flagged, and frames the USB
+// buffers cannot take are dropped and counted without holding up the test.
+//
+// With two file arguments it then records test 2A through a 2-tap echo for test_capture_reanalysis.py: the raw stream
+// to the first file, and to the second the 4 curves of the firmware followed by the 4 responses of the model, as
+// float32 curves of FFTSIZE / 2 bins.
+
+#include "audio.cpp"
+
+#include <vector>
+
+#include "host_test.h"
+
+// Curve ids of audio_get_headset_tf to I2S inputs, see the patch cords
+static const int curve_input[4] = {2, 0, 3, 1};
+
+#define RECORDING_ECHO 0.5f
+
+static std::vector<uint8_t> stream;
+static float recording_curves[8][FFTSIZE / 2];
+
+static void StreamSink(const uint8_t *data, size_t size)
+{
+    stream.insert(stream.end(), data, data + size);
+}
+
+// Test 2A with every input hearing its speakers through 1 + RECORDING_ECHO z^-1, for the full duration
+static void RecordTest2A(const char *stream_path, const char *curves_path)
+{
+    host_acoustics_t acoustics;
+    host_get_default_acoustics(&acoustics);
+    for(int input = 0; input < 4; input++)
+    {
+        acoustics.echo[input] = RECORDING_ECHO;
+    }
+    host_set_acoustics(&acoustics);
+    host_set_serial_available(1 << 20);
+    audio_set_convergence_bound_db(0.0f);
+
+    stream.clear();
+    stray_test_result_t r[4];
+    CHECK(audio_run_test2a(&r[0], &r[1], &r[2], &r[3]));
+    for(int curve = 0; curve < 4; curve++)
+    {
+        CHECK(audio_get_headset_tf(recording_curves[curve], curve));
+
+        const float pair_gain_db = host_test_pair_gain_db(&acoustics, curve_input[curve], 1);
+        for(int bin = 0; bin < (FFTSIZE / 2); bin++)
+        {
+            const double w = (2.0 * M_PI * bin) / FFTSIZE;
+            const double echo_power = 1.0 + (RECORDING_ECHO * RECORDING_ECHO) + (2.0 * RECORDING_ECHO * cos(w));
+            recording_curves[4 + curve][bin] = pair_gain_db + (float)(10.0 * log10(echo_power));
+        }
+    }
+
+    FILE *file = fopen(stream_path, "wb");
+    CHECK((file != NULL) && (fwrite(stream.data(), stream.size(), 1, file) == 1));
+    fclose(file);
+    file = fopen(curves_path, "wb");
+    CHECK((file != NULL) && (fwrite(recording_curves, sizeof(recording_curves), 1, file) == 1));
+    fclose(file);
+    printf("test 2A: %d frames recorded to %s\n", audio_get_last_test_nb_frames(), stream_path);
+}
+
+int main(int argc, char **argv)
+{
+    PanicFalse((argc == 1) || (argc == 3));
+
+    host_test_boot();
+    host_set_serial_sink(StreamSink);
+
+    const size_t frame_size = sizeof(capture_stream_header_t) +
+                              (NB_CAPTURE_STREAM_CHANNELS * AUDIO_BLOCK_SAMPLES * sizeof(int16_t)) + sizeof(uint32_t);
+    const float bytes_per_second = (frame_size * AUDIO_SAMPLE_RATE_EXACT) / AUDIO_BLOCK_SAMPLES;
+    printf("%zu bytes per block, %.0f bytes/s\n", frame_size, bytes_per_second);
+    CHECK(frame_size == 1300);
+
+    // Priming blocks are streamed too, without the analysed flag
+    audio_set_capture_streaming(true);
+    stray_test_result_t r[2];
+    CHECK(audio_run_test0(&r[0], &r[1]));
+    const int nb_frames = audio_get_last_test_nb_frames();
+
+    CHECK((stream.size() % frame_size) == 0);
+    CHECK(stream.size() == host_get_nb_serial_bytes());
+    const uint32_t nb_blocks = (uint32_t)(stream.size() / frame_size);
+    CHECK(nb_blocks == capture_stream_get_nb_sent());
+    CHECK(capture_stream_get_nb_dropped() == 0);
+
+    int nb_analysed = 0;
+    int nb_bad_frames = 0;
+    for(uint32_t b = 0; b < nb_blocks; b++)
+    {
+        const uint8_t *frame = &stream[b * frame_size];
+        capture_stream_header_t header;
+        memcpy(&header, frame, sizeof(header));
+        uint32_t crc;
+        memcpy(&crc, &frame[frame_size - sizeof(crc)], sizeof(crc));
+
+        const bool good = (header.magic == CAPTURE_STREAM_MAGIC) && (header.sequence == b) &&
+                          (header.nb_samples == AUDIO_BLOCK_SAMPLES) && (header.test_type == TEST_TYPE_0) &&
+                          (header.nb_channels == NB_CAPTURE_STREAM_CHANNELS) &&
+                          (crc == capture_stream_crc32(0, frame, frame_size - sizeof(crc)));
+        nb_bad_frames += good ? 0 : 1;
+        nb_analysed += (header.flags & CAPTURE_STREAM_FLAG_ANALYSED) ? 1 : 0;
+    }
+    printf("test 0: %u blocks sent, %d analysed, for %d frames\n", nb_blocks, nb_analysed, nb_frames);
+    CHECK(nb_bad_frames == 0);
+    CHECK(nb_analysed >= (nb_frames * NB_BLOCKS_IN_FFTSIZE));
+    CHECK(nb_analysed < (int)nb_blocks);
+
+    // No room in the USB buffers: every block is dropped, the sequence goes on and the test still passes
+    host_set_serial_available((int)frame_size - 1);
+    stream.clear();
+    CHECK(audio_run_test0(&r[0], &r[1]));
+    CHECK((r[0] == STRAY_RESULT_SUCCESS) && (r[1] == STRAY_RESULT_SUCCESS));
+    CHECK(stream.empty());
+    CHECK(capture_stream_get_nb_sent() == nb_blocks);
+    const uint32_t nb_dropped = capture_stream_get_nb_dropped();
+    printf("no room: %u blocks dropped\n", nb_dropped);
+    CHECK(nb_dropped > 0);
+    CHECK(audio_get_block_overruns() == 0);
+
+    host_set_serial_available((int)frame_size);
+    CHECK(audio_run_test0(&r[0], &r[1]));
+    capture_stream_header_t header;
+    memcpy(&header, stream.data(), sizeof(header));
+    CHECK(header.sequence == (nb_blocks + nb_dropped));
+
+    if(argc == 3)
+    {
+        RecordTest2A(argv[1], argv[2]);
+    }
+
+    return host_test_exit_code();
+}
@@ -0,0 +1,124 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+// End to end: every test function runs on the acoustic model of the host stand-ins, and its curves must read the gains
+// of the model, with the latency measured at start-up and no heap allocation nor overrun while testing. The CAL run
+// plays at the level of test 3.
+
+#include "audio.cpp"
+
+#include "host_test.h"
+
+// The rounding noise of the q15 transforms, at every stage of kiss fft, reads about 0.02 dB of extra gain
+#if defined(FIXED_POINT) && (FIXED_POINT == 16)
+#define MEAN_TOLERANCE_DB 0.04
+#else
+#define MEAN_TOLERANCE_DB 0.02
+#endif
+
+// Curve ids of audio_get_headset_tf to I2S inputs, see the patch cords
+static const int curve_input[4] = {2, 0, 3, 1};
+
+// Checks the mean and the worst bin of each curve of curve_mask over the convergence band
+static void CheckCurves(const char *test, unsigned curve_mask, int shield, const host_acoustics_t *acoustics)
+{
+    for(int curve = 0; curve < 4; curve++)
+    {
+        if(!(curve_mask & (1 << curve)))
+        {
+            continue;
+        }
+
+        float tf[FFTSIZE / 2];
+        CHECK(audio_get_headset_tf(tf, curve));
+
+        const float expected_db = host_test_pair_gain_db(acoustics, curve_input[curve], shield);
+        double sum = 0.0;
+        float worst = 0.0f;
+        for(int bin = CONVERGENCE_BAND_FIRST_BIN; bin <= CONVERGENCE_BAND_LAST_BIN; bin++)
+        {
+            sum += tf[bin];
+            worst = fmaxf(worst, fabsf(tf[bin] - expected_db));
+        }
+        const double mean = sum / CONVERGENCE_BAND_NB_BINS;
+        printf("test %s curve %d: mean %.3f dB, expected %.3f dB, worst bin off by %.3f dB\n", test, curve, mean,
+               expected_db, worst);
+        CHECK_NEAR(mean, expected_db, MEAN_TOLERANCE_DB);
+        CHECK(worst < CONVERGENCE_BOUND_DB);
+    }
+}
+
+int main(void)
+{
+    host_test_boot();
+
+    host_acoustics_t acoustics;
+    host_get_default_acoustics(&acoustics);
+
+    const uint32_t nb_heap_allocations = host_get_nb_heap_allocations();
+    stray_test_result_t r[6];
+
+    int delays[4];
+    CHECK(audio_get_latency_samples(delays));
+    for(int curve = 0; curve < 4; curve++)
+    {
+        CHECK(delays[curve] == (acoustics.delay_samples[curve_input[curve]] + HOST_AUDIO_PIPELINE_SAMPLES));
+    }
+
+    CHECK(audio_run_test0(&r[0], &r[1]));
+    CHECK((r[0] == STRAY_RESULT_SUCCESS) && (r[1] == STRAY_RESULT_SUCCESS));
+    CheckCurves("0", 0x3, 0, &acoustics);
+
+    CHECK(audio_run_test1(&r[0], &r[1]));
+    CHECK((r[0] == STRAY_RESULT_SUCCESS) && (r[1] == STRAY_RESULT_SUCCESS));
+    CheckCurves("1", 0xc, 0, &acoustics);
+
+    CHECK(audio_run_test2a(&r[0], &r[1], &r[2], &r[3]));
+    CheckCurves("2A", 0xf, 1, &acoustics);
+
+    CHECK(audio_run_test2b(&r[0], &r[1]));
+    CheckCurves("2B", 0xc, 0, &acoustics);
+
+    CHECK(audio_run_test3(&r[0], &r[1]));
+    CheckCurves("3", 0xf, 1, &acoustics);
+    const float test3_volume = AudioControlSGTL5000::volume_of_shield[1];
+
+    CHECK(audio_run_test0_1_2b(&r[0], &r[1], &r[2], &r[3], &r[4], &r[5]));
+    CheckCurves("SPK", 0xf, 0, &acoustics);
+
+    CHECK(audio_run_test2a_3(&r[0], &r[1], &r[2], &r[3], &r[4], &r[5]));
+    CheckCurves("CAL", 0xf, 1, &acoustics);
+    CHECK(AudioControlSGTL5000::volume_of_shield[1] == test3_volume); //test 3 is judged at its calibrated level
+
+    CHECK(host_get_nb_heap_allocations() == nb_heap_allocations);
+    CHECK(audio_get_block_overruns() == 0);
+    CHECK(audio_get_memory_usage_max() <= AUDIO_MEMORY_BLOCKS);
+
+    // A delay past the range of the station is a false peak: the next test measures again, and the delays it starts
+    // from are kept
+    host_acoustics_t late = acoustics;
+    for(int input = 0; input < 4; input++)
+    {
+        late.delay_samples[input] = LATENCY_MAX_DELAY_SAMPLES + AUDIO_BLOCK_SAMPLES - HOST_AUDIO_PIPELINE_SAMPLES;
+    }
+    host_set_acoustics(&late);
+    CHECK(!audio_measure_latency());
+    CHECK(!audio_get_latency_samples(delays));
+    for(int curve = 0; curve < 4; curve++)
+    {
+        CHECK(delays[curve] == (acoustics.delay_samples[curve_input[curve]] + HOST_AUDIO_PIPELINE_SAMPLES));
+    }
+
+    return host_test_exit_code();
+}
@@ -0,0 +1,88 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+// The convergence stop: off by default, a test stops once every bin of the band is known to within the bound, and its
+// curves are then within the bound of the acoustic model; a wider bound stops sooner, a bound of 0 runs the full
+// duration, and only the curves a test is judged on must converge. Overlapped frames count as one per FFTSIZE samples,
+// so a test stops after as many samples whatever the overlap.
+
+#include "audio.cpp"
+
+#include "host_test.h"
+
+// Curve ids of audio_get_headset_tf to I2S inputs, see the patch cords
+static const int curve_input[4] = {2, 0, 3, 1};
+
+// Runs test 2A with bound_db, checks its curves against the model, returns its number of frames
+static int RunTest2A(const host_acoustics_t *acoustics, float bound_db)
+{
+    audio_set_convergence_bound_db(bound_db);
+    stray_test_result_t r[4];
+    CHECK(audio_run_test2a(&r[0], &r[1], &r[2], &r[3]));
+    const int nb_frames = audio_get_last_test_nb_frames();
+
+    float worst = 0.0f;
+    for(int curve = 0; curve < 4; curve++)
+    {
+        float tf[FFTSIZE / 2];
+        CHECK(audio_get_headset_tf(tf, curve));
+        const float expected_db = host_test_pair_gain_db(acoustics, curve_input[curve], 1);
+        for(int bin = CONVERGENCE_BAND_FIRST_BIN; bin <= CONVERGENCE_BAND_LAST_BIN; bin++)
+        {
+            worst = fmaxf(worst, fabsf(tf[bin] - expected_db));
+        }
+    }
+    printf("overlap %d%%, test 2A, bound %.2f dB: %d frames, worst bin off the model by %.4f dB\n", FFT_OVERLAP_PERCENT,
+           bound_db, nb_frames, worst);
+    CHECK(nb_frames >= ((CONVERGENCE_MIN_FRAMES * NB_BLOCKS_IN_FFTSIZE) / FFT_HOP_BLOCKS));
+    CHECK((bound_db <= 0.0f) || (worst < bound_db));
+    return nb_frames;
+}
+
+int main(void)
+{
+    host_test_boot();
+
+    host_acoustics_t acoustics;
+    host_get_default_acoustics(&acoustics);
+
+    stray_test_result_t r[4];
+    CHECK(audio_run_test2a(&r[0], &r[1], &r[2], &r[3]));
+    CHECK(audio_get_last_test_nb_frames() == DurationToNbFFT(TEST2A_DURATION_SEC));
+
+    const int nb_frames_full = RunTest2A(&acoustics, 0.0f);
+    const int nb_frames_default = RunTest2A(&acoustics, CONVERGENCE_BOUND_DB);
+    const int nb_frames_wide = RunTest2A(&acoustics, 1.0f);
+    CHECK(nb_frames_full == DurationToNbFFT(TEST2A_DURATION_SEC));
+    CHECK(nb_frames_default < nb_frames_full);
+    CHECK(nb_frames_wide < nb_frames_default);
+
+    // The OEM mics barely hear the speakers: test 0 runs its full duration, test 1 on the IEM mics still stops early
+    for(int output = 0; output < 4; output++)
+    {
+        acoustics.gain[curve_input[0]][output] *= 0.01f;
+        acoustics.gain[curve_input[1]][output] *= 0.01f;
+    }
+    host_set_acoustics(&acoustics);
+    audio_set_convergence_bound_db(CONVERGENCE_BOUND_DB);
+    CHECK(audio_run_test0(&r[0], &r[1]));
+    const int nb_frames_test0 = audio_get_last_test_nb_frames();
+    CHECK(audio_run_test1(&r[0], &r[1]));
+    const int nb_frames_test1 = audio_get_last_test_nb_frames();
+    printf("OEM mics 40 dB down: test 0 %d frames, test 1 %d frames\n", nb_frames_test0, nb_frames_test1);
+    CHECK(nb_frames_test0 == DurationToNbFFT(TEST1_DURATION_SEC));
+    CHECK(nb_frames_test1 < nb_frames_test0);
+
+    return host_test_exit_code();
+}
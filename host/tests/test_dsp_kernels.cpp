@@ -0,0 +1,109 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+// The DSP kernels must match their scalar references bit for bit, on sizes that exercise the vector loops and their
+// tails. The Cortex-M7 variant builds on the host too: its window kernels are exact, its power accumulation fuses the
+// multiply-adds, so it is only checked within a float rounding per term.
+
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dsp_kernels.h"
+#include "host_test.h"
+
+#define MAX_SAMPLES 1024
+
+static int16_t src_re[MAX_SAMPLES];
+static int16_t src_im[MAX_SAMPLES];
+static float window[MAX_SAMPLES];
+static kiss_fft_cpx spectrum[MAX_SAMPLES];
+
+static float dest[MAX_SAMPLES];
+static float dest_ref[MAX_SAMPLES];
+static kiss_fft_cpx dest_cpx[MAX_SAMPLES];
+static kiss_fft_cpx dest_cpx_ref[MAX_SAMPLES];
+static float acc[MAX_SAMPLES];
+static float acc_ref[MAX_SAMPLES];
+
+static const int sizes[] = {MAX_SAMPLES, 512, 128, 13, 7, 3, 1, 0};
+
+static float RandomFloat(float scale)
+{
+    return scale * (((float)rand() / RAND_MAX) - 0.5f);
+}
+
+int main(void)
+{
+    srand(1);
+    for(int i = 0; i < MAX_SAMPLES; i++)
+    {
+        src_re[i] = (int16_t)((rand() % 65536) - 32768);
+        src_im[i] = (int16_t)((rand() % 65536) - 32768);
+        window[i] = (0.54f - (0.46f * cosf((2.0f * (float)M_PI * i) / MAX_SAMPLES))) / 32768.0f;
+        spectrum[i].r = RandomFloat(100.0f);
+        spectrum[i].i = RandomFloat(100.0f);
+    }
+    src_re[1] = -32768;
+    src_im[2] = 32767;
+
+    for(unsigned s = 0; s < (sizeof(sizes) / sizeof(sizes[0])); s++)
+    {
+        const int n = sizes[s];
+
+        memset(dest, 0, sizeof(dest));
+        memset(dest_ref, 0, sizeof(dest_ref));
+        dsp_window_q15_to_float(dest, src_re, window, n);
+        dsp_window_q15_to_float_ref(dest_ref, src_re, window, n);
+        CHECK(memcmp(dest, dest_ref, sizeof(dest)) == 0);
+
+        memset(dest_cpx, 0, sizeof(dest_cpx));
+        memset(dest_cpx_ref, 0, sizeof(dest_cpx_ref));
+        dsp_window_pair_q15_to_cpx(dest_cpx, src_re, src_im, window, n);
+        dsp_window_pair_q15_to_cpx_ref(dest_cpx_ref, src_re, src_im, window, n);
+        CHECK(memcmp(dest_cpx, dest_cpx_ref, sizeof(dest_cpx)) == 0);
+
+        // Several frames into the same accumulators, from a non-zero start
+        for(int k = 0; k < MAX_SAMPLES; k++)
+        {
+            acc[k] = acc_ref[k] = RandomFloat(1000.0f) + 500.0f;
+        }
+        for(int frame = 0; frame < 4; frame++)
+        {
+            dsp_accumulate_power(acc, &spectrum[frame], n);
+            dsp_accumulate_power_ref(acc_ref, &spectrum[frame], n);
+        }
+#if defined(__ARM_FEATURE_DSP)
+        for(int k = 0; k < MAX_SAMPLES; k++)
+        {
+            CHECK_NEAR(acc[k], acc_ref[k], 8.0 * FLT_EPSILON * acc_ref[k]);
+        }
+#else
+        CHECK(memcmp(acc, acc_ref, sizeof(acc)) == 0);
+#endif
+    }
+
+    printf("dsp kernels: %s\n",
+#if defined(__ARM_FEATURE_DSP)
+           "Cortex-M7"
+#elif defined(__AVX2__)
+           "AVX2"
+#elif defined(__SSE4_1__)
+           "SSE4.1"
+#else
+           "scalar"
+#endif
+    );
+    return host_test_exit_code();
+}
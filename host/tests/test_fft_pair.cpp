@@ -0,0 +1,105 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+// The paired complex FFT of two channels, once split, must give the spectra of the separate real FFTs of each channel:
+// within float rounding in float, within 4 LSB in fixed point, where kiss fft rounds at each stage of either transform
+// and the split halves the rounded pair spectrum.
+
+#include "audio.cpp"
+
+#include <stdlib.h>
+
+#include "host_test.h"
+
+#ifdef FIXED_POINT
+#define PAIR_TOLERANCE 4.0
+#endif
+
+static int16_t blocks_a[CAPTURE_RING_BLOCKS][AUDIO_BLOCK_SAMPLES];
+static int16_t blocks_b[CAPTURE_RING_BLOCKS][AUDIO_BLOCK_SAMPLES];
+
+static kiss_fft_cpx pair_a[KISS_FFT_OUT_SIZE];
+static kiss_fft_cpx pair_b[KISS_FFT_OUT_SIZE];
+static kiss_fft_cpx single_a[KISS_FFT_OUT_SIZE];
+static kiss_fft_cpx single_b[KISS_FFT_OUT_SIZE];
+
+// Largest difference between the two spectra, and the largest magnitude of the reference one
+static double MaxDifference(const kiss_fft_cpx *pair, const kiss_fft_cpx *single, double *max_magnitude)
+{
+    double max_difference = 0.0;
+    for(int k = 0; k < KISS_FFT_OUT_SIZE; k++)
+    {
+        max_difference = fmax(max_difference, fabs((double)pair[k].r - single[k].r));
+        max_difference = fmax(max_difference, fabs((double)pair[k].i - single[k].i));
+        *max_magnitude = fmax(*max_magnitude, hypot((double)single[k].r, (double)single[k].i));
+    }
+    return max_difference;
+}
+
+// Channel a is a sum of sines with noise, b is noise; both peak at the same level, so they share the block scaling
+static void FillChannels(int peak)
+{
+    for(int b = 0; b < CAPTURE_RING_BLOCKS; b++)
+    {
+        for(int i = 0; i < AUDIO_BLOCK_SAMPLES; i++)
+        {
+            const int n = (b * AUDIO_BLOCK_SAMPLES) + i;
+            const double sines = (0.5 * sin(2.0 * M_PI * 1000.0 * n / SAMPLE_RATE)) +
+                                 (0.25 * sin(2.0 * M_PI * 6000.0 * n / SAMPLE_RATE));
+            const double noise = ((double)rand() / RAND_MAX) - 0.5;
+            blocks_a[b][i] = (int16_t)lround(peak * ((0.8 * sines) + (0.2 * noise)));
+            blocks_b[b][i] = (int16_t)lround(peak * 1.6 * ((double)rand() / RAND_MAX - 0.5));
+        }
+        blocks_a[b][0] = (int16_t)peak;
+        blocks_b[b][0] = (int16_t)peak;
+        ringOEM_L[b] = blocks_a[b];
+        ringIEM_L[b] = blocks_b[b];
+    }
+}
+
+int main(void)
+{
+    host_test_boot();
+    srand(1);
+
+    const int peaks[] = {32767, 1000, 40};
+    for(unsigned p = 0; p < (sizeof(peaks) / sizeof(peaks[0])); p++)
+    {
+        FillChannels(peaks[p]);
+        for(int start_block = 0; start_block < CAPTURE_RING_BLOCKS; start_block += FFT_HOP_BLOCKS)
+        {
+            const int shift_pair = ComputeFFTPair(pair_a, pair_b, ringOEM_L, ringIEM_L, start_block);
+            const int shift_a = ComputeFFT(single_a, ringOEM_L, start_block);
+            const int shift_b = ComputeFFT(single_b, ringIEM_L, start_block);
+            CHECK((shift_pair == shift_a) && (shift_pair == shift_b));
+
+            double max_magnitude = 0.0;
+            const double difference_a = MaxDifference(pair_a, single_a, &max_magnitude);
+            const double difference_b = MaxDifference(pair_b, single_b, &max_magnitude);
+            const double difference = fmax(difference_a, difference_b);
+            if(start_block == 0)
+            {
+                printf("peak %5d: largest difference %g for magnitudes up to %g\n", peaks[p], difference,
+                       max_magnitude);
+            }
+#ifdef FIXED_POINT
+            CHECK(difference <= PAIR_TOLERANCE);
+#else
+            CHECK(difference <= (1e-6 * fmax(1.0, max_magnitude)));
+#endif
+        }
+    }
+
+    return host_test_exit_code();
+}
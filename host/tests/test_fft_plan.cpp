@@ -0,0 +1,84 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+// The FFT plans are built once by audio_initialise, in the static storage of their engine, and no test builds another
+// one nor allocates from the heap. The engine transforms like a plan of its own.
+
+#include "audio.cpp"
+
+#include "host_test.h"
+
+#ifdef FFT_PAIRED_CHANNELS
+#define NB_ENGINES 3
+#else
+#define NB_ENGINES 2
+#endif
+
+// The plan must live inside the storage of its engine
+static bool PlanInStorage(const void *cfg, const uint8_t *mem, size_t mem_size)
+{
+    const uint8_t *plan = (const uint8_t *)cfg;
+    return (plan >= mem) && (plan < (mem + mem_size));
+}
+
+int main(void)
+{
+    const uint32_t nb_plans = host_get_nb_fft_plans();
+    const uint32_t nb_heap_allocations = host_get_nb_heap_allocations();
+
+    host_test_boot();
+
+    CHECK(host_get_nb_fft_plans() == (nb_plans + NB_ENGINES));
+    CHECK(PlanInStorage(fft_engine.cfg, fft_engine.mem, sizeof(fft_engine.mem)));
+    CHECK(PlanInStorage(fft_inverse_engine.cfg, fft_inverse_engine.mem, sizeof(fft_inverse_engine.mem)));
+#ifdef FFT_PAIRED_CHANNELS
+    CHECK(PlanInStorage(fft_pair_engine.cfg, fft_pair_engine.mem, sizeof(fft_pair_engine.mem)));
+#endif
+    CHECK(host_get_nb_heap_allocations() == nb_heap_allocations);
+
+    size_t mem_needed = 0;
+    kiss_fftr_alloc(FFTSIZE, 0, NULL, &mem_needed);
+    printf("real plan: %zu bytes needed, %zu reserved\n", mem_needed, sizeof(fft_engine.mem));
+    CHECK(mem_needed <= sizeof(fft_engine.mem));
+
+    // Every test function, each one used to build and free five plans per frame
+    stray_test_result_t r[6];
+    CHECK(audio_run_test0_1_2b(&r[0], &r[1], &r[2], &r[3], &r[4], &r[5]));
+    CHECK(audio_run_test2a_3(&r[0], &r[1], &r[2], &r[3], &r[4], &r[5]));
+    CHECK(audio_get_last_test_nb_frames() > 0);
+    CHECK(host_get_nb_fft_plans() == (nb_plans + NB_ENGINES));
+    CHECK(host_get_nb_heap_allocations() == nb_heap_allocations);
+
+    // Same output as a plan allocated for the transform, the former path
+    static kiss_fft_scalar in[FFTSIZE];
+    static kiss_fft_cpx out_engine[KISS_FFT_OUT_SIZE];
+    static kiss_fft_cpx out_alloc[KISS_FFT_OUT_SIZE];
+    srand(1);
+    for(int i = 0; i < FFTSIZE; i++)
+    {
+#ifdef FIXED_POINT
+        in[i] = (kiss_fft_scalar)((rand() % 65536) - 32768);
+#else
+        in[i] = ((float)rand() / RAND_MAX) - 0.5f;
+#endif
+    }
+    FFTEngineForward(&fft_engine, in, out_engine);
+    kiss_fftr_cfg cfg = kiss_fftr_alloc(FFTSIZE, 0, NULL, NULL);
+    CHECK(cfg != NULL);
+    kiss_fftr(cfg, in, out_alloc);
+    kiss_fftr_free(cfg);
+    CHECK(memcmp(out_engine, out_alloc, sizeof(out_engine)) == 0);
+
+    return host_test_exit_code();
+}
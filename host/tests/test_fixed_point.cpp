@@ -0,0 +1,120 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+// The fixed-point builds must give the curves of the float build: the host stand-ins are seeded, so every build
+// captures the same samples. The float build saves its curves of tests 0, 1 and 3, the fixed-point builds compare
+// theirs bin by bin over the convergence band, the tests running their full length: q31 within 0.01 dB (1e-5 dB
+// measured). The rounding of the q15 spectra at every stage of kiss fft is a noise of its own, the q15 curves stay
+// within 0.1 dB (0.042 dB measured) and, with the convergence stop on, never meet its bound.
+//
+//   test_fixed_point <curves file>
+
+#include "audio.cpp"
+
+#include "host_test.h"
+
+#define NB_RUNS 3
+
+#if defined(FIXED_POINT) && (FIXED_POINT == 16)
+#define FIXED_POINT_TOLERANCE_DB 0.1
+#else
+#define FIXED_POINT_TOLERANCE_DB 0.01
+#endif
+
+typedef struct
+{
+    int nb_frames[NB_RUNS];
+    float tf[NB_RUNS][4][FFTSIZE / 2];
+} saved_curves_t;
+
+static saved_curves_t curves;
+#ifdef FIXED_POINT
+static saved_curves_t float_curves;
+#endif
+
+static void RunTests(void)
+{
+    stray_test_result_t r[2];
+
+    for(int run = 0; run < NB_RUNS; run++)
+    {
+        switch(run)
+        {
+            case 0:
+                CHECK(audio_run_test0(&r[0], &r[1]));
+                break;
+            case 1:
+                CHECK(audio_run_test1(&r[0], &r[1]));
+                break;
+            default:
+                CHECK(audio_run_test3(&r[0], &r[1]));
+                break;
+        }
+        curves.nb_frames[run] = audio_get_last_test_nb_frames();
+        for(int curve = 0; curve < 4; curve++)
+        {
+            CHECK(audio_get_headset_tf(curves.tf[run][curve], curve));
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    PanicFalse(argc == 2);
+
+    host_test_boot();
+    RunTests();
+
+#ifndef FIXED_POINT
+    FILE *file = fopen(argv[1], "wb");
+    CHECK((file != NULL) && (fwrite(&curves, sizeof(curves), 1, file) == 1));
+#else
+    FILE *file = fopen(argv[1], "rb");
+    CHECK((file != NULL) && (fread(&float_curves, sizeof(float_curves), 1, file) == 1));
+
+    for(int run = 0; run < NB_RUNS; run++)
+    {
+#if(FIXED_POINT == 16)
+        CHECK(curves.nb_frames[run] >= float_curves.nb_frames[run]);
+#else
+        CHECK(curves.nb_frames[run] == float_curves.nb_frames[run]);
+#endif
+
+        for(int curve = 0; curve < 4; curve++)
+        {
+            // Curves a run does not measure are left at TF_NO_DATA_DB by both builds
+            float band_worst = 0.0f;
+            float worst = 0.0f;
+            for(int bin = 1; bin < (FFTSIZE / 2); bin++)
+            {
+                const float difference = fabsf(curves.tf[run][curve][bin] - float_curves.tf[run][curve][bin]);
+                worst = fmaxf(worst, difference);
+                if((bin >= CONVERGENCE_BAND_FIRST_BIN) && (bin <= CONVERGENCE_BAND_LAST_BIN))
+                {
+                    band_worst = fmaxf(band_worst, difference);
+                }
+            }
+            printf("run %d curve %d: %d frames, off the float curve by %.5f dB in the band, %.5f dB overall\n", run,
+                   curve, curves.nb_frames[run], band_worst, worst);
+            CHECK(band_worst <= FIXED_POINT_TOLERANCE_DB);
+        }
+    }
+#endif
+    if(file != NULL)
+    {
+        fclose(file);
+    }
+
+    return host_test_exit_code();
+}
@@ -0,0 +1,223 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+// Limit masks on the acoustic model, whose curves are flat at the gains of the model: a curve 10 dB out of its mask
+// stops its test as soon as the masks are checked, one out by less than its uncertainty runs the full test and still
+// fails, a combined run goes on for the tests that did not fail, and only results that can still pass get masks.
+
+#include "audio.cpp"
+
+#include <vector>
+
+#include "host_test.h"
+
+// Curve ids of audio_get_headset_tf to I2S inputs, see the patch cords
+static const int curve_input[4] = {2, 0, 3, 1};
+
+// The noise of the default model is so low that a curve 0.02 dB out of its mask already stops early: the marginal
+// case runs with more noise
+#define MARGINAL_NOISE 0.05f
+#define MARGINAL_CENTI_DB 5
+
+typedef struct
+{
+    test_type_t test_type;
+    int curve;
+    int lower_centi_db;
+    int upper_centi_db;
+} test_mask_t;
+
+// A blob of flat masks from 200 to 8000 Hz, with its CRC
+static std::vector<uint8_t> MakeBlob(const test_mask_t *masks, int nb_masks)
+{
+    std::vector<uint8_t> blob;
+    const limit_mask_blob_header_t header = {LIMIT_MASK_MAGIC, LIMIT_MASK_VERSION, (uint8_t)nb_masks, 0};
+    blob.insert(blob.end(), (const uint8_t *)&header, (const uint8_t *)(&header + 1));
+
+    for(int m = 0; m < nb_masks; m++)
+    {
+        const limit_mask_header_t mask_header = {(uint8_t)masks[m].test_type, (uint8_t)masks[m].curve, 2};
+        blob.insert(blob.end(), (const uint8_t *)&mask_header, (const uint8_t *)(&mask_header + 1));
+        const limit_mask_point_t points[2] = {
+            {200, (int16_t)masks[m].lower_centi_db, (int16_t)masks[m].upper_centi_db},
+            {8000, (int16_t)masks[m].lower_centi_db, (int16_t)masks[m].upper_centi_db},
+        };
+        blob.insert(blob.end(), (const uint8_t *)points, (const uint8_t *)(points + 2));
+    }
+
+    const uint32_t crc = capture_stream_crc32(0, blob.data(), blob.size());
+    blob.insert(blob.end(), (const uint8_t *)&crc, (const uint8_t *)(&crc + 1));
+    return blob;
+}
+
+static bool LoadMasks(const test_mask_t *masks, int nb_masks)
+{
+    const std::vector<uint8_t> blob = MakeBlob(masks, nb_masks);
+    return audio_load_limit_masks(blob.data(), blob.size());
+}
+
+// Level of a curve in the model, in centi-dB
+static int ExpectedCentiDb(int curve, int shield)
+{
+    host_acoustics_t acoustics;
+    host_get_default_acoustics(&acoustics);
+    return (int)lroundf(100.0f * host_test_pair_gain_db(&acoustics, curve_input[curve], shield));
+}
+
+// Test 2A plays on the calibrator shield
+static int RunTest2A(const char *name, stray_test_result_t r[4])
+{
+    host_reseed(1);
+    CHECK(audio_run_test2a(&r[0], &r[1], &r[2], &r[3]));
+    const int nb_frames = audio_get_last_test_nb_frames();
+    printf("2A %s: %d frames, results %d %d %d %d\n", name, nb_frames, r[0], r[1], r[2], r[3]);
+    return nb_frames;
+}
+
+static int RunSpk(const char *name, stray_test_result_t r[6])
+{
+    host_reseed(1);
+    audio_run_test0_1_2b(&r[0], &r[1], &r[2], &r[3], &r[4], &r[5]);
+    const int nb_frames = audio_get_last_test_nb_frames();
+    printf("SPK %s: %d frames, results %d %d %d %d %d %d\n", name, nb_frames, r[0], r[1], r[2], r[3], r[4], r[5]);
+    return nb_frames;
+}
+
+int main(void)
+{
+    host_test_boot();
+
+    // No convergence stop to hide the early fails
+    stray_test_result_t r[6];
+    audio_set_convergence_bound_db(0.0f);
+
+    const int test2a_nb_frames = DurationToNbFFT(TEST2A_DURATION_SEC);
+    const int spk_nb_frames = DurationToNbFFT(TEST_SPK_DURATION_SEC);
+
+    // Without masks, every test passes
+    CHECK(RunTest2A("no masks", r) == test2a_nb_frames);
+    for(int i = 0; i < 4; i++)
+    {
+        CHECK(r[i] == STRAY_RESULT_SUCCESS);
+    }
+
+    // Every curve inside a 1 dB wide mask around its level
+    std::vector<test_mask_t> masks;
+    for(int curve = 0; curve < 4; curve++)
+    {
+        const int level = ExpectedCentiDb(curve, 1);
+        masks.push_back({TEST_TYPE_2A, curve, level - 50, level + 50});
+    }
+    CHECK(LoadMasks(masks.data(), (int)masks.size()));
+    CHECK(RunTest2A("inside", r) == test2a_nb_frames);
+    for(int i = 0; i < 4; i++)
+    {
+        CHECK(r[i] == STRAY_RESULT_SUCCESS);
+    }
+
+    // Curve 0 10 dB above its upper limit stops the test at the first check after the minimum number of frames, and
+    // fails it alone: the other curves are still judged on what was measured
+    const int level0 = ExpectedCentiDb(0, 1);
+    masks[0] = {TEST_TYPE_2A, 0, LIMIT_MASK_NO_LOWER, level0 - 1000};
+    CHECK(LoadMasks(masks.data(), (int)masks.size()));
+    const int early_nb_frames = RunTest2A("10 dB out", r);
+    CHECK(early_nb_frames == CONVERGENCE_MIN_FRAMES);
+    CHECK(r[0] == STRAY_RESULT_FAIL);
+    for(int i = 1; i < 4; i++)
+    {
+        CHECK(r[i] == STRAY_RESULT_SUCCESS);
+    }
+
+    // Under a lower limit as well
+    masks[0] = {TEST_TYPE_2A, 0, level0 + 1000, LIMIT_MASK_NO_UPPER};
+    CHECK(LoadMasks(masks.data(), (int)masks.size()));
+    CHECK(RunTest2A("10 dB under", r) == CONVERGENCE_MIN_FRAMES);
+    CHECK(r[0] == STRAY_RESULT_FAIL);
+
+    // Out by less than its uncertainty: the full test, then a fail. With the noise of the model the highest bin of
+    // curve 0 is known from a run without masks to within its standard error, the upper limit goes just under it.
+    host_acoustics_t acoustics;
+    host_get_default_acoustics(&acoustics);
+    acoustics.noise = MARGINAL_NOISE;
+    host_set_acoustics(&acoustics);
+    CHECK(LoadMasks(NULL, 0));
+    RunTest2A("noisy, no masks", r);
+    float tf[FFTSIZE / 2];
+    CHECK(audio_get_headset_tf(tf, 0));
+    float highest_db = TF_NO_DATA_DB;
+    for(int bin = 0; bin < (FFTSIZE / 2); bin++)
+    {
+        if((BinFrequencyHz(bin) >= 200.0f) && (BinFrequencyHz(bin) <= 8000.0f))
+        {
+            highest_db = fmaxf(highest_db, tf[bin]);
+        }
+    }
+    masks[0] = {TEST_TYPE_2A, 0, LIMIT_MASK_NO_LOWER, (int)floorf(100.0f * highest_db) - MARGINAL_CENTI_DB};
+    CHECK(LoadMasks(masks.data(), 1));
+    CHECK(RunTest2A("noisy, marginal", r) == test2a_nb_frames);
+    CHECK(r[0] == STRAY_RESULT_FAIL);
+    host_get_default_acoustics(&acoustics);
+    host_set_acoustics(&acoustics);
+
+    // Masks of another test do not apply
+    masks[0] = {TEST_TYPE_0, 0, LIMIT_MASK_NO_LOWER, level0 - 1000};
+    CHECK(LoadMasks(masks.data(), 1));
+    CHECK(RunTest2A("other test", r) == test2a_nb_frames);
+    CHECK(r[0] == STRAY_RESULT_SUCCESS);
+
+    // SPK: the IEM curves of tests 1 and 2B 10 dB out. The run goes on for test 0, which passes.
+    const int level2 = ExpectedCentiDb(2, 0);
+    const int level3 = ExpectedCentiDb(3, 0);
+    const test_mask_t iem_masks[] = {
+        {TEST_TYPE_1, 2, LIMIT_MASK_NO_LOWER, level2 - 1000},
+        {TEST_TYPE_2B, 3, LIMIT_MASK_NO_LOWER, level3 - 1000},
+    };
+    CHECK(LoadMasks(iem_masks, 2));
+    CHECK(RunSpk("IEM 10 dB out", r) == spk_nb_frames);
+    CHECK((r[0] == STRAY_RESULT_SUCCESS) && (r[1] == STRAY_RESULT_SUCCESS));
+    CHECK((r[2] == STRAY_RESULT_FAIL) && (r[3] == STRAY_RESULT_SUCCESS));
+    CHECK((r[4] == STRAY_RESULT_SUCCESS) && (r[5] == STRAY_RESULT_FAIL));
+
+    // Without a headset the IEM results are decided before the run and get no masks: test 0 runs and passes
+    audio_set_headset_connected(false);
+    CHECK(RunSpk("no headset", r) == spk_nb_frames);
+    CHECK((r[0] == STRAY_RESULT_SUCCESS) && (r[1] == STRAY_RESULT_SUCCESS));
+    for(int i = 2; i < 6; i++)
+    {
+        CHECK(r[i] == TEST_RESULT_NO_HEADSET);
+    }
+    audio_set_headset_connected(true);
+
+    // Once test 0 fails too, nothing is left to measure
+    const test_mask_t all_masks[] = {
+        {TEST_TYPE_0, 0, LIMIT_MASK_NO_LOWER, ExpectedCentiDb(0, 0) - 1000},
+        {TEST_TYPE_1, 2, LIMIT_MASK_NO_LOWER, level2 - 1000},
+        {TEST_TYPE_2B, 3, LIMIT_MASK_NO_LOWER, level3 - 1000},
+    };
+    CHECK(LoadMasks(all_masks, 3));
+    CHECK(RunSpk("all tests out", r) == CONVERGENCE_MIN_FRAMES);
+    CHECK((r[0] == STRAY_RESULT_FAIL) && (r[2] == STRAY_RESULT_FAIL) && (r[5] == STRAY_RESULT_FAIL));
+
+    // A blob with a bad CRC is rejected and leaves no masks
+    std::vector<uint8_t> blob = MakeBlob(all_masks, 3);
+    blob[sizeof(limit_mask_blob_header_t) + 1] ^= 1;
+    CHECK(!audio_load_limit_masks(blob.data(), blob.size()));
+    CHECK(RunTest2A("bad CRC", r) == test2a_nb_frames);
+    for(int i = 0; i < 4; i++)
+    {
+        CHECK(r[i] == STRAY_RESULT_SUCCESS);
+    }
+
+    return host_test_exit_code();
+}
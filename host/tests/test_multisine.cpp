@@ -0,0 +1,119 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+// The periodic multisine: its period has a crest factor of about 1.8 and a pink spectrum, the latency measurement
+// falls back to pink noise, a test converges after MULTISINE_CONVERGENCE_MIN_FRAMES frames and its curves read the
+// gains of the acoustic model at every bin, there being no leakage through the rectangular window.
+
+#include "audio.cpp"
+
+#include "host_test.h"
+
+// Curve ids of audio_get_headset_tf to I2S inputs, see the patch cords
+static const int curve_input[4] = {2, 0, 3, 1};
+
+
+static void CheckPeriod(void)
+{
+    double sum_squares = 0.0;
+    int peak = 0;
+    for(int n = 0; n < FFTSIZE; n++)
+    {
+        sum_squares += (double)multisine_period[n] * multisine_period[n];
+        peak = (abs(multisine_period[n]) > peak) ? abs(multisine_period[n]) : peak;
+    }
+    const double crest_factor = peak / sqrt(sum_squares / FFTSIZE);
+    printf("period: peak %d, crest factor %.3f\n", peak, crest_factor);
+    CHECK(peak == (int)MULTISINE_AMPLITUDE);
+    CHECK_NEAR(crest_factor, 1.8, 0.1);
+
+    // Pink: k |X_k|^2 is the same at every bin but DC and Nyquist, up to the quantisation of the period
+    double lowest_db = INFINITY;
+    double highest_db = -INFINITY;
+    for(int k = 1; k < (FFTSIZE / 2); k++)
+    {
+        const double re = multisine_spectrum[k].r;
+        const double im = multisine_spectrum[k].i;
+        const double level_db = 10.0 * log10(k * ((re * re) + (im * im)));
+        lowest_db = fmin(lowest_db, level_db);
+        highest_db = fmax(highest_db, level_db);
+    }
+    printf("period: k |X_k|^2 within %.4f dB\n", highest_db - lowest_db);
+    CHECK((highest_db - lowest_db) < 0.5);
+}
+
+// Runs test 2A, which must stop after MULTISINE_CONVERGENCE_MIN_FRAMES frames with every bin of the convergence band
+// within tolerance_db of the model
+static void RunTest2A(const host_acoustics_t *acoustics, float tolerance_db)
+{
+    const uint32_t nb_heap_allocations = host_get_nb_heap_allocations();
+    stray_test_result_t r[4];
+    CHECK(audio_run_test2a(&r[0], &r[1], &r[2], &r[3]));
+    const int nb_frames = audio_get_last_test_nb_frames();
+    printf("test 2A, model noise %g: %d frames\n", acoustics->noise, nb_frames);
+    CHECK(nb_frames == MULTISINE_CONVERGENCE_MIN_FRAMES);
+    CHECK(host_get_nb_heap_allocations() == nb_heap_allocations);
+
+    for(int curve = 0; curve < 4; curve++)
+    {
+        float tf[FFTSIZE / 2];
+        CHECK(audio_get_headset_tf(tf, curve));
+        CHECK(r[curve] == STRAY_RESULT_SUCCESS);
+
+        const float expected_db = host_test_pair_gain_db(acoustics, curve_input[curve], 1);
+        float worst = 0.0f;
+        for(int bin = CONVERGENCE_BAND_FIRST_BIN; bin <= CONVERGENCE_BAND_LAST_BIN; bin++)
+        {
+            worst = fmaxf(worst, fabsf(tf[bin] - expected_db));
+        }
+        printf("curve %d: expected %.3f dB, worst bin off by %.4f dB\n", curve, expected_db, worst);
+        CHECK(worst < tolerance_db);
+    }
+}
+
+int main(void)
+{
+    host_test_boot();
+
+    host_acoustics_t acoustics;
+    host_get_default_acoustics(&acoustics);
+
+    // Either excitation turns the other off
+    audio_set_multisine_excitation(true);
+    audio_set_sweep_excitation(true);
+    CHECK(sweep_excitation && !multisine_excitation);
+    audio_set_multisine_excitation(true);
+    CHECK(!sweep_excitation && multisine_excitation);
+
+    CheckPeriod();
+
+    // The latency is measured on pink noise: a periodic excitation would correlate at every period
+    CHECK(audio_measure_latency());
+    int delays[4];
+    CHECK(audio_get_latency_samples(delays));
+    for(int curve = 0; curve < 4; curve++)
+    {
+        CHECK(delays[curve] == (acoustics.delay_samples[curve_input[curve]] + HOST_AUDIO_PIPELINE_SAMPLES));
+    }
+    CHECK(multisine_excitation);
+
+    // With the noise of the model, then without: what is left is the quantisation of the period
+    audio_set_convergence_bound_db(CONVERGENCE_BOUND_DB);
+    RunTest2A(&acoustics, 0.1f);
+    acoustics.noise = 0.0f;
+    host_set_acoustics(&acoustics);
+    RunTest2A(&acoustics, 0.005f);
+
+    return host_test_exit_code();
+}
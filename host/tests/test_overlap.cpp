@@ -0,0 +1,72 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+// Overlapped frames: in the same duration a test analyses a frame every FFT_HOP_BLOCKS blocks, twice as many frames at
+// 50 percent and four times at 75, and its curves still read the gains of the acoustic model.
+
+#include "audio.cpp"
+
+#include "host_test.h"
+
+// Curve ids of audio_get_headset_tf to I2S inputs, see the patch cords
+static const int curve_input[4] = {2, 0, 3, 1};
+
+// Priming and latency of the chain around the frames of a test
+#define OVERHEAD_BLOCKS (4 * NB_BLOCKS_IN_FFTSIZE)
+
+int main(void)
+{
+    host_test_boot();
+
+    host_acoustics_t acoustics;
+    host_get_default_acoustics(&acoustics);
+
+    stray_test_result_t r[4];
+    audio_set_convergence_bound_db(0.0f);
+
+    const uint32_t nb_blocks_before = host_get_nb_audio_blocks();
+    CHECK(audio_run_test2a(&r[0], &r[1], &r[2], &r[3]));
+    const uint32_t nb_blocks = host_get_nb_audio_blocks() - nb_blocks_before;
+    const int nb_frames = audio_get_last_test_nb_frames();
+
+    // Frames of the test: one per hop, once the first fills the ring
+    const int nb_frames_no_overlap = (TEST2A_DURATION_SEC * SAMPLE_RATE) / FFTSIZE;
+    printf("overlap %d%%: %d frames (%d without overlap) in %u blocks\n", FFT_OVERLAP_PERCENT, nb_frames,
+           nb_frames_no_overlap, nb_blocks);
+    CHECK(nb_frames == DurationToNbFFT(TEST2A_DURATION_SEC));
+    CHECK(nb_frames >= ((nb_frames_no_overlap * NB_BLOCKS_IN_FFTSIZE) / FFT_HOP_BLOCKS) - 1);
+    CHECK(nb_blocks >= (uint32_t)(((nb_frames - 1) * FFT_HOP_BLOCKS) + NB_BLOCKS_IN_FFTSIZE));
+    CHECK(nb_blocks <= (uint32_t)(((TEST2A_DURATION_SEC * SAMPLE_RATE) / AUDIO_BLOCK_SAMPLES) + OVERHEAD_BLOCKS));
+
+    for(int curve = 0; curve < 4; curve++)
+    {
+        float tf[FFTSIZE / 2];
+        CHECK(audio_get_headset_tf(tf, curve));
+
+        const float expected_db = host_test_pair_gain_db(&acoustics, curve_input[curve], 1);
+        double sum = 0.0;
+        float worst = 0.0f;
+        for(int bin = CONVERGENCE_BAND_FIRST_BIN; bin <= CONVERGENCE_BAND_LAST_BIN; bin++)
+        {
+            sum += tf[bin];
+            worst = fmaxf(worst, fabsf(tf[bin] - expected_db));
+        }
+        const double mean = sum / CONVERGENCE_BAND_NB_BINS;
+        printf("curve %d: mean %.4f dB, expected %.4f dB, worst bin off by %.4f dB\n", curve, mean, expected_db, worst);
+        CHECK_NEAR(mean, expected_db, 0.02);
+        CHECK(worst < CONVERGENCE_BOUND_DB);
+    }
+
+    return host_test_exit_code();
+}
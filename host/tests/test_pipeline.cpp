@@ -0,0 +1,87 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+// The pipelined chain against the analysis it replaced: the blocks of a test, streamed over the USB serial stand-in,
+// are analysed again one frame at a time, each frame transformed and accumulated at once as the chain used to do
+// after the block completing it. The accumulators must come out bit for bit the same.
+
+#include "audio.cpp"
+
+#include <vector>
+
+#include "host_test.h"
+
+static std::vector<uint8_t> stream;
+
+static void StreamSink(const uint8_t *data, size_t size)
+{
+    stream.insert(stream.end(), data, data + size);
+}
+
+static arena_accum_t chain_accum;
+
+int main(void)
+{
+    host_test_boot();
+
+    stray_test_result_t r[4];
+    host_set_serial_sink(StreamSink);
+    audio_set_capture_streaming(true);
+    CHECK(audio_run_test2a(&r[0], &r[1], &r[2], &r[3]));
+    audio_set_capture_streaming(false);
+    const int nb_frames = audio_get_last_test_nb_frames();
+    memcpy(&chain_accum, &arena_accum_or_latency.accum, sizeof(chain_accum));
+
+    // The analysed blocks, in capture order
+    const size_t frame_size = sizeof(capture_stream_header_t) +
+                              (NB_CAPTURE_STREAM_CHANNELS * AUDIO_BLOCK_SAMPLES * sizeof(int16_t)) + sizeof(uint32_t);
+    std::vector<const int16_t *> blocks;
+    for(size_t offset = 0; (offset + frame_size) <= stream.size(); offset += frame_size)
+    {
+        capture_stream_header_t header;
+        memcpy(&header, &stream[offset], sizeof(header));
+        if(header.flags & CAPTURE_STREAM_FLAG_ANALYSED)
+        {
+            blocks.push_back((const int16_t *)&stream[offset + sizeof(header)]);
+        }
+    }
+    printf("test 2A: %d frames, %zu analysed blocks\n", nb_frames, blocks.size());
+    CHECK(blocks.size() == (size_t)(nb_frames * NB_BLOCKS_IN_FFTSIZE));
+
+    // Each frame copied to the start of the ring, then transformed and accumulated in one go
+    ResetChain();
+    int16_t *const rings[NB_CAPTURE_STREAM_CHANNELS] = {bOEM_L, bIEM_L, bOEM_R, bIEM_R, bNoise_delayed};
+    for(int frame = 0; frame < nb_frames; frame++)
+    {
+        for(int b = 0; b < NB_BLOCKS_IN_FFTSIZE; b++)
+        {
+            const int16_t *block = blocks[(frame * NB_BLOCKS_IN_FFTSIZE) + b];
+            for(int c = 0; c < NB_CAPTURE_STREAM_CHANNELS; c++)
+            {
+                memcpy(&rings[c][b * AUDIO_BLOCK_SAMPLES], &block[c * AUDIO_BLOCK_SAMPLES],
+                       AUDIO_BLOCK_SAMPLES * sizeof(int16_t));
+            }
+        }
+        PublishFrameSet(0);
+        while(!RunAnalysisStep(true))
+        {
+        }
+    }
+
+    const bool same = (memcmp(&chain_accum, &arena_accum_or_latency.accum, sizeof(chain_accum)) == 0);
+    printf("accumulators %s\n", same ? "identical" : "differ");
+    CHECK(same);
+
+    return host_test_exit_code();
+}
@@ -0,0 +1,155 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+// Scheduling of RunChain on the audio block notifications, with blocks arriving unevenly:
+// - the capture deadline is checked against the block being captured, the oldest one queued
+// - a whole test on jittered blocks counts as many overruns as there were gaps past the deadline, and still passes
+// - the chain panics once the audio interrupt gets more than a block ahead of the capture
+
+#include "audio.cpp"
+
+#include <setjmp.h>
+
+#include "host_test.h"
+
+#define LONG_GAP_EVERY_NB_BLOCKS 16
+#define LONG_GAP_US ((5 * AUDIO_BLOCK_PERIOD_US) / 2)
+
+static void QueueBlockAfter(uint32_t us)
+{
+    host_advance_us(us);
+    CHECK(host_run_audio_update());
+}
+
+// Starts the chain with empty record queues. The I2S input transmits from its second update on, which the latency
+// measurement of audio_initialise already ran.
+static void StartChain(void)
+{
+    ResetChain();
+    enableAudioChain();
+    CHECK(host_run_audio_update());
+    audio_reset_record_queues();
+}
+
+// Captures the oldest block, as RunChainFrames does once another one is queued behind it
+static void CaptureBlock(void)
+{
+    CHECK(RecordQueuesNotEmpty());
+    CheckBlockDeadline();
+    ManageQueueBuffers(TEST_TYPE_0, 0);
+}
+
+static void CheckDeadlineOfOldestBlock(void)
+{
+    StartChain();
+
+    QueueBlockAfter(AUDIO_BLOCK_PERIOD_US);
+    QueueBlockAfter(AUDIO_BLOCK_PERIOD_US / 4); //early
+    CaptureBlock(); //block 0, a quarter period old
+    CHECK(nb_block_overruns == 0);
+
+    QueueBlockAfter(LONG_GAP_US);
+    CaptureBlock(); //block 1, 2.5 periods old
+    CHECK(nb_block_overruns == 1);
+
+    QueueBlockAfter(CAPTURE_DEADLINE_US);
+    CaptureBlock(); //block 2, right on its deadline
+    CHECK(nb_block_overruns == 1);
+
+    QueueBlockAfter(AUDIO_BLOCK_PERIOD_US / 8);
+    CaptureBlock(); //block 3, the one after a long gap is early
+    CHECK(nb_block_overruns == 1);
+
+    disableAudioChain();
+}
+
+static uint32_t nb_idle_blocks;
+static uint32_t nb_long_gaps;
+
+// Blocks on an uneven clock: mostly short gaps, every LONG_GAP_EVERY_NB_BLOCKS a gap past the deadline, so the block
+// waiting in the queue gets captured late
+static void JitteredAudioBlock(void)
+{
+    nb_idle_blocks++;
+    if((nb_idle_blocks % LONG_GAP_EVERY_NB_BLOCKS) == 0)
+    {
+        host_advance_us(LONG_GAP_US);
+        nb_long_gaps++;
+    }
+    else
+    {
+        host_advance_us(((nb_idle_blocks % 2) == 0) ? (AUDIO_BLOCK_PERIOD_US / 2) : AUDIO_BLOCK_PERIOD_US);
+    }
+    host_run_audio_update();
+}
+
+static void CheckJitteredTest(void)
+{
+    audio_set_idle_callback(JitteredAudioBlock);
+    nb_idle_blocks = 0;
+    nb_long_gaps = 0;
+
+    stray_test_result_t r[2];
+    CHECK(audio_run_test1(&r[0], &r[1]));
+    CHECK((r[0] == STRAY_RESULT_SUCCESS) && (r[1] == STRAY_RESULT_SUCCESS));
+    printf("jittered test 1: %d frames, %lu blocks, %lu long gaps, %d overruns\n", audio_get_last_test_nb_frames(),
+           (unsigned long)nb_idle_blocks, (unsigned long)nb_long_gaps, audio_get_block_overruns());
+    CHECK(nb_long_gaps > 0);
+    CHECK(audio_get_block_overruns() == (int)nb_long_gaps);
+
+    audio_set_idle_callback(host_audio_block);
+}
+
+static jmp_buf panic_jump;
+
+static void PanicJump(void)
+{
+    longjmp(panic_jump, 1);
+}
+
+// The interrupt queues two blocks while one waits: three queued blocks mean the capture fell behind
+static void CheckQueueOverflowPanics(void)
+{
+    StartChain();
+
+    QueueBlockAfter(AUDIO_BLOCK_PERIOD_US);
+    QueueBlockAfter(AUDIO_BLOCK_PERIOD_US);
+    QueueBlockAfter(AUDIO_BLOCK_PERIOD_US);
+
+    bool panicked = false;
+    host_set_panic_handler(PanicJump);
+    if(setjmp(panic_jump) == 0)
+    {
+        (void)RecordQueuesNotEmpty();
+    }
+    else
+    {
+        panicked = true;
+    }
+    host_set_panic_handler(NULL);
+    CHECK(panicked);
+
+    disableAudioChain();
+}
+
+int main(void)
+{
+    host_test_boot();
+
+    CheckDeadlineOfOldestBlock();
+    CheckJitteredTest();
+    CheckQueueOverflowPanics();
+
+    return host_test_exit_code();
+}
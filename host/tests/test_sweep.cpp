@@ -0,0 +1,123 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+// Sweep excitation on the acoustic model, test 0 (curves 0 and 1):
+// - plain gains and a 2-tap FIR (an echo one sample later) are measured within 0.03 dB at every bin of the band
+// - a square law distortion leaves the fundamental at the linear gain, and shows up in the 2f band curves 4 and 5 at
+//   20 log10(square * SWEEP_AMPLITUDE * G^2 / 2), G the linear gain to the mic and the sweep at SWEEP_AMPLITUDE:
+//   within 0.5 dB at -30 dB, within 2 dB at -50 dB (it reads 1.5 dB high there)
+
+#include "audio.cpp"
+
+#include "host_test.h"
+
+#define SWEEP_TOLERANCE_DB 0.03
+
+static const int curve_input[2] = {2, 0};
+
+// Linear gain of both speakers of shield 0 to each mic, so that with the shield volume it is 0.5 (-6.02 dB). Without
+// noise, to measure the sweep analysis alone.
+static void SetGain(host_acoustics_t *acoustics)
+{
+    acoustics->noise = 0.0f;
+    const float gain = 0.5f / (2.0f * AudioControlSGTL5000::volume_of_shield[0]);
+    for(int in = 0; in < 4; in++)
+    {
+        for(int out = 0; out < 4; out++)
+        {
+            acoustics->gain[in][out] = gain;
+        }
+    }
+}
+
+// Runs test 0 and checks curves 0 and 1 against 20 log10 |G (1 + echo e^-jw)| at each bin of the band from first_bin
+static void CheckSweep(const char *name, const host_acoustics_t *acoustics, int first_bin)
+{
+    host_set_acoustics(acoustics);
+    stray_test_result_t r[2];
+    CHECK(audio_run_test0(&r[0], &r[1]));
+    CHECK((r[0] == STRAY_RESULT_SUCCESS) && (r[1] == STRAY_RESULT_SUCCESS));
+
+    for(int curve = 0; curve < 2; curve++)
+    {
+        const int in = curve_input[curve];
+        const float gain_db = host_test_pair_gain_db(acoustics, in, 0);
+        const double echo = acoustics->echo[in];
+
+        float tf[FFTSIZE / 2];
+        CHECK(audio_get_headset_tf(tf, curve));
+        float worst = 0.0f;
+        for(int bin = first_bin; bin <= CONVERGENCE_BAND_LAST_BIN; bin++)
+        {
+            const double w = (2.0 * M_PI * bin) / FFTSIZE;
+            const double fir_db = 10.0 * log10(1.0 + (echo * echo) + (2.0 * echo * cos(w)));
+            worst = fmaxf(worst, fabsf(tf[bin] - (gain_db + (float)fir_db)));
+        }
+        printf("%s, curve %d: worst bin off by %.4f dB\n", name, curve, worst);
+        CHECK(worst <= SWEEP_TOLERANCE_DB);
+    }
+}
+
+static void CheckDistortion(host_acoustics_t *acoustics, float square, double band2f_tolerance_db)
+{
+    for(int in = 0; in < 4; in++)
+    {
+        acoustics->square[in] = square;
+    }
+    CheckSweep("square law", acoustics, CONVERGENCE_BAND_FIRST_BIN + 3); //its DC leaks into the lowest bins
+
+    const double g = 0.5;
+    const double expected_db = 20.0 * log10((square * (SWEEP_AMPLITUDE / 32768.0) * g * g) / 2.0);
+    for(int curve = 0; curve < 2; curve++)
+    {
+        float band2f[FFTSIZE / 2];
+        CHECK(audio_get_headset_tf(band2f, 4 + curve));
+
+        // Fundamentals whose second harmonic is still in the band
+        double sum = 0.0;
+        int nb_bins = 0;
+        for(int bin = CONVERGENCE_BAND_FIRST_BIN; (2 * bin) <= CONVERGENCE_BAND_LAST_BIN; bin++)
+        {
+            sum += band2f[bin];
+            nb_bins++;
+        }
+        printf("square law %.2f, 2f band of curve %d: %.2f dB, expected %.2f dB\n", square, curve, sum / nb_bins,
+               expected_db);
+        CHECK_NEAR(sum / nb_bins, expected_db, band2f_tolerance_db);
+    }
+}
+
+int main(void)
+{
+    host_test_boot();
+    audio_set_sweep_excitation(true);
+
+    host_acoustics_t acoustics;
+    host_get_default_acoustics(&acoustics);
+    SetGain(&acoustics);
+    CheckSweep("gains", &acoustics, CONVERGENCE_BAND_FIRST_BIN);
+
+    for(int in = 0; in < 4; in++)
+    {
+        acoustics.echo[in] = 0.5f;
+    }
+    CheckSweep("2-tap FIR", &acoustics, CONVERGENCE_BAND_FIRST_BIN);
+
+    host_get_default_acoustics(&acoustics);
+    SetGain(&acoustics);
+    CheckDistortion(&acoustics, 0.05f, 2.0);
+    CheckDistortion(&acoustics, 0.5f, 0.5);
+
+    return host_test_exit_code();
+}
@@ -0,0 +1,98 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+// The TF cache: fast_log2f() against log2 over the normal floats, the cached curves against 10 log10(yy / xx) of the
+// accumulators in double, and the cache invalidated by a new test and by the sweep excitation.
+
+#include "audio.cpp"
+
+#include "host_test.h"
+
+#define FAST_LOG2F_TOLERANCE 1e-5
+#define TF_CACHE_TOLERANCE_DB 3e-5
+
+// Every 61st normal positive float, which covers every exponent with a spread of mantissas
+static void CheckFastLog2f(void)
+{
+    double worst = 0.0;
+    for(uint32_t bits = 0x00800000UL; bits < 0x7F800000UL; bits += 61)
+    {
+        float x;
+        memcpy(&x, &bits, sizeof(x));
+        worst = fmax(worst, fabs(fast_log2f(x) - log2((double)x)));
+    }
+    printf("fast_log2f: off log2 by %.3g at most\n", worst);
+    CHECK(worst <= FAST_LOG2F_TOLERANCE);
+}
+
+static void CheckCurves(const char *test)
+{
+    const tf_accum_t *cumul[4] = {MOEMLSquaredCumul, MOEMRSquaredCumul, MIEMLSquaredCumul, MIEMRSquaredCumul};
+    const float(*curves)[FFTSIZE / 2] = NULL;
+    CHECK(audio_get_headset_tf_curves(&curves) == 4);
+    CHECK(curves == tf_cache);
+
+    double worst = 0.0;
+    for(int curve = 0; curve < 4; curve++)
+    {
+        for(int bin = 0; bin < (FFTSIZE / 2); bin++)
+        {
+            const double xx = (double)NoiseSquaredCumul[bin];
+            const double yy = (double)cumul[curve][bin];
+            if((xx > 0.0) && (yy > 0.0))
+            {
+                worst = fmax(worst, fabs(curves[curve][bin] - (10.0 * log10(yy / xx))));
+            }
+            else
+            {
+                CHECK(curves[curve][bin] == TF_NO_DATA_DB);
+            }
+        }
+    }
+    printf("test %s: cached curves off 10 log10(yy / xx) by %.3g dB at most\n", test, worst);
+    CHECK(worst <= TF_CACHE_TOLERANCE_DB);
+}
+
+int main(void)
+{
+    host_test_boot();
+
+    CheckFastLog2f();
+
+    stray_test_result_t r[4];
+    CHECK(audio_run_test0(&r[0], &r[1]));
+    CHECK(!tf_cache_valid);
+    CheckCurves("0");
+    CHECK(tf_cache_valid);
+
+    // Copies come from the cache, which stays valid until a new test
+    float tf[FFTSIZE / 2];
+    CHECK(audio_get_headset_tf(tf, 1));
+    CHECK(memcmp(tf, tf_cache[1], sizeof(tf)) == 0);
+    CHECK(tf_cache_valid);
+
+    CHECK(audio_run_test2a(&r[0], &r[1], &r[2], &r[3]));
+    CHECK(!tf_cache_valid);
+    CheckCurves("2A");
+
+    // The sweep changes the number of curves
+    audio_set_sweep_excitation(true);
+    CHECK(!tf_cache_valid);
+    const float(*curves)[FFTSIZE / 2] = NULL;
+    CHECK(audio_get_headset_tf_curves(&curves) == 8);
+    audio_set_sweep_excitation(false);
+    CHECK(!tf_cache_valid);
+
+    return host_test_exit_code();
+}
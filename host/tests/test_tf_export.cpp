@@ -0,0 +1,112 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+// The export packet of the curves of a test: its size at 1/6 octave and at full resolution, its header and CRC, and
+// values that are the centi-dB of the curves, power averaged over the bins of each band.
+
+#include "audio.cpp"
+
+#include "host_test.h"
+
+static uint8_t packet[TF_EXPORT_PACKET_MAX_SIZE(8, FFTSIZE / 2)] __attribute__((aligned(2)));
+
+// Checks the header and CRC of a packet of nb_curves curves, returns its number of points
+static int CheckPacket(size_t length, tf_export_resolution_t resolution, int nb_curves)
+{
+    tf_export_header_t header;
+    memcpy(&header, packet, sizeof(header));
+    CHECK(header.magic == TF_EXPORT_MAGIC);
+    CHECK(header.sample_rate == SAMPLE_RATE);
+    CHECK(header.fft_size == FFTSIZE);
+    CHECK(header.end_bin == (FFTSIZE / 2));
+    CHECK(header.test_type == TEST_TYPE_2A);
+    CHECK(header.resolution == resolution);
+    CHECK(header.nb_curves == nb_curves);
+
+    const size_t table_size = (resolution == TF_EXPORT_BINS) ? 0 : (header.nb_points * sizeof(uint16_t));
+    const size_t values_size = nb_curves * header.nb_points * sizeof(int16_t);
+    CHECK(length == (sizeof(header) + table_size + values_size + sizeof(uint32_t)));
+
+    uint32_t crc;
+    memcpy(&crc, &packet[length - sizeof(crc)], sizeof(crc));
+    CHECK(crc == capture_stream_crc32(0, packet, length - sizeof(crc)));
+    return header.nb_points;
+}
+
+static int16_t PacketValue(size_t offset, int curve, int nb_points, int point)
+{
+    int16_t value;
+    memcpy(&value, &packet[offset + (((curve * nb_points) + point) * sizeof(int16_t))], sizeof(value));
+    return value;
+}
+
+int main(void)
+{
+    host_test_boot();
+
+    stray_test_result_t r[4];
+    CHECK(audio_run_test2a(&r[0], &r[1], &r[2], &r[3]));
+    const float(*curves)[FFTSIZE / 2] = NULL;
+    CHECK(audio_get_headset_tf_curves(&curves) == 4);
+
+    // Every bin
+    size_t length = audio_export_headset_tf(packet, sizeof(packet), TF_EXPORT_BINS);
+    printf("full resolution: %zu bytes, against %zu bytes of floats\n", length, 4 * sizeof(curves[0]));
+    CHECK(CheckPacket(length, TF_EXPORT_BINS, 4) == (FFTSIZE / 2));
+    for(int curve = 0; curve < 4; curve++)
+    {
+        for(int bin = 0; bin < (FFTSIZE / 2); bin++)
+        {
+            const int16_t expected = (int16_t)fmax(lround(100.0 * curves[curve][bin]), TF_EXPORT_CENTI_DB_MIN);
+            CHECK(PacketValue(sizeof(tf_export_header_t), curve, FFTSIZE / 2, bin) == expected);
+        }
+    }
+
+    // 1/6 octave bands, power averages of their bins
+    length = audio_export_headset_tf(packet, sizeof(packet), TF_EXPORT_OCTAVE_6);
+    const int nb_bands = CheckPacket(length, TF_EXPORT_OCTAVE_6, 4);
+    printf("1/6 octave: %d bands, %zu bytes\n", nb_bands, length);
+    CHECK(length == 460);
+    const uint16_t *first_bins = (const uint16_t *)&packet[sizeof(tf_export_header_t)];
+    const size_t values_offset = sizeof(tf_export_header_t) + (nb_bands * sizeof(uint16_t));
+    int worst = 0;
+    for(int curve = 0; curve < 4; curve++)
+    {
+        for(int band = 0; band < nb_bands; band++)
+        {
+            const int end = ((band + 1) < nb_bands) ? first_bins[band + 1] : (FFTSIZE / 2);
+            double power_sum = 0.0;
+            for(int bin = first_bins[band]; bin < end; bin++)
+            {
+                power_sum += pow(10.0, curves[curve][bin] / 10.0);
+            }
+            const long expected = lround(1000.0 * log10(power_sum / (end - first_bins[band])));
+            const int off = abs((int)(PacketValue(values_offset, curve, nb_bands, band) - expected));
+            worst = (off > worst) ? off : worst;
+        }
+    }
+    printf("1/6 octave: off the band averages by %d centi-dB at most\n", worst);
+    CHECK(worst <= 1);
+
+    // Too small a buffer
+    CHECK(audio_export_headset_tf(packet, length - 1, TF_EXPORT_OCTAVE_6) == 0);
+
+    // With the sweep, the 2f band curves go with the fundamentals
+    audio_set_sweep_excitation(true);
+    length = audio_export_headset_tf(packet, sizeof(packet), TF_EXPORT_OCTAVE_6);
+    CHECK(CheckPacket(length, TF_EXPORT_OCTAVE_6, 8) == nb_bands);
+    audio_set_sweep_excitation(false);
+
+    return host_test_exit_code();
+}
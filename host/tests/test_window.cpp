@@ -0,0 +1,75 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+// The compile-time window tables, for every window at 1024, 2048 and 4096 points: the window computed in double with
+// the library cos and rounded to q1.15, symmetric, peaking at full scale. The constexpr cos may round the other way
+// on a value right between two steps, hence the 1 LSB allowed.
+
+#include <math.h>
+
+#include "analysis_window.h"
+#include "host_test.h"
+
+template <int N, analysis_window_t W> static void CheckWindow(const char *name)
+{
+    static constexpr AnalysisWindowQ15<N, W> table;
+
+    static const double coefficients[][5] = {
+        {0.5, 0.5, 0.0, 0.0, 0.0},                                       //Hann
+        {0.54, 0.46, 0.0, 0.0, 0.0},                                     //Hamming
+        {0.35875, 0.48829, 0.14128, 0.01168, 0.0},                       //Blackman-Harris
+        {0.21557895, 0.41663158, 0.277263158, 0.083578947, 0.006947368}, //flat-top
+        {1.0, 0.0, 0.0, 0.0, 0.0},                                       //rectangular
+    };
+
+    int worst_lsb = 0;
+    int16_t peak = INT16_MIN;
+    bool symmetric = true;
+    for(int n = 0; n < N; n++)
+    {
+        double w = 0.0;
+        for(int k = 0; k < 5; k++)
+        {
+            const double a = coefficients[W][k];
+            w += ((k % 2) ? -a : a) * cos((2.0 * M_PI * k * n) / (N - 1));
+        }
+        const long expected = lround(fmax(-32768.0, fmin(32767.0, w * 32767.0)));
+        worst_lsb = (int)fmax(worst_lsb, labs(table[n] - expected));
+        peak = (table[n] > peak) ? table[n] : peak;
+        symmetric = symmetric && (table[n] == table[N - 1 - n]);
+    }
+
+    printf("%-16s %4d points: off by %d LSB at most, peak %d\n", name, N, worst_lsb, peak);
+    CHECK(worst_lsb <= 1);
+    CHECK(symmetric);
+    CHECK(peak == 32767);
+}
+
+template <int N> static void CheckWindows(void)
+{
+    CheckWindow<N, ANALYSIS_WINDOW_HANN>("Hann");
+    CheckWindow<N, ANALYSIS_WINDOW_HAMMING>("Hamming");
+    CheckWindow<N, ANALYSIS_WINDOW_BLACKMAN_HARRIS>("Blackman-Harris");
+    CheckWindow<N, ANALYSIS_WINDOW_FLAT_TOP>("flat-top");
+    CheckWindow<N, ANALYSIS_WINDOW_RECTANGULAR>("rectangular");
+}
+
+int main(void)
+{
+    CheckWindows<1024>();
+    CheckWindows<2048>();
+    CheckWindows<4096>();
+
+    return host_test_exit_code();
+}
@@ -0,0 +1,106 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+// The window of each test type: test 1 runs with the Blackman-Harris window and its curves still read the gains of the
+// acoustic model, test 0 keeps the default one, and the multisine excitation overrides either with the rectangular one.
+
+#include "audio.cpp"
+
+#include "host_test.h"
+
+// Curve ids of audio_get_headset_tf to I2S inputs, see the patch cords
+static const int curve_input[4] = {2, 0, 3, 1};
+
+// The window the last run analysed its frames with, in both forms
+static void CheckFrameWindow(const int16_t *expected)
+{
+    CHECK(frame_window == expected);
+#ifndef FIXED_POINT
+    float worst = 0.0f;
+    for(int i = 0; i < FFTSIZE; i++)
+    {
+        worst = fmaxf(worst, fabsf(fftWindow[i] - (expected[i] * Q_SCALING_FACTOR * Q_SCALING_FACTOR)));
+    }
+    CHECK(worst == 0.0f);
+#endif
+}
+
+// Checks the mean and the worst bin of each curve of curve_mask over the convergence band
+static void CheckCurves(const char *test, unsigned curve_mask, const host_acoustics_t *acoustics)
+{
+    for(int curve = 0; curve < 4; curve++)
+    {
+        if(!(curve_mask & (1 << curve)))
+        {
+            continue;
+        }
+
+        float tf[FFTSIZE / 2];
+        CHECK(audio_get_headset_tf(tf, curve));
+
+        const float expected_db = host_test_pair_gain_db(acoustics, curve_input[curve], 0);
+        double sum = 0.0;
+        float worst = 0.0f;
+        for(int bin = CONVERGENCE_BAND_FIRST_BIN; bin <= CONVERGENCE_BAND_LAST_BIN; bin++)
+        {
+            sum += tf[bin];
+            worst = fmaxf(worst, fabsf(tf[bin] - expected_db));
+        }
+        const double mean = sum / CONVERGENCE_BAND_NB_BINS;
+        printf("test %s curve %d: %d frames, mean %.3f dB, expected %.3f dB, worst bin off by %.3f dB\n", test, curve,
+               audio_get_last_test_nb_frames(), mean, expected_db, worst);
+        CHECK_NEAR(mean, expected_db, 0.02);
+        CHECK(worst < CONVERGENCE_BOUND_DB);
+    }
+}
+
+int main(void)
+{
+    host_test_boot();
+
+    host_acoustics_t acoustics;
+    host_get_default_acoustics(&acoustics);
+
+    for(int t = 0; t < NB_TEST_TYPES; t++)
+    {
+        CHECK(test_windows[t] == ANALYSIS_WINDOW);
+    }
+    CheckFrameWindow(WindowTable(ANALYSIS_WINDOW));
+
+    const uint32_t nb_heap_allocations = host_get_nb_heap_allocations();
+    stray_test_result_t r[2];
+
+    audio_set_test_window(TEST_TYPE_1, ANALYSIS_WINDOW_BLACKMAN_HARRIS);
+    CHECK(audio_run_test1(&r[0], &r[1]));
+    CHECK((r[0] == STRAY_RESULT_SUCCESS) && (r[1] == STRAY_RESULT_SUCCESS));
+    CheckFrameWindow(blackman_harris_window.values);
+    CheckCurves("1", 0xc, &acoustics);
+
+    CHECK(audio_run_test0(&r[0], &r[1]));
+    CHECK((r[0] == STRAY_RESULT_SUCCESS) && (r[1] == STRAY_RESULT_SUCCESS));
+    CheckFrameWindow(WindowTable(ANALYSIS_WINDOW));
+    CheckCurves("0", 0x3, &acoustics);
+
+    // The multisine frames hold whole periods, whatever the test selected
+    audio_set_multisine_excitation(true);
+    CHECK(audio_run_test1(&r[0], &r[1]));
+    CheckFrameWindow(rectangular_window.values);
+    audio_set_multisine_excitation(false);
+    CheckFrameWindow(blackman_harris_window.values);
+
+    CHECK(host_get_nb_heap_allocations() == nb_heap_allocations);
+    CHECK(audio_get_block_overruns() == 0);
+
+    return host_test_exit_code();
+}
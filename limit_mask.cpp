@@ -0,0 +1,153 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+#include <Arduino.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "capture_stream.h"
+#include "limit_mask.h"
+
+#define DEBUG_ENABLED
+#include "debug.h"
+
+#define LIMIT_MASK_NB_CURVES 4
+#define LIMIT_MASK_MAX_TEST_TYPE 4 //TEST_TYPE_3
+
+static_assert(sizeof(limit_mask_blob_header_t) == 8, "limit_mask_blob_header_t is part of the EEPROM layout");
+static_assert(sizeof(limit_mask_header_t) == 4, "limit_mask_header_t is part of the EEPROM layout");
+static_assert(sizeof(limit_mask_point_t) == 6, "limit_mask_point_t is part of the EEPROM layout");
+
+static bool CheckMask(const limit_mask_header_t *header, const limit_mask_point_t *points)
+{
+    if((header->test_type > LIMIT_MASK_MAX_TEST_TYPE) || (header->curve >= LIMIT_MASK_NB_CURVES) ||
+       (header->nb_points < 2) || (header->nb_points > LIMIT_MASK_MAX_POINTS))
+    {
+        return false;
+    }
+
+    for(int p = 0; p < header->nb_points; p++)
+    {
+        if((p > 0) && (points[p].freq_hz <= points[p - 1].freq_hz))
+        {
+            return false;
+        }
+        if((points[p].freq_hz == 0) || (points[p].lower_centi_db > points[p].upper_centi_db))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool limit_mask_load(limit_mask_set_t *set, const uint8_t *blob, size_t size)
+{
+    PanicFalse(set != NULL);
+
+    set->nb_masks = 0;
+
+    if((blob == NULL) || (size < (sizeof(limit_mask_blob_header_t) + sizeof(uint32_t))))
+    {
+        return false;
+    }
+
+    limit_mask_blob_header_t header;
+    memcpy(&header, blob, sizeof(header));
+    if((header.magic != LIMIT_MASK_MAGIC) || (header.version != LIMIT_MASK_VERSION) ||
+       (header.nb_masks > LIMIT_MASK_MAX_MASKS))
+    {
+        DEBUG("Limit masks: bad header\n");
+        return false;
+    }
+
+    // EEPROM data is not aligned, everything is copied out field by field
+    size_t offset = sizeof(header);
+    for(int m = 0; m < header.nb_masks; m++)
+    {
+        limit_mask_t *mask = &set->masks[m];
+
+        if((offset + sizeof(mask->header)) > (size - sizeof(uint32_t)))
+        {
+            DEBUG("Limit masks: truncated\n");
+            return false;
+        }
+        memcpy(&mask->header, &blob[offset], sizeof(mask->header));
+        offset += sizeof(mask->header);
+
+        const size_t points_size = mask->header.nb_points * sizeof(limit_mask_point_t);
+        if((mask->header.nb_points > LIMIT_MASK_MAX_POINTS) || ((offset + points_size) > (size - sizeof(uint32_t))))
+        {
+            DEBUG("Limit masks: truncated\n");
+            return false;
+        }
+        memcpy(mask->points, &blob[offset], points_size);
+        offset += points_size;
+
+        if(!CheckMask(&mask->header, mask->points))
+        {
+            DEBUG("Limit masks: mask %d is invalid\n", m);
+            return false;
+        }
+    }
+
+    uint32_t crc;
+    memcpy(&crc, &blob[offset], sizeof(crc));
+    if(capture_stream_crc32(0, blob, offset) != crc)
+    {
+        DEBUG("Limit masks: bad CRC\n");
+        return false;
+    }
+
+    set->nb_masks = header.nb_masks;
+    return true;
+}
+
+static inline float CentiDBToDB(int16_t centi_db, int16_t open, float open_db)
+{
+    return (centi_db == open) ? open_db : (centi_db / 100.0f);
+}
+
+bool limit_mask_limits_at(const limit_mask_t *mask, float freq_hz, float *lower_db, float *upper_db)
+{
+    PanicFalse(mask != NULL);
+    PanicFalse(lower_db != NULL);
+    PanicFalse(upper_db != NULL);
+
+    const limit_mask_point_t *points = mask->points;
+    const int last = mask->header.nb_points - 1;
+    if((freq_hz < points[0].freq_hz) || (freq_hz > points[last].freq_hz))
+    {
+        return false;
+    }
+
+    int p = 0;
+    while((p < (last - 1)) && (freq_hz > points[p + 1].freq_hz))
+    {
+        p++;
+    }
+
+    const float t = log2f(freq_hz / points[p].freq_hz) / log2f((float)points[p + 1].freq_hz / points[p].freq_hz);
+
+    // An open side at either end of the segment stays open over it
+    const float lower0 = CentiDBToDB(points[p].lower_centi_db, LIMIT_MASK_NO_LOWER, -INFINITY);
+    const float lower1 = CentiDBToDB(points[p + 1].lower_centi_db, LIMIT_MASK_NO_LOWER, -INFINITY);
+    const float upper0 = CentiDBToDB(points[p].upper_centi_db, LIMIT_MASK_NO_UPPER, INFINITY);
+    const float upper1 = CentiDBToDB(points[p + 1].upper_centi_db, LIMIT_MASK_NO_UPPER, INFINITY);
+
+    *lower_db = (isinf(lower0) || isinf(lower1)) ? -INFINITY : (lower0 + (t * (lower1 - lower0)));
+    *upper_db = (isinf(upper0) || isinf(upper1)) ? INFINITY : (upper0 + (t * (upper1 - upper0)));
+    return true;
+}
@@ -0,0 +1,76 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+#ifndef LIMIT_MASK_H
+#define LIMIT_MASK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Pass/fail masks of the transfer function tests, stored in EEPROM as one blob. Little endian:
+//   header (limit_mask_blob_header_t)
+//   nb_masks times: limit_mask_header_t, then nb_points limit_mask_point_t by increasing frequency
+//   uint32 CRC-32 (same as zlib) of everything before it
+// A mask bounds one curve of audio_get_headset_tf (curve ids 0 to 3) for one test. Limits are linear in log frequency
+// between points, bins below the first point or above the last are not judged. LIMIT_MASK_NO_LOWER and
+// LIMIT_MASK_NO_UPPER leave a side open.
+
+#define LIMIT_MASK_MAGIC 0x4B4D4C45UL //"ELMK" on the wire
+#define LIMIT_MASK_VERSION 1
+#define LIMIT_MASK_MAX_MASKS 24
+#define LIMIT_MASK_MAX_POINTS 32
+#define LIMIT_MASK_NO_LOWER INT16_MIN //centi-dB
+#define LIMIT_MASK_NO_UPPER INT16_MAX
+
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;
+    uint8_t version;
+    uint8_t nb_masks;
+    uint16_t reserved;
+} limit_mask_blob_header_t;
+
+typedef struct __attribute__((packed))
+{
+    uint8_t test_type; //TEST_TYPE_0 to TEST_TYPE_3, as in the capture stream
+    uint8_t curve;
+    uint16_t nb_points;
+} limit_mask_header_t;
+
+typedef struct __attribute__((packed))
+{
+    uint16_t freq_hz;
+    int16_t lower_centi_db;
+    int16_t upper_centi_db;
+} limit_mask_point_t;
+
+typedef struct
+{
+    limit_mask_header_t header;
+    limit_mask_point_t points[LIMIT_MASK_MAX_POINTS];
+} limit_mask_t;
+
+typedef struct
+{
+    limit_mask_t masks[LIMIT_MASK_MAX_MASKS];
+    int nb_masks;
+} limit_mask_set_t;
+
+// Checks and copies a blob read from EEPROM. Returns false, and leaves the set empty, when it is not a valid blob.
+bool limit_mask_load(limit_mask_set_t *set, const uint8_t *blob, size_t size);
+
+// Limits at freq_hz in dB, -INFINITY or INFINITY for an open side. Returns false where the mask does not judge.
+bool limit_mask_limits_at(const limit_mask_t *mask, float freq_hz, float *lower_db, float *upper_db);
+
+#endif
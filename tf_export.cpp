@@ -0,0 +1,184 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+#include <Arduino.h>
+#include <math.h>
+#include <stdint.h>
+
+#include "capture_stream.h"
+#include "tf_export.h"
+
+#define DEBUG_ENABLED
+#include "debug.h"
+
+static_assert(sizeof(tf_export_header_t) == 16, "tf_export_header_t must match tf_export_decoder.py");
+
+static inline int16_t DBToCentiDB(float db)
+{
+    const float centi_db = roundf(db * 100.0f);
+
+    if(!(centi_db > TF_EXPORT_CENTI_DB_MIN)) //also catches NaN
+    {
+        return TF_EXPORT_CENTI_DB_MIN;
+    }
+    if(centi_db > TF_EXPORT_CENTI_DB_MAX)
+    {
+        return TF_EXPORT_CENTI_DB_MAX;
+    }
+    return (int16_t)centi_db;
+}
+
+static inline void WriteBytes(tf_export_packet_t *p, const void *data, size_t len)
+{
+    PanicFalse((p->length + len) <= p->packet_size);
+
+    memcpy(&p->packet[p->length], data, len);
+    p->length += len;
+}
+
+// Band table of a 1/N octave resolution: a band starts at every bin whose nominal band differs from the previous bin.
+// DC has no band, the table starts at bin 1.
+static uint16_t BuildBandTable(uint16_t *first_bins, int nb_octave_bands, uint16_t nb_bins, uint16_t fft_size,
+                               uint16_t sample_rate)
+{
+    const float bin_hz = (float)sample_rate / fft_size;
+    uint16_t nb_bands = 0;
+    long previous_band = 0;
+
+    for(uint16_t bin = 1; bin < nb_bins; bin++)
+    {
+        const long band = lroundf(nb_octave_bands * log2f((bin * bin_hz) / 1000.0f));
+        if((nb_bands == 0) || (band != previous_band))
+        {
+            first_bins[nb_bands++] = bin;
+            previous_band = band;
+        }
+    }
+
+    return nb_bands;
+}
+
+bool tf_export_begin(tf_export_packet_t *p, uint8_t *packet, size_t packet_size, uint8_t test_type,
+                     tf_export_resolution_t resolution, uint8_t nb_curves, uint16_t nb_bins, uint16_t fft_size,
+                     uint16_t sample_rate)
+{
+    PanicFalse(p != NULL);
+    PanicFalse(packet != NULL);
+    PanicFalse(((uintptr_t)packet & 1) == 0); //the band table is read in place
+    PanicFalse(nb_curves <= TF_EXPORT_MAX_CURVES);
+    PanicFalse((nb_bins > 1) && (nb_bins <= ((fft_size / 2) + 1)));
+
+    memset(p, 0, sizeof(*p));
+    p->packet = packet;
+    p->packet_size = packet_size;
+    p->nb_bins = nb_bins;
+    p->nb_curves = nb_curves;
+
+    const size_t header_size = sizeof(tf_export_header_t);
+    if(packet_size < header_size)
+    {
+        return false;
+    }
+
+    // The band table goes straight to its place in the packet, the header is written once its size is known
+    uint16_t *band_first_bins = NULL;
+    if(resolution == TF_EXPORT_BINS)
+    {
+        p->nb_points = nb_bins;
+    }
+    else
+    {
+        PanicFalse((resolution == TF_EXPORT_OCTAVE_3) || (resolution == TF_EXPORT_OCTAVE_6) ||
+                   (resolution == TF_EXPORT_OCTAVE_12));
+        if(packet_size < (header_size + (nb_bins * sizeof(uint16_t))))
+        {
+            return false;
+        }
+        band_first_bins = (uint16_t *)&packet[header_size];
+        p->nb_points = BuildBandTable(band_first_bins, resolution, nb_bins, fft_size, sample_rate);
+        p->band_first_bins = band_first_bins;
+    }
+
+    const size_t table_size = (band_first_bins != NULL) ? (p->nb_points * sizeof(uint16_t)) : 0;
+    const size_t needed = header_size + table_size + (nb_curves * p->nb_points * sizeof(int16_t)) + sizeof(uint32_t);
+    if(packet_size < needed)
+    {
+        return false;
+    }
+
+    tf_export_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = TF_EXPORT_MAGIC;
+    header.sample_rate = sample_rate;
+    header.fft_size = fft_size;
+    header.nb_points = p->nb_points;
+    header.end_bin = nb_bins;
+    header.test_type = test_type;
+    header.resolution = (uint8_t)resolution;
+    header.nb_curves = nb_curves;
+
+    WriteBytes(p, &header, sizeof(header));
+    p->length += table_size;
+
+    return true;
+}
+
+void tf_export_add_curve(tf_export_packet_t *p, const float *curve_db)
+{
+    PanicFalse(p != NULL);
+    PanicFalse(curve_db != NULL);
+    PanicFalse(p->nb_curves_added < p->nb_curves);
+
+    for(uint16_t point = 0; point < p->nb_points; point++)
+    {
+        float db;
+        if(p->band_first_bins == NULL)
+        {
+            db = curve_db[point];
+        }
+        else
+        {
+            const uint16_t first = p->band_first_bins[point];
+            const uint16_t end = ((point + 1) < p->nb_points) ? p->band_first_bins[point + 1] : p->nb_bins;
+
+            float power_sum = 0.0f;
+            int nb_values = 0;
+            for(uint16_t bin = first; bin < end; bin++)
+            {
+                if(curve_db[bin] > TF_EXPORT_NO_DATA_DB)
+                {
+                    power_sum += powf(10.0f, curve_db[bin] / 10.0f);
+                    nb_values++;
+                }
+            }
+            db = (nb_values > 0) ? (10.0f * log10f(power_sum / nb_values)) : TF_EXPORT_NO_DATA_DB;
+        }
+
+        const int16_t centi_db = DBToCentiDB(db);
+        WriteBytes(p, &centi_db, sizeof(centi_db));
+    }
+
+    p->nb_curves_added++;
+}
+
+size_t tf_export_end(tf_export_packet_t *p)
+{
+    PanicFalse(p != NULL);
+    PanicFalse(p->nb_curves_added == p->nb_curves);
+
+    const uint32_t crc = capture_stream_crc32(0, p->packet, p->length);
+    WriteBytes(p, &crc, sizeof(crc));
+
+    return p->length;
+}
@@ -0,0 +1,85 @@
+/**
+ * Copyright (C) 2021 EERS Global Technologies Inc. - All Rights Reserved.
+ * This software is proprietary, confidential, and may only be used in accordance
+ * with applicable licensing terms, or as directed by EERS in writing. In any
+ * case, any redistributions of this software must retain this notice.
+
+ * Unless required by applicable law, provided otherwise in the licensing
+ * terms, or agreed to in writing, this software is distributed on an "AS IS"
+ * basis, without warranties of any kind, either express or implied and in no
+ * event shall the copyright holder be liable for any direct, indirect,
+ * incidental, special, or consequential damages arising in any way out of
+ * the use of this software.
+ */
+
+#ifndef TF_EXPORT_H
+#define TF_EXPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// All the transfer function curves of a test in one binary packet, decoded by tf_export_decoder.py. Little endian:
+//   header (tf_export_header_t)
+//   band table, for fractional octave resolutions only: nb_points uint16, the first FFT bin of each band
+//   nb_curves * nb_points int16 in centi-dB, one curve after the other
+//   uint32 CRC-32 (same as zlib) of everything before it
+// Band k of a 1/N octave resolution is centred on 1000 * 2^(k / N) Hz and gets the power average of the bins rounding
+// to it. Bands no bin falls into are left out, so low frequency bands are the bins themselves. Band i ends where band
+// i + 1 starts, the last one at end_bin.
+
+#define TF_EXPORT_MAGIC 0x52465445UL //"ETFR" on the wire
+#define TF_EXPORT_MAX_CURVES 8
+#define TF_EXPORT_NO_DATA_DB -200.0f //bins at or below are left out of band averages, same as TF_NO_DATA_DB
+#define TF_EXPORT_CENTI_DB_MIN INT16_MIN
+#define TF_EXPORT_CENTI_DB_MAX INT16_MAX
+
+// Largest packet, at full resolution
+#define TF_EXPORT_PACKET_MAX_SIZE(nb_curves, nb_bins) \
+    (sizeof(tf_export_header_t) + ((nb_bins) * sizeof(int16_t) * (1 + (nb_curves))) + sizeof(uint32_t))
+
+typedef enum
+{
+    TF_EXPORT_BINS = 0, //every bin, quantised to centi-dB
+    TF_EXPORT_OCTAVE_3 = 3,
+    TF_EXPORT_OCTAVE_6 = 6,
+    TF_EXPORT_OCTAVE_12 = 12,
+} tf_export_resolution_t;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;
+    uint16_t sample_rate;
+    uint16_t fft_size;
+    uint16_t nb_points;
+    uint16_t end_bin;
+    uint8_t test_type;
+    uint8_t resolution;
+    uint8_t nb_curves;
+    uint8_t reserved;
+} tf_export_header_t;
+
+typedef struct
+{
+    uint8_t *packet;
+    size_t packet_size;
+    size_t length;
+    const uint16_t *band_first_bins; //in the packet, NULL at full resolution
+    uint16_t nb_points;
+    uint16_t nb_bins;
+    uint8_t nb_curves;
+    uint8_t nb_curves_added;
+} tf_export_packet_t;
+
+// Writes the header and band table for curves of nb_bins bins (FFT bins 0 to nb_bins - 1). Returns false when the
+// packet buffer is too small for nb_curves curves.
+bool tf_export_begin(tf_export_packet_t *p, uint8_t *packet, size_t packet_size, uint8_t test_type,
+                     tf_export_resolution_t resolution, uint8_t nb_curves, uint16_t nb_bins, uint16_t fft_size,
+                     uint16_t sample_rate);
+
+// Curves go in the order the decoder reports them, nb_bins values in dB each
+void tf_export_add_curve(tf_export_packet_t *p, const float *curve_db);
+
+// Appends the CRC once all curves are added, returns the packet length
+size_t tf_export_end(tf_export_packet_t *p);
+
+#endif
@@ -0,0 +1,167 @@
+"""Decodes the transfer function packets built by audio_export_headset_tf().
+
+A packet holds all the curves of a test (see tf_export.h), in centi-dB, either for every
+FFT bin or reduced to 1/3, 1/6 or 1/12 octave bands:
+
+    header         PACKET_HEADER, PACKET_HEADER_SIZE bytes
+    band table     nb_points uint16 first bins, fractional octave resolutions only
+    curves         nb_curves * nb_points int16 centi-dB
+    crc            uint32, zlib CRC-32 of everything before it
+
+The curves are in curve id order of audio_get_headset_tf: OEM_L, OEM_R, IEM_L, IEM_R,
+then with the sweep excitation the 2f band of each: at bin k, the mic power over bins 2k
+and 2k + 1 while the sweep excites bin k, relative to the reference at bin k. The second
+harmonic distortion plus whatever noise falls in that band, not a deconvolved H2.
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+
+import numpy as np
+
+from capture_receiver import TEST_TYPE_NAMES, numbered_path
+
+PACKET_MAGIC = 0x52465445
+PACKET_HEADER = struct.Struct("<IHHHHBBBx")
+PACKET_HEADER_SIZE = PACKET_HEADER.size
+PACKET_CRC = struct.Struct("<I")
+PACKET_MAX_CURVES = 8
+
+RESOLUTION_BINS = 0
+RESOLUTIONS = (RESOLUTION_BINS, 3, 6, 12)
+NO_DATA_CENTI_DB = -20000  # TF_EXPORT_NO_DATA_DB, values at or below carry no data
+
+CURVE_NAMES = (
+    "oem_l",
+    "oem_r",
+    "iem_l",
+    "iem_r",
+    "oem_l_2f_band",
+    "oem_r_2f_band",
+    "iem_l_2f_band",
+    "iem_r_2f_band",
+)
+
+
+class TFPacket:
+    def __init__(self, header, first_bins, curves):
+        _, sample_rate, fft_size, _, end_bin, test_type, resolution, _ = header
+        self.sample_rate = sample_rate
+        self.fft_size = fft_size
+        self.end_bin = end_bin
+        self.test_type = test_type
+        self.resolution = resolution
+        self.first_bins = first_bins
+        self.curves = curves
+
+    @property
+    def test_name(self):
+        return TEST_TYPE_NAMES.get(self.test_type, str(self.test_type))
+
+    def end_bins(self):
+        return np.append(self.first_bins[1:], self.end_bin)
+
+    def frequencies(self):
+        """Bin frequencies, or the nominal centre of each band, in Hz."""
+        bin_hz = self.sample_rate / self.fft_size
+        if self.resolution == RESOLUTION_BINS:
+            return self.first_bins * bin_hz
+        n = self.resolution
+        bands = np.round(n * np.log2(self.first_bins * bin_hz / 1000.0))
+        return 1000.0 * 2.0 ** (bands / n)
+
+    def curves_db(self):
+        """Curves in dB, NaN for bins or bands without data."""
+        db = self.curves / 100.0
+        db[self.curves <= NO_DATA_CENTI_DB] = np.nan
+        return db
+
+
+def decode_packet(data):
+    """Returns the packet at the start of data and its length, or raises ValueError."""
+    if len(data) < PACKET_HEADER_SIZE:
+        raise ValueError("truncated header")
+    header = PACKET_HEADER.unpack_from(data)
+    magic, _, fft_size, nb_points, end_bin, _, resolution, nb_curves = header
+    if magic != PACKET_MAGIC:
+        raise ValueError("bad magic")
+    if resolution not in RESOLUTIONS or nb_curves > PACKET_MAX_CURVES:
+        raise ValueError(f"bad header, resolution {resolution}, {nb_curves} curves")
+
+    table_size = 0 if resolution == RESOLUTION_BINS else 2 * nb_points
+    length = PACKET_HEADER_SIZE + table_size + 2 * nb_curves * nb_points + PACKET_CRC.size
+    if len(data) < length:
+        raise ValueError("truncated packet")
+    (crc,) = PACKET_CRC.unpack_from(data, length - PACKET_CRC.size)
+    if zlib.crc32(data[: length - PACKET_CRC.size]) != crc:
+        raise ValueError("bad CRC")
+
+    offset = PACKET_HEADER_SIZE
+    if resolution == RESOLUTION_BINS:
+        first_bins = np.arange(nb_points)
+    else:
+        first_bins = np.frombuffer(data, "<u2", nb_points, offset).astype(int)
+        offset += table_size
+    curves = np.frombuffer(data, "<i2", nb_curves * nb_points, offset)
+    curves = curves.reshape(nb_curves, nb_points).astype(np.int32)
+    return TFPacket(header, first_bins, curves), length
+
+
+def find_packets(data):
+    """Every packet of a byte stream, resyncing on the magic past damaged ones."""
+    magic = struct.pack("<I", PACKET_MAGIC)
+    packets = []
+    start = data.find(magic)
+    while start >= 0:
+        try:
+            packet, length = decode_packet(data[start:])
+        except ValueError:
+            start = data.find(magic, start + 1)
+            continue
+        packets.append(packet)
+        start = data.find(magic, start + length)
+    return packets
+
+
+def write_csv(packet, path):
+    names = CURVE_NAMES[: len(packet.curves)]
+    table = np.column_stack(
+        [packet.first_bins, packet.end_bins(), packet.frequencies(), packet.curves_db().T]
+    )
+    np.savetxt(
+        path,
+        table,
+        delimiter=",",
+        fmt=["%d", "%d", "%.1f"] + ["%.2f"] * len(names),
+        header=",".join(["first_bin", "end_bin", "freq_hz"] + list(names)),
+        comments="",
+    )
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", help="bytes received from the station")
+    parser.add_argument("--output", help="CSV file, numbered after the first packet")
+    args = parser.parse_args()
+
+    with open(args.input, "rb") as f:
+        packets = find_packets(f.read())
+
+    for i, packet in enumerate(packets):
+        if packet.resolution == RESOLUTION_BINS:
+            resolution = "FFT bins"
+        else:
+            resolution = f"1/{packet.resolution} octave bands"
+        print(
+            f"test {packet.test_name}: {len(packet.curves)} curves, "
+            f"{len(packet.first_bins)} {resolution}"
+        )
+        if args.output is not None:
+            write_csv(packet, numbered_path(args.output, i))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())